@@ -34,6 +34,54 @@
 #include "arfcn_freq.h"
 
 
+/*
+ * The band plan.  Each segment is a run of ARFCNs in one band, with the
+ * downlink frequency of a reference ARFCN; channels are 200kHz apart.  A
+ * band's segments are listed in scan order.  Where two segments give the
+ * same frequency the first one is the default, which is why GSM-900 comes
+ * before the part of E-GSM-900 it shares.
+ */
+struct band_segment {
+	int	bi;
+	int	first,
+		last;
+	int	ref_arfcn;
+	double	ref_freq;
+};
+
+static constexpr band_segment BAND_PLAN[] = {
+	{ GSM_850,	128,	251,	128,	869.2e6 },
+	{ GSM_R_900,	955,	974,	1024,	935.0e6 },
+	{ GSM_900,	1,	124,	0,	935.0e6 },
+	{ GSM_E_900,	0,	0,	0,	935.0e6 },
+	{ GSM_E_900,	1,	124,	0,	935.0e6 },
+	{ GSM_E_900,	975,	1023,	1024,	935.0e6 },
+	{ DCS_1800,	512,	885,	512,	1805.2e6 },
+	{ PCS_1900,	512,	810,	512,	1930.2e6 }
+};
+
+static constexpr int BAND_PLAN_LEN = sizeof(BAND_PLAN) / sizeof(BAND_PLAN[0]);
+
+static constexpr int ALL_BANDS[] = {
+	GSM_850,
+	GSM_R_900,
+	GSM_900,
+	GSM_E_900,
+	DCS_1800,
+	PCS_1900
+};
+
+static constexpr double CHAN_SPACING = 0.2e6;
+
+
+static double seg_freq(const band_segment *g, int n) {
+
+	return g->ref_freq + CHAN_SPACING * (n - g->ref_arfcn);
+}
+
+
+
+
 const char *bi_to_str(int bi) {
 
 	switch(bi) {
@@ -90,102 +138,58 @@ int str_to_bi(char *s) {
 
 double arfcn_to_freq(int n, int *bi) {
 
-	if((128 <= n) && (n <= 251)) {
-		if(bi)
-			*bi = GSM_850;
-		return 824.2e6 + 0.2e6 * (n - 128) + 45.0e6;
-	}
+	int i, m = -1, ambiguous = 0;
+	const band_segment *g;
 
-	if((1 <= n) && (n <= 124)) {
-		if(bi && (*bi != GSM_E_900))
-			*bi = GSM_900;
-		return 890.0e6 + 0.2e6 * n + 45.0e6;
+	for(i = 0; i < BAND_PLAN_LEN; i++) {
+		g = &BAND_PLAN[i];
+		if((n < g->first) || (g->last < n))
+			continue;
+		if(m < 0) {
+			m = i;
+			continue;
+		}
+		if(seg_freq(g, n) != seg_freq(&BAND_PLAN[m], n))
+			ambiguous = 1;
+		if(bi && (g->bi == *bi) && (BAND_PLAN[m].bi != *bi))
+			m = i;
 	}
 
-	if(n == 0) {
-		if(bi)
-			*bi = GSM_E_900;
-		return 935e6;
-	}
-	if((955 <= n) && (n <= 1023)) {
-		if(bi) {
-			if (975 <= n)
-				*bi = GSM_E_900;
-			else
-				*bi = GSM_R_900;
-		}
-		return 890.0e6 + 0.2e6 * (n - 1024) + 45.0e6;
+	if(m < 0) {
+		fprintf(stderr, "error: bad arfcn: %d\n", n);
+		return -1.0;
 	}
 
-	if((512 <= n) && (n <= 810)) {
+	if(ambiguous) {
 		if(!bi) {
 			fprintf(stderr, "error: ambiguous arfcn: %d\n", n);
 			return -1.0;
 		}
-
-		if(*bi == DCS_1800)
-			return 1710.2e6 + 0.2e6 * (n - 512) + 95.0e6;
-
-		if(*bi == PCS_1900)
-			return 1850.2e6 + 0.2e6 * (n - 512) + 80.0e6;
-
-		fprintf(stderr, "error: bad (arfcn, band indicator) pair: "
-		   "(%d, %s)\n", n, bi_to_str(*bi));
-		return -1.0;
-	}
-
-	if((811 <= n) && (n <= 885)) {
-		if(bi)
-			*bi = DCS_1800;
-		return 1710.2e6 + 0.2e6 * (n - 512) + 95.0e6;
+		if(BAND_PLAN[m].bi != *bi) {
+			fprintf(stderr, "error: bad (arfcn, band indicator) pair: "
+			   "(%d, %s)\n", n, bi_to_str(*bi));
+			return -1.0;
+		}
 	}
 
-	fprintf(stderr, "error: bad arfcn: %d\n", n);
-	return -1.0;
+	if(bi)
+		*bi = BAND_PLAN[m].bi;
+	return seg_freq(&BAND_PLAN[m], n);
 }
 
 
 int freq_to_arfcn(double freq, int *bi) {
 
-	if((869.2e6 <= freq) && (freq <= 893.8e6)) {
-		if(bi)
-			*bi = GSM_850;
-		return (int)((freq - 869.2e6) / 0.2e6) + 128;
-	}
-
-	if((921.2e6 <= freq) && (freq <= 925.0e6)) {
-		if(bi)
-			*bi = GSM_R_900;
-		return (int)((freq - 935e6) / 0.2e6) + 1024;
-	}
+	int i;
+	const band_segment *g;
 
-	if((935.2e6 <= freq) && (freq <= 959.8e6)) {
-		if(bi)
-			*bi = GSM_900;
-		return (int)((freq - 935e6) / 0.2e6);
-	}
-
-	if(935.0e6 == freq) {
-		if(bi)
-			*bi = GSM_E_900;
-		return 0;
-	}
-	if((925.2e6 <= freq) && (freq <= 934.8e6)) {
-		if(bi)
-			*bi = GSM_E_900;
-		return (int)((freq - 935e6) / 0.2e6) + 1024;
-	}
-
-	if((1805.2e6 <= freq) && (freq <= 1879.8e6)) {
-		if(bi)
-			*bi = DCS_1800;
-		return (int)((freq - 1805.2e6) / 0.2e6) + 512;
-	}
-
-	if((1930.2e6 <= freq) && (freq <= 1989.8e6)) {
-		if(bi)
-			*bi = PCS_1900;
-		return (int)((freq - 1930.2e6) / 0.2e6) + 512;
+	for(i = 0; i < BAND_PLAN_LEN; i++) {
+		g = &BAND_PLAN[i];
+		if((seg_freq(g, g->first) <= freq) && (freq <= seg_freq(g, g->last))) {
+			if(bi)
+				*bi = g->bi;
+			return (int)((freq - g->ref_freq) / CHAN_SPACING) + g->ref_arfcn;
+		}
 	}
 
 	fprintf(stderr, "error: bad frequency: %lf\n", freq);
@@ -195,27 +199,28 @@ int freq_to_arfcn(double freq, int *bi) {
 
 int first_chan(int bi) {
 
-	switch(bi) {
-		case GSM_850:
-			return 128;
+	int i;
 
-		case GSM_R_900:
-			return 955;
+	for(i = 0; i < BAND_PLAN_LEN; i++) {
+		if(BAND_PLAN[i].bi == bi)
+			return BAND_PLAN[i].first;
+	}
 
-		case GSM_900:
-			return 1;
+	return -1;
+}
 
-		case GSM_E_900:
-			return 0;
 
-		case DCS_1800:
-			return 512;
+/*
+ * Segment of band bi that chan is in, -1 if none.
+ */
+static int chan_segment(int chan, int bi) {
 
-		case PCS_1900:
-			return 512;
+	int i;
 
-		default:
-			return -1;
+	for(i = 0; i < BAND_PLAN_LEN; i++) {
+		if((BAND_PLAN[i].bi == bi) && (BAND_PLAN[i].first <= chan) &&
+		   (chan <= BAND_PLAN[i].last))
+			return i;
 	}
 
 	return -1;
@@ -224,101 +229,95 @@ int first_chan(int bi) {
 
 int next_chan_loop(int chan, int bi) {
 
-	switch(bi) {
-		case GSM_850:
-			if((128 <= chan) && (chan < 251))
-				return chan + 1;
-			if(chan == 251)
-				return 128;
-			return -1;
-
-		case GSM_R_900:
-			if((955 <= chan) && (chan < 974))
-				return chan + 1;
-			if(chan == 974)
-				return 955;
-			return -1;
+	int n;
 
-		case GSM_900:
-			if((1 <= chan) && (chan < 124))
-				return chan + 1;
-			if(chan == 124)
-				return 1;
-			return -1;
+	if((n = next_chan(chan, bi)) >= 0)
+		return n;
+	if(chan_segment(chan, bi) < 0)
+		return -1;
+	return first_chan(bi);
+}
 
-		case GSM_E_900:
-			if((0 <= chan) && (chan < 124))
-				return chan + 1;
-			if(chan == 124)
-				return 975;
-			if((975 <= chan) && (chan < 1023))
-				return chan + 1;
-			if(chan == 1023)
-				return 0;
-			return -1;
 
-		case DCS_1800:
-			if((512 <= chan) && (chan < 885))
-				return chan + 1;
-			if(chan == 885)
-				return 512;
-			return -1;
+int next_chan(int chan, int bi) {
 
-		case PCS_1900:
-			if((512 <= chan) && (chan < 810))
-				return chan + 1;
-			if(chan == 810)
-				return 512;
-			return -1;
+	int i;
 
-		default:
-			return -1;
+	if((i = chan_segment(chan, bi)) < 0)
+		return -1;
+	if(chan < BAND_PLAN[i].last)
+		return chan + 1;
+	for(i++; i < BAND_PLAN_LEN; i++) {
+		if(BAND_PLAN[i].bi == bi)
+			return BAND_PLAN[i].first;
 	}
 
 	return -1;
 }
 
 
-int next_chan(int chan, int bi) {
-
-	switch(bi) {
-		case GSM_850:
-			if((128 <= chan) && (chan < 251))
-				return chan + 1;
-			return -1;
+/*
+ * Parse a comma separated list of bands, or "all".  Returns the number of
+ * bands, -1 on a bad band.
+ */
+int str_to_bands(char *s, int *bands, int max) {
 
-		case GSM_R_900:
-			if((955 <= chan) && (chan < 974))
-				return chan + 1;
-			return -1;
+	char *t;
+	int i, n = 0;
 
-		case GSM_900:
-			if((1 <= chan) && (chan < 124))
-				return chan + 1;
-			return -1;
+	if(!strcmp(s, "all")) {
+		for(i = 0; (i < (int)(sizeof(ALL_BANDS) / sizeof(ALL_BANDS[0]))) && (i < max); i++)
+			bands[n++] = ALL_BANDS[i];
+		return n;
+	}
 
-		case GSM_E_900:
-			if((0 <= chan) && (chan < 124))
-				return chan + 1;
-			if(chan == 124)
-				return 975;
-			if((975 <= chan) && (chan < 1023))
-				return chan + 1;
+	for(t = strtok(s, ","); t; t = strtok(0, ",")) {
+		if((i = str_to_bi(t)) == -1) {
+			fprintf(stderr, "error: bad band indicator: ``%s''\n", t);
 			return -1;
+		}
+		if(n < max)
+			bands[n++] = i;
+	}
 
-		case DCS_1800:
-			if((512 <= chan) && (chan < 885))
-				return chan + 1;
-			return -1;
+	return n;
+}
 
-		case PCS_1900:
-			if((512 <= chan) && (chan < 810))
-				return chan + 1;
-			return -1;
 
-		default:
-			return -1;
+/*
+ * Plan a sweep over the given bands.  Channels are ordered by frequency so
+ * the tuner only ever steps up, and a frequency shared by two bands is
+ * scanned once, for the band listed first.  Returns the number of channels.
+ */
+int plan_sweep(const int *bands, int nbands, sweep_chan *plan, int max) {
+
+	int b, i, k, c, n = 0, bi;
+	double freq;
+	sweep_chan t;
+
+	for(b = 0; b < nbands; b++) {
+		for(c = first_chan(bands[b]); c >= 0; c = next_chan(c, bands[b])) {
+			bi = bands[b];
+			freq = arfcn_to_freq(c, &bi);
+			for(k = 0; k < n; k++) {
+				if(plan[k].freq == freq)
+					break;
+			}
+			if((k < n) || (n >= max))
+				continue;
+
+			plan[n].arfcn = c;
+			plan[n].bi = bi;
+			plan[n].freq = freq;
+
+			// stable insertion by frequency
+			for(i = n++; (i > 0) && (plan[i].freq < plan[i - 1].freq); i--) {
+				t = plan[i];
+				plan[i] = plan[i - 1];
+				plan[i - 1] = t;
+			}
+		}
 	}
 
-	return -1;
+	return n;
 }
@@ -35,9 +35,17 @@ enum {
 	PCS_1900
 };
 
+struct sweep_chan {
+	int	arfcn;
+	int	bi;
+	double	freq;
+};
+
 const char *bi_to_str(int bi);
 int str_to_bi(char *s);
 double arfcn_to_freq(int n, int *bi = 0);
 int freq_to_arfcn(double freq, int *bi = 0);
 int first_chan(int bi);
 int next_chan(int chan, int bi);
+int str_to_bands(char *s, int *bands, int max);
+int plan_sweep(const int *bands, int nbands, sweep_chan *plan, int max);
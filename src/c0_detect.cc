@@ -28,25 +28,57 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-#ifdef XTRX_DEV
-#include "xtrx_source.h"
-#else
-#include "usrp_source.h"
-#endif
+#include "sample_source.h"
 #include "circular_buffer.h"
 #include "fcch_detector.h"
+#include "pipeline.h"
+#include "channelizer.h"
+#include "spectrum.h"
+#include "scan_cache.h"
+#include "stats.h"
 #include "arfcn_freq.h"
+#include "instr.h"
 #include "util.h"
 
 extern int g_verbosity;
 
 static const float ERROR_DETECT_OFFSET_MAX = 40e3;
 
+/*
+ * During the power sweep, a channel this many times above the running noise
+ * floor estimate, once FLOOR_MIN channels of the band are in, is checked for
+ * FCCH right away.
+ */
+static const double STRONG_FACTOR = 4.0;
+static const int FLOOR_MIN = 8;
+
+/*
+ * Warm start: a channel that wasn't a C0 last time is only looked at again
+ * CACHE_REPROBE seconds after the last decision on it, or, when a spectrum
+ * sweep measures every channel anyway, once its power has moved by more
+ * than CACHE_CHANGE_DB from its running average.
+ */
+static const uint32_t CACHE_REPROBE = 600;
+static const double CACHE_CHANGE_DB = 3.0;
+
 #ifdef _WIN32
 #define BUFSIZ 1024
 #endif
 
+#define GSM_RATE (1625000.0 / 6.0)
+#define  NOTFOUND_MAX 10
+
+enum {
+	IDLE,
+	PENDING,
+	FOUND,
+	NOTFOUND,
+	CACHED
+};
+
+
 static double vectornorm2(const complex *v, const unsigned int len) {
 
 	unsigned int i;
@@ -59,122 +91,823 @@ static double vectornorm2(const complex *v, const unsigned int len) {
 }
 
 
-int c0_detect(usrp_source *u, int bi) {
+/*
+ * We want to use the average to determine which channels have power, and
+ * hence a possibility of being channel 0 on a BTS.  However, some channels in
+ * the band can be extremely noisy.  (E.g., CDMA traffic in GSM-850.)  Hence
+ * we won't consider the noisiest channels when we construct the average.
+ *
+ * Each band of the sweep gets its own threshold, stored per channel.
+ */
+static void power_thresholds(const sweep_chan *plan, int chan_count,
+   const double *power, double *thresh) {
 
-#define GSM_RATE (1625000.0 / 6.0)
-#define  NOTFOUND_MAX 10
+	int i, k, n, bi;
+	float spower[BUFSIZ];
+	double a;
+
+	for(i = 0; i < chan_count; i++) {
+		bi = plan[i].bi;
+		for(k = 0; k < i; k++) {
+			if(plan[k].bi == bi)
+				break;
+		}
+		if(k < i)
+			continue;
+
+		n = 0;
+		for(k = i; k < chan_count; k++) {
+			if(plan[k].bi == bi)
+				spower[n++] = power[k];
+		}
+		// average the lowest %60
+		a = low_mean(spower, n, n - 4 * n / 10);
+		for(k = i; k < chan_count; k++) {
+			if(plan[k].bi == bi)
+				thresh[k] = a;
+		}
+
+		if(g_verbosity > 0) {
+			fprintf(stderr, "%s channel detect threshold: %lf\n",
+			   bi_to_str(bi), a);
+		}
+	}
+}
+
+
+/*
+ * Record a finished job for channel j->chan.  Returns 1 if the channel
+ * should be tried again.
+ */
+static int collect(scan_pipeline *p, scan_job *j, int *state, int *tries,
+   float *offset) {
+
+	int k = j->chan, again = 0;
+
+	instr_channel(j->freq);
+	if(j->found && (fabsf(j->offset - GSM_RATE / 4) < ERROR_DETECT_OFFSET_MAX)) {
+		state[k] = FOUND;
+		offset[k] = j->offset;
+		instr_count(INSTR_FOUND);
+	} else if(++tries[k] >= NOTFOUND_MAX) {
+		state[k] = NOTFOUND;
+		instr_count(INSTR_NOTFOUND);
+	} else {
+		again = 1;
+		instr_count(INSTR_RETRIES);
+	}
+	p->put_job(j);
+
+	return again;
+}
 
-	int i, chan_count;
-	unsigned int overruns, b_len, frames_len, found_count, notfound_count, r;
-	float offset, spower[BUFSIZ];
-	double freq, sps, n, power[BUFSIZ], sum = 0, a;
+
+static void print_chan(const sweep_chan *c, float offset, double power,
+   int *last_bi) {
+
+	if(c->bi != *last_bi) {
+		printf("%s:\n", bi_to_str(c->bi));
+		*last_bi = c->bi;
+	}
+	printf("\tchan: %d (%.1fMHz ", c->arfcn, c->freq / 1e6);
+	display_freq(offset - GSM_RATE / 4);
+	printf(")\tpower: %6.2lf\n", power);
+}
+
+
+/*
+ * Print the channels of the sweep, in order, up to the first one that is
+ * still to be measured or scanned.  Each band's header goes out as the
+ * first of its channels is reached.
+ */
+static void report(const sweep_chan *plan, int chan_count, const int *state,
+   const float *offset, const double *power, int *reported, int *last_bi) {
+
+	int i;
+
+	for(i = *reported; (i < chan_count) && (state[i] != IDLE) &&
+	   (state[i] != PENDING); i++) {
+		if(state[i] == FOUND)
+			print_chan(&plan[i], offset[i], power[i], last_bi);
+		else if(plan[i].bi != *last_bi) {
+			printf("%s:\n", bi_to_str(plan[i].bi));
+			*last_bi = plan[i].bi;
+		}
+	}
+	fflush(stdout);
+	*reported = i;
+}
+
+
+/*
+ * Add a channel's power to the band's sorted list and return the average of
+ * the lowest 60%, the same estimate power_thresholds() makes at the end.
+ */
+static double running_floor(float *spower, int *len, double n) {
+
+	int i;
+
+	for(i = (*len)++; (i > 0) && (spower[i - 1] > n); i--)
+		spower[i] = spower[i - 1];
+	spower[i] = n;
+
+	return avg(spower, *len - 4 * *len / 10, 0);
+}
+
+
+static void submit_capture(scan_pipeline *p, int k, double freq,
+   const complex *b, unsigned int b_len, unsigned int frames_len) {
+
+	scan_job *j;
+
+	j = p->get_job();
+	j->chan = k;
+	j->freq = freq;
+	j->len = (b_len < frames_len)? b_len : frames_len;
+	memcpy(j->buf, b, j->len * sizeof(complex));
+	p->submit(j);
+}
+
+
+/*
+ * Tune to freq and fill the buffer with at least len contiguous samples.
+ * Where a recording has run out the channel is silent, that is no error.
+ */
+static int tune_and_fill(sample_source *u, double freq, unsigned int len) {
+
+	unsigned int overruns;
+
+	instr_channel(freq);
+	if(!u->tune(freq)) {
+		fprintf(stderr, "error: usrp_source::tune\n");
+		return -1;
+	}
+
+	do {
+		u->flush();
+		if(u->fill(len, &overruns) < 0) {
+			fprintf(stderr, "error: usrp_source::fill\n");
+			return -1;
+		}
+	} while(overruns);
+
+	return 0;
+}
+
+
+/*
+ * Channels waiting for a capture, a ring of size entries.
+ */
+struct chan_queue {
+	int	*chan;
+	int	size,
+		head,
+		len;
+};
+
+
+static void queue_push(chan_queue *q, int k) {
+
+	q->chan[(q->head + q->len++) % q->size] = k;
+}
+
+
+/*
+ * Retune and capture the queued channels while there are free jobs, the
+ * workers scan the ones already submitted meanwhile, then collect the next
+ * result.  A channel that isn't found yet goes to the back of the queue.
+ * Returns the channel whose result came in, -1 once nothing is left in
+ * flight and -2 if the source failed.
+ */
+static int scan_queue(sample_source *u, scan_pipeline *p,
+   const sweep_chan *plan, chan_queue *q, unsigned int frames_len,
+   int *state, int *tries, float *offset) {
+
+	int k;
+	unsigned int b_len;
+	complex *b;
+	scan_job *j;
+
+	while(p->free_jobs() && q->len) {
+		k = q->chan[q->head];
+		q->head = (q->head + 1) % q->size;
+		q->len -= 1;
+
+		if(tune_and_fill(u, plan[k].freq, frames_len))
+			return -2;
+		b = (complex *)u->get_buffer()->peek(&b_len);
+		submit_capture(p, k, plan[k].freq, b, b_len, frames_len);
+	}
+
+	if(!(j = p->wait_done()))
+		return -1;
+	k = j->chan;
+	if(collect(p, j, state, tries, offset))
+		queue_push(q, k);
+
+	return k;
+}
+
+
+/*
+ * Coarse occupancy map, one character per channel in sweep order: '.' below
+ * the band's threshold, then ':', '+' and '#' for up to 6dB, 12dB and more
+ * above it.
+ */
+static void print_occupancy(const sweep_chan *plan, int chan_count,
+   const double *power, const double *thresh) {
+
+	int i;
+	double db;
+
+	for(i = 0; i < chan_count; i++) {
+		if((i == 0) || (plan[i].bi != plan[i - 1].bi)) {
+			if(i)
+				fprintf(stderr, "\n");
+			fprintf(stderr, "%-10s %4d ", bi_to_str(plan[i].bi),
+			   plan[i].arfcn);
+		}
+		db = 20 * log10(power[i] / thresh[i]);
+		fputc((db <= 0.0)? '.' : (db <= 6.0)? ':' : (db <= 12.0)? '+' : '#', stderr);
+	}
+	fprintf(stderr, "\n");
+}
+
+
+/*
+ * Channel power from a Welch spectrum taken at sample_rate, centered center.
+ * Scaled to the units of the time domain measurement: the square root of the
+ * energy of ref_len samples.
+ */
+static double welch_chan_power(welch *w, double freq, double center,
+   double sample_rate, unsigned int ref_len) {
+
+	static const double HALF_CHAN = 100e3;
+
+	double off = freq - center;
+
+	return sqrt(w->band_power(off - HALF_CHAN, off + HALF_CHAN, sample_rate) * ref_len);
+}
+
+
+/*
+ * Spectrum sweep
+ *
+ * Measure the power of every channel of the sweep from captures at rate, so
+ * a tune covers many channels.  Each capture lasts as long as the per
+ * channel measurement does and the middle 80% of its bandwidth is used.
+ * The source is put back at the GSM rate afterwards.
+ */
+static int spectrum_power(sample_source *u, const sweep_chan *plan,
+   int chan_count, double rate, unsigned int ref_len, double *power) {
+
+	static const double CHAN_SPACING = 200e3;
+	static const double BIN_MAX = 25e3;
+
+	int i, c, ntunes = 0;
+	unsigned int fft_len, in_len, b_len;
+	double fs, half, center;
 	complex *b;
 	circular_buffer *ub;
-	fcch_detector *l = new fcch_detector(u->sample_rate());
+	welch *w;
+
+	if(u->set_sample_rate(rate))
+		goto fail;
+	fs = u->sample_rate();
+	half = 0.4 * fs - CHAN_SPACING / 2;
+	if(half < 0.0) {
+		fprintf(stderr, "error: spectrum sweep rate too low: %.0f\n", fs);
+		goto fail;
+	}
+
+	ub = u->get_buffer();
+	for(fft_len = 2; fs / fft_len > BIN_MAX; fft_len <<= 1)
+		;
+	in_len = (unsigned int)(ref_len * fs / GSM_RATE);
+	if(in_len > ub->buf_len() / 2)
+		in_len = ub->buf_len() / 2;
+	w = welch::cached(fft_len, 2 * in_len / fft_len - 1);
 
-	if(bi == BI_NOT_DEFINED) {
+	u->start();
+	u->flush();
+	for(i = 0; i < chan_count; i = c) {
+		center = plan[i].freq + half;
+		if(tune_and_fill(u, center, w->input_len()))
+			goto fail;
+		b = (complex *)ub->peek(&b_len);
+		w->run(b);
+		for(c = i; (c < chan_count) && (plan[c].freq <= center + half); c++) {
+			power[c] = welch_chan_power(w, plan[c].freq, center, fs, ref_len);
+			if(g_verbosity > 2) {
+				fprintf(stderr, "\tchan %d (%.1fMHz):\tpower: %lf\n",
+				   plan[c].arfcn, plan[c].freq / 1e6, power[c]);
+			}
+		}
+		ntunes++;
+	}
+
+	if(g_verbosity > 0) {
+		fprintf(stderr, "spectrum sweep: %d channels in %d tunes\n",
+		   chan_count, ntunes);
+	}
+
+	if(u->reset_sample_rate())
+		return -1;
+	u->start();
+	u->flush();
+
+	return 0;
+
+fail:
+	u->reset_sample_rate();
+	u->start();
+	u->flush();
+	return -1;
+}
+
+
+/*
+ * The cache's verdict on a channel is old enough to be looked at again.
+ */
+static int cache_due(const scan_cache_entry *e, uint32_t now) {
+
+	return now - e->searched >= CACHE_REPROBE;
+}
+
+
+static int cache_changed(const scan_cache_entry *e, double power) {
+
+	if(!e->probes || (e->power_avg <= 0.0) || (power <= 0.0))
+		return 1;
+	return fabs(20 * log10(power / e->power_avg)) > CACHE_CHANGE_DB;
+}
+
+
+/*
+ * Store what this scan learned.  Channels left to the cache keep their old
+ * verdict and times.
+ */
+static void cache_update(scan_cache_entry **ce, int chan_count,
+   const int *state, const int *fresh, const double *power,
+   const float *offset, uint32_t now) {
+
+	int i;
+
+	for(i = 0; i < chan_count; i++) {
+		if(!ce[i])
+			continue;
+		if(fresh[i])
+			scan_cache::add_power(ce[i], power[i], now);
+		if(state[i] == CACHED)
+			continue;
+		ce[i]->searched = now;
+		if(state[i] == FOUND) {
+			ce[i]->found = now;
+			ce[i]->offset = offset[i];
+			ce[i]->hits++;
+		}
+	}
+}
+
+
+int c0_detect(sample_source *u, const int *bands, int nbands, double sweep_rate,
+   scan_pipeline *p, scan_cache *cache) {
+
+	int i, chan_count, sweep_bi, last_bi, reported, floor_len, nknown,
+	   nmeasured;
+	int tries[BUFSIZ], state[BUFSIZ], queue[BUFSIZ], fresh[BUFSIZ];
+	unsigned int b_len, frames_len;
+	uint32_t now;
+	float chan_offset[BUFSIZ], floor_power[BUFSIZ];
+	double n, noise, power[BUFSIZ], thresh[BUFSIZ];
+	sweep_chan plan[BUFSIZ];
+	scan_cache_entry *ce[BUFSIZ];
+	chan_queue q;
+	complex *b;
+	circular_buffer *ub;
+	scan_job *j;
+
+	if(!(chan_count = plan_sweep(bands, nbands, plan, BUFSIZ))) {
 		fprintf(stderr, "error: c0_detect: band not defined\n");
 		return -1;
 	}
 
-	sps = u->sample_rate() / GSM_RATE;
-	frames_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) * sps);
+	frames_len = p->block_len();
 	ub = u->get_buffer();
+	now = (uint32_t)time(0);
+	for(i = 0; i < chan_count; i++) {
+		tries[i] = 0;
+		state[i] = IDLE;
+		fresh[i] = 0;
+		chan_offset[i] = 0.0;
+		ce[i] = cache? cache->entry(plan[i].bi, plan[i].arfcn) : 0;
+	}
+	sweep_bi = last_bi = BI_NOT_DEFINED;
+	reported = floor_len = 0;
+	q.chan = queue;
+	q.size = chan_count;
+	q.head = q.len = 0;
+	u->start();
+	u->flush();
 
-	// first, we calculate the power in each channel
+	/*
+	 * Warm start: the C0s found last time are checked before anything
+	 * else, most of them will still be there.
+	 */
+	nknown = 0;
+	for(i = 0; cache && (i < chan_count); i++) {
+		if(!ce[i] || !scan_cache::is_c0(ce[i]))
+			continue;
+		if(tune_and_fill(u, plan[i].freq, frames_len))
+			return -1;
+		b = (complex *)ub->peek(&b_len);
+		power[i] = sqrt(vectornorm2(b, frames_len));
+		fresh[i] = 1;
+		state[i] = PENDING;
+		if(p->free_jobs())
+			submit_capture(p, i, plan[i].freq, b, b_len, frames_len);
+		else
+			queue_push(&q, i);
+		nknown++;
+	}
+
+	/*
+	 * Then we calculate the power in each channel.  Either from wideband
+	 * spectra, many channels a tune, or one channel at a time.  In the
+	 * latter case a channel that stands well clear of the noise floor seen
+	 * so far is handed to the detectors with the capture we just took, so
+	 * strong carriers are scanned while the sweep is still running.  They
+	 * are reported in channel order all the same, once every channel
+	 * before them is settled.  On a warm start, channels whose cached
+	 * verdict still stands aren't measured one at a time, their cached
+	 * power is used.
+	 */
 	if(g_verbosity > 2) {
 		fprintf(stderr, "calculate power in each channel:\n");
 	}
-	u->start();
-	u->flush();
-	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
-		freq = arfcn_to_freq(i, &bi);
-		if(!u->tune(freq)) {
-			fprintf(stderr, "error: usrp_source::tune\n");
+	if(sweep_rate > 0.0) {
+		if(spectrum_power(u, plan, chan_count, sweep_rate, frames_len, power))
 			return -1;
+		for(i = 0; i < chan_count; i++)
+			fresh[i] = 1;
+	}
+	for(i = 0; (sweep_rate <= 0.0) && (i < chan_count); i++) {
+		if(state[i] != IDLE)
+			continue;
+		if(ce[i] && !cache_due(ce[i], now)) {
+			power[i] = ce[i]->power;
+			continue;
+		}
+		if(plan[i].bi != sweep_bi) {
+			sweep_bi = plan[i].bi;
+			floor_len = 0;
 		}
 
-		do {
-			u->flush();
-			if(u->fill(frames_len, &overruns)) {
-				fprintf(stderr, "error: usrp_source::fill\n");
-				return -1;
-			}
-		} while(overruns);
+		if(tune_and_fill(u, plan[i].freq, frames_len))
+			return -1;
 
 		b = (complex *)ub->peek(&b_len);
 		n = sqrt(vectornorm2(b, frames_len));
 		power[i] = n;
+		fresh[i] = 1;
 		if(g_verbosity > 2) {
 			fprintf(stderr, "\tchan %d (%.1fMHz):\tpower: %lf\n",
-			   i, freq / 1e6, n);
+			   plan[i].arfcn, plan[i].freq / 1e6, n);
+		}
+
+		noise = running_floor(floor_power, &floor_len, n);
+		if((floor_len >= FLOOR_MIN) && (n > STRONG_FACTOR * noise)) {
+			state[i] = PENDING;
+			if(p->free_jobs())
+				submit_capture(p, i, plan[i].freq, b, b_len, frames_len);
+			else
+				queue_push(&q, i);
+		}
+
+		while((j = p->poll_done())) {
+			if(collect(p, j, state, tries, chan_offset))
+				queue_push(&q, j->chan);
 		}
 	}
 
+	// then we look for fcch bursts on the rest of the channels with power
+	power_thresholds(plan, chan_count, power, thresh);
+	if(g_verbosity > 0)
+		print_occupancy(plan, chan_count, power, thresh);
+	nmeasured = 0;
+	for(i = 0; i < chan_count; i++) {
+		nmeasured += fresh[i];
+		if(state[i] != IDLE)
+			continue;
+		if(ce[i] && !cache_due(ce[i], now) &&
+		   (!fresh[i] || !cache_changed(ce[i], power[i]))) {
+			state[i] = CACHED;
+			continue;
+		}
+		if(power[i] > thresh[i]) {
+			state[i] = PENDING;
+			queue_push(&q, i);
+		} else
+			state[i] = NOTFOUND;
+	}
+	if(cache && (g_verbosity > 0)) {
+		fprintf(stderr, "scan cache: %d known C0s, %d of %d channels "
+		   "measured\n", nknown, nmeasured, chan_count);
+	}
+
 	/*
-	 * We want to use the average to determine which channels have
-	 * power, and hence a possibility of being channel 0 on a BTS.
-	 * However, some channels in the band can be extremely noisy.  (E.g.,
-	 * CDMA traffic in GSM-850.)  Hence we won't consider the noisiest
-	 * channels when we construct the average.
+	 * While the workers scan one channel, we retune and capture the next
+	 * one.  A channel that isn't found is queued again until it has been
+	 * tried NOTFOUND_MAX times.
 	 */
-	chan_count = 0;
-	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
-		spower[chan_count++] = power[i];
+	report(plan, chan_count, state, chan_offset, power, &reported, &last_bi);
+	while((i = scan_queue(u, p, plan, &q, frames_len, state, tries,
+	   chan_offset)) != -1) {
+		if(i == -2)
+			return -1;
+		report(plan, chan_count, state, chan_offset, power, &reported,
+		   &last_bi);
 	}
-	sort(spower, chan_count);
 
-	// average the lowest %60
-	a = avg(spower, chan_count - 4 * chan_count / 10, 0);
+	if(cache)
+		cache_update(ce, chan_count, state, fresh, power, chan_offset, now);
 
-	if(g_verbosity > 0) {
-		fprintf(stderr, "channel detect threshold: %lf\n", a);
+	return 0;
+}
+
+
+/*
+ * Find one C0 to calibrate on
+ *
+ * Measure the power of every channel of the bands as a scan does, then
+ * search the channels above their band's threshold strongest first and
+ * stop at the first FCCH detection.  A channel that isn't found goes to
+ * the back of the queue until it has been tried NOTFOUND_MAX times.
+ * Returns 0 and the channel in c0, -1 if no C0 was found.
+ */
+int c0_find(sample_source *u, const int *bands, int nbands, double sweep_rate,
+   scan_pipeline *p, sweep_chan *c0) {
+
+	int i, k, chan_count, found = -1, last_bi;
+	int tries[BUFSIZ], state[BUFSIZ], queue[BUFSIZ];
+	unsigned int b_len, frames_len;
+	float chan_offset[BUFSIZ];
+	double power[BUFSIZ], thresh[BUFSIZ];
+	sweep_chan plan[BUFSIZ];
+	chan_queue q;
+	complex *b;
+	circular_buffer *ub;
+	scan_job *j;
+
+	if(!(chan_count = plan_sweep(bands, nbands, plan, BUFSIZ))) {
+		fprintf(stderr, "error: c0_find: band not defined\n");
+		return -1;
 	}
 
-	// then we look for fcch bursts
-	printf("%s:\n", bi_to_str(bi));
-	found_count = 0;
-	notfound_count = 0;
-	sum = 0;
-	i = first_chan(bi);
-	do {
-		if(power[i] <= a) {
-			i = next_chan(i, bi);
+	frames_len = p->block_len();
+	ub = u->get_buffer();
+
+	if(sweep_rate > 0.0) {
+		if(spectrum_power(u, plan, chan_count, sweep_rate, frames_len, power))
+			return -1;
+	} else {
+		u->start();
+		u->flush();
+		for(i = 0; i < chan_count; i++) {
+			if(tune_and_fill(u, plan[i].freq, frames_len))
+				return -1;
+			b = (complex *)ub->peek(&b_len);
+			power[i] = sqrt(vectornorm2(b, frames_len));
+		}
+	}
+	power_thresholds(plan, chan_count, power, thresh);
+
+	// candidates, strongest first
+	q.chan = queue;
+	q.size = chan_count;
+	q.head = q.len = 0;
+	for(i = 0; i < chan_count; i++) {
+		tries[i] = 0;
+		state[i] = IDLE;
+		if(power[i] <= thresh[i])
 			continue;
+		for(k = q.len++; (k > 0) && (power[queue[k - 1]] < power[i]); k--)
+			queue[k] = queue[k - 1];
+		queue[k] = i;
+	}
+	if(g_verbosity > 0) {
+		fprintf(stderr, "%d candidate channels\n", q.len);
+	}
+
+	while((found < 0) && ((k = scan_queue(u, p, plan, &q, frames_len,
+	   state, tries, chan_offset)) >= 0)) {
+		if(state[k] == FOUND)
+			found = k;
+	}
+	if((found < 0) && (k == -2))
+		return -1;
+
+	// the captures still in flight are of no more use
+	while(p->pending()) {
+		if(!(j = p->wait_done()))
+			break;
+		p->put_job(j);
+	}
+
+	if(found < 0) {
+		fprintf(stderr, "error: no C0 found\n");
+		return -1;
+	}
+
+	last_bi = BI_NOT_DEFINED;
+	print_chan(&plan[found], chan_offset[found], power[found], &last_bi);
+	fflush(stdout);
+	*c0 = plan[found];
+
+	return 0;
+}
+
+
+/*
+ * Wideband scan
+ *
+ * Rather than tuning to every ARFCN, capture nchan * 200kHz at a time and
+ * split it into GSM channels with a polyphase channelizer.  The outer
+ * channels of each capture sit on the receiver's anti-alias filter, so a
+ * tune only covers the channels within 200kHz * (nchan / 2 - 2) of the
+ * center.  Each channel is scanned at twice the channel spacing by the
+ * pipeline's detectors.  The source's buffer is grown to hold a capture and
+ * the source is put back at the GSM rate afterwards.
+ */
+int c0_detect_wideband(sample_source *u, const int *bands, int nbands,
+   double rate, unsigned int nworkers) {
+
+	static const double CHAN_SPACING = 200e3;
+
+	int i, k, c, t, chan_count, ntunes, reported, last_bi, left;
+	int tune[BUFSIZ], tries[BUFSIZ], state[BUFSIZ];
+	unsigned int bin[BUFSIZ], nchan, kmax, out_len, in_len, b_len, fft_len;
+	float chan_offset[BUFSIZ];
+	double power[BUFSIZ], thresh[BUFSIZ], tune_freq[BUFSIZ];
+	sweep_chan plan[BUFSIZ];
+	complex *b, **out;
+	circular_buffer *ub;
+	channelizer *ch;
+	scan_pipeline *p;
+	scan_job *j;
+	welch *w;
+
+	if(!(chan_count = plan_sweep(bands, nbands, plan, BUFSIZ))) {
+		fprintf(stderr, "error: c0_detect: band not defined\n");
+		return -1;
+	}
+
+	nchan = (unsigned int)round(rate / CHAN_SPACING);
+	if((nchan < 6) || (nchan & 1)) {
+		fprintf(stderr, "error: wideband rate must be an even multiple "
+		   "of 200kHz, at least 1.2MHz\n");
+		return -1;
+	}
+	kmax = nchan / 2 - 2;
+
+	if(u->set_sample_rate(nchan * CHAN_SPACING)) {
+		u->reset_sample_rate();
+		return -1;
+	}
+	if(fabs(u->sample_rate() - nchan * CHAN_SPACING) > 100.0) {
+		fprintf(stderr, "warning: sample rate %.0f is off the channel "
+		   "grid\n", u->sample_rate());
+	}
+
+	ch = new channelizer(nchan);
+	p = new scan_pipeline(2 * u->sample_rate() / nchan, nworkers);
+	out_len = p->block_len();
+	in_len = ch->input_len(out_len);
+	out = new complex *[nchan];
+	for(k = 0; k < (int)nchan; k++)
+		out[k] = new complex[out_len];
+
+	// a capture at this rate may not fit the GSM rate's buffer
+	if(u->reserve(2 * in_len))
+		goto fail;
+	ub = u->get_buffer();
+
+	// the sweep is in frequency order, cover kmax either side of each tune
+	ntunes = 0;
+	for(i = 0; i < chan_count; i = c) {
+		tune_freq[ntunes] = plan[i].freq + kmax * CHAN_SPACING;
+		for(c = i; c < chan_count; c++) {
+			if(plan[c].freq > tune_freq[ntunes] + (kmax + 0.5) * CHAN_SPACING)
+				break;
+			t = (int)round((plan[c].freq - tune_freq[ntunes]) / CHAN_SPACING);
+			tune[c] = ntunes;
+			bin[c] = (t < 0)? t + nchan : t;
 		}
+		ntunes++;
+	}
+	if(g_verbosity > 0) {
+		fprintf(stderr, "wideband: %u channels per tune, %d tunes\n",
+		   2 * kmax + 1, ntunes);
+	}
 
-		freq = arfcn_to_freq(i, &bi);
-		if(!u->tune(freq)) {
-			fprintf(stderr, "error: usrp_source::tune\n");
-			return -1;
+	/*
+	 * First, we calculate the power in each channel from the spectrum of
+	 * each tune, which is much cheaper than channelizing it.
+	 */
+	for(fft_len = 2; u->sample_rate() / fft_len > CHAN_SPACING / 8; fft_len <<= 1)
+		;
+	w = welch::cached(fft_len, 2 * in_len / fft_len - 1);
+	u->start();
+	u->flush();
+	for(t = 0; t < ntunes; t++) {
+		if(tune_and_fill(u, tune_freq[t], w->input_len()))
+			goto fail;
+		b = (complex *)ub->peek(&b_len);
+		w->run(b);
+		for(c = 0; c < chan_count; c++) {
+			if(tune[c] != t)
+				continue;
+			power[c] = welch_chan_power(w, plan[c].freq, tune_freq[t],
+			   u->sample_rate(), out_len);
+			if(g_verbosity > 2) {
+				fprintf(stderr, "\tchan %d (%.1fMHz):\tpower: %lf\n",
+				   plan[c].arfcn, plan[c].freq / 1e6, power[c]);
+			}
 		}
+	}
 
-		do {
-			u->flush();
-			if(u->fill(frames_len, &overruns)) {
-				fprintf(stderr, "error: usrp_source::fill\n");
-				return -1;
+	power_thresholds(plan, chan_count, power, thresh);
+	if(g_verbosity > 0)
+		print_occupancy(plan, chan_count, power, thresh);
+	for(c = 0; c < chan_count; c++) {
+		tries[c] = 0;
+		state[c] = (power[c] > thresh[c])? PENDING : NOTFOUND;
+		chan_offset[c] = 0.0;
+	}
+
+	/*
+	 * Then we look for fcch bursts.  Every pass captures each tune that
+	 * still has an unresolved channel once, channels are given up after
+	 * NOTFOUND_MAX captures.
+	 */
+	reported = 0;
+	last_bi = BI_NOT_DEFINED;
+	report(plan, chan_count, state, chan_offset, power, &reported, &last_bi);
+	do {
+		for(t = 0; t < ntunes; t++) {
+			for(c = 0; c < chan_count; c++) {
+				if((tune[c] == t) && (state[c] == PENDING))
+					break;
 			}
-		} while(overruns);
+			if(c == chan_count)
+				continue;
 
-		b = (complex *)ub->peek(&b_len);
-		r = l->scan(b, b_len, &offset, 0);
-		if(r && (fabsf(offset - GSM_RATE / 4) < ERROR_DETECT_OFFSET_MAX)) {
-			// found
-			printf("\tchan: %d (%.1fMHz ", i, freq / 1e6);
-			display_freq(offset - GSM_RATE / 4);
-			printf(")\tpower: %6.2lf\n", power[i]);
-			notfound_count = 0;
-			i = next_chan(i, bi);
-		} else {
-			// not found
-			notfound_count += 1;
-			if(notfound_count >= NOTFOUND_MAX) {
-				notfound_count = 0;
-				i = next_chan(i, bi);
+			if(tune_and_fill(u, tune_freq[t], in_len))
+				goto fail;
+			b = (complex *)ub->peek(&b_len);
+			ch->run(b, b_len, out, out_len);
+			for(; c < chan_count; c++) {
+				if((tune[c] != t) || (state[c] != PENDING))
+					continue;
+				while(!p->free_jobs()) {
+					collect(p, p->wait_done(), state, tries, chan_offset);
+					report(plan, chan_count, state, chan_offset,
+					   power, &reported, &last_bi);
+				}
+				j = p->get_job();
+				j->chan = c;
+				j->freq = plan[c].freq;
+				j->len = out_len;
+				memcpy(j->buf, out[bin[c]], out_len * sizeof(complex));
+				p->submit(j);
 			}
 		}
-	} while(i >= 0);
+		while((j = p->wait_done())) {
+			collect(p, j, state, tries, chan_offset);
+			report(plan, chan_count, state, chan_offset, power,
+			   &reported, &last_bi);
+		}
 
-	return 0;
+		left = 0;
+		for(c = 0; c < chan_count; c++)
+			left += (state[c] == PENDING);
+	} while(left);
+
+	for(k = 0; k < (int)nchan; k++)
+		delete[] out[k];
+	delete[] out;
+	delete p;
+	delete ch;
+	return u->reset_sample_rate();
+
+fail:
+	while((j = p->wait_done()))
+		p->put_job(j);
+	for(k = 0; k < (int)nchan; k++)
+		delete[] out[k];
+	delete[] out;
+	delete p;
+	delete ch;
+	u->reset_sample_rate();
+	return -1;
 }
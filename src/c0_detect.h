@@ -25,4 +25,11 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-int c0_detect(usrp_source *u, int bi);
+class sample_source;
+class scan_pipeline;
+class scan_cache;
+struct sweep_chan;
+
+int c0_detect(sample_source *u, const int *bands, int nbands, double sweep_rate, scan_pipeline *p, scan_cache *cache = 0);
+int c0_find(sample_source *u, const int *bands, int nbands, double sweep_rate, scan_pipeline *p, sweep_chan *c0);
+int c0_detect_wideband(sample_source *u, const int *bands, int nbands, double rate, unsigned int nworkers);
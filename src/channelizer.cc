@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdexcept>
+
+#include "channelizer.h"
+#include "util.h"
+
+
+channelizer::channelizer(const unsigned int nchan,
+   const unsigned int taps_per_branch) {
+
+	unsigned int i;
+
+	if((nchan < 2) || (nchan & 1))
+		throw std::runtime_error("channelizer: channel count must be even");
+
+	m_nchan = nchan;
+	m_h_len = nchan * taps_per_branch;
+
+	/*
+	 * Blackman windowed sinc.  The cutoff sits a bit past half the channel
+	 * spacing so a GSM carrier passes flat, the transition band ends well
+	 * inside the next channel.
+	 */
+	m_h = new float[m_h_len];
+	lowpass(m_h, m_h_len, 0.6 / nchan);
+
+	m_rot = new complex[nchan];
+	for(i = 0; i < nchan; i++)
+		m_rot[i] = std::polar(1.0f, (float)(-2 * M_PI * i / nchan));
+
+	m_in = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * nchan);
+	m_out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * nchan);
+	if((!m_in) || (!m_out))
+		throw std::runtime_error("channelizer: fftw_malloc failed!");
+	m_plan = fftw_plan_dft_1d(nchan, m_in, m_out, FFTW_BACKWARD,
+	   FFTW_ESTIMATE);
+	if(!m_plan)
+		throw std::runtime_error("channelizer: fftw plan failed!");
+}
+
+
+channelizer::~channelizer() {
+
+	fftw_destroy_plan(m_plan);
+	fftw_free(m_out);
+	fftw_free(m_in);
+	delete[] m_rot;
+	delete[] m_h;
+}
+
+
+/*
+ * Channel k of the FFT is centered at chan_index(k) * channel_spacing from
+ * the tuned frequency.
+ */
+int channelizer::chan_index(unsigned int k) {
+
+	return (k < m_nchan / 2)? (int)k : (int)k - (int)m_nchan;
+}
+
+
+/*
+ * Input samples needed to produce out_len samples per channel.
+ */
+unsigned int channelizer::input_len(unsigned int out_len) {
+
+	return history() + out_len * decimation();
+}
+
+
+/*
+ * Channelize in_len samples.  out must point to m_nchan buffers of out_len
+ * samples.  Returns the number of samples written to each channel.
+ */
+unsigned int channelizer::run(const complex *in, const unsigned int in_len,
+   complex **out, const unsigned int out_len) {
+
+	unsigned int n, t, p, l, k, D = decimation();
+	complex acc;
+	const complex *x;
+
+	for(n = 0; n < out_len; n++) {
+		t = history() + n * D;
+		if(t >= in_len)
+			break;
+
+		// fold the prototype filter into the branches
+		x = in + t;
+		for(p = 0; p < m_nchan; p++) {
+			acc = 0.0;
+			for(l = p; l < m_h_len; l += m_nchan)
+				acc += m_h[l] * x[-(int)l];
+			m_in[p][0] = acc.real();
+			m_in[p][1] = acc.imag();
+		}
+
+		fftw_execute(m_plan);
+
+		// shift each channel down to baseband
+		for(k = 0; k < m_nchan; k++)
+			out[k][n] = complex(m_out[k][0], m_out[k][1]) *
+			   m_rot[(k * (t % m_nchan)) % m_nchan];
+	}
+
+	return n;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * channelizer
+ *
+ * Oversampled polyphase filter bank.  Splits a capture taken at
+ * M * channel_spacing into M channels, each at 2 * channel_spacing.
+ *
+ * For output n of channel k (input time t = n * M / 2),
+ *
+ *	y_k[n] = sum_i h[i] x[t - i] e^(-j 2 pi k (t - i) / M)
+ *	       = e^(-j 2 pi k t / M) sum_p e^(j 2 pi k p / M) v[p]
+ *
+ * where v[p] = sum_l h[p + l M] x[t - p - l M] folds the prototype filter
+ * into M branches.  The sum over p is one inverse FFT of size M for all
+ * channels at once.
+ */
+
+#pragma once
+
+#include <fftw3.h>
+
+#include "usrp_complex.h"
+
+class channelizer {
+public:
+	channelizer(const unsigned int nchan, const unsigned int taps_per_branch = 24);
+	~channelizer();
+
+	unsigned int run(const complex *in, const unsigned int in_len, complex **out, const unsigned int out_len);
+
+	unsigned int nchan() { return m_nchan; };
+	unsigned int decimation() { return m_nchan / 2; };
+	unsigned int history() { return m_h_len - 1; };
+	int chan_index(unsigned int k);
+	unsigned int input_len(unsigned int out_len);
+
+private:
+	unsigned int	m_nchan,
+			m_h_len;
+	float		*m_h;
+	complex		*m_rot;
+
+	fftw_complex	*m_in, *m_out;
+	fftw_plan	m_plan;
+};
@@ -40,22 +40,172 @@
 #include <stdexcept>
 #include <sys/types.h>
 #include <sys/stat.h>
-#ifndef D_HOST_OSX
+#if defined(HAVE_MEMFD_CREATE)
+#include <stdint.h>
+#include <errno.h>
+#include <sys/mman.h>
+#elif !defined(D_HOST_OSX)
 #ifndef _WIN32
 #include <sys/shm.h>
 #endif
 #else
 #include <sys/mman.h>
 #include <fcntl.h>
-#endif /* !D_HOST_OSX */
+#endif /* HAVE_MEMFD_CREATE */
 
 #include "circular_buffer.h"
 //#include <cstdio>
 
-#ifndef D_HOST_OSX
+#if defined(HAVE_MEMFD_CREATE)
+
+#ifdef D_USE_HUGEPAGES
+static const unsigned int HUGEPAGE_SIZE = 2 * 1024 * 1024;
+#endif /* D_USE_HUGEPAGES */
+
+
+/*
+ * Map buf_size bytes of an anonymous memfd twice, back to back, between two
+ * guard pages.
+ *
+ * The whole range is first reserved with PROT_NONE and the two copies of the
+ * buffer are then mapped over it with MAP_FIXED.  The range is never released
+ * in between, so unlike the System V version there is no window in which
+ * another thread can grab it.  The parts of the reservation that are not
+ * replaced are the guard pages.
+ *
+ * Returns MAP_FAILED with errno set on failure.
+ */
+static void *mirror_map(const unsigned int buf_size,
+   const unsigned int pagesize, const unsigned int mfd_flags) {
+
+	int fd, e;
+	size_t len = 2 * (size_t)pagesize + 2 * (size_t)buf_size;
+	size_t slack = pagesize - getpagesize();
+	char *r, *base;
+
+	if((fd = memfd_create("kalibrate", MFD_CLOEXEC | mfd_flags)) == -1)
+		return MAP_FAILED;
+
+	if(ftruncate(fd, buf_size) == -1) {
+		e = errno;
+		close(fd);
+		errno = e;
+		return MAP_FAILED;
+	}
+
+	// reserve an address-range that can contain everything
+	if((r = (char *)mmap(0, len + slack, PROT_NONE,
+	   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)) ==
+	   MAP_FAILED) {
+		e = errno;
+		close(fd);
+		errno = e;
+		return MAP_FAILED;
+	}
+
+	// huge pages have to be mapped at a huge page boundary
+	base = (char *)(((uintptr_t)r + slack) & ~((uintptr_t)pagesize - 1));
+	if(base > r)
+		munmap(r, base - r);
+	if(r + slack > base)
+		munmap(base + len, r + slack - base);
+
+	// map both copies of the buffer over the reservation
+	if((mmap(base + pagesize, buf_size, PROT_READ | PROT_WRITE,
+	   MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) ||
+	   (mmap(base + pagesize + buf_size, buf_size, PROT_READ | PROT_WRITE,
+	   MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+		e = errno;
+		munmap(base, len);
+		close(fd);
+		errno = e;
+		return MAP_FAILED;
+	}
+
+	// the mappings keep the memory alive
+	close(fd);
+
+	return base;
+}
+
+
+circular_buffer::circular_buffer(const unsigned int buf_len,
+   const unsigned int item_size, const unsigned int overwrite,
+   const unsigned int spsc) {
+
+	void *base = MAP_FAILED;
+
+	if(!buf_len)
+		throw std::runtime_error("circular_buffer: buffer len is 0");
+
+	if(!item_size)
+		throw std::runtime_error("circular_buffer: item size is 0");
+
+	if(spsc && overwrite)
+		throw std::runtime_error("circular_buffer: overwrite needs the lock");
+
+	// calculate buffer size
+	m_item_size = item_size;
+
+#ifdef D_USE_HUGEPAGES
+	/*
+	 * Only use huge pages when the buffer fills at least one of them.  If
+	 * the huge page pool is exhausted we quietly fall back to normal pages.
+	 */
+	if(item_size * buf_len >= HUGEPAGE_SIZE) {
+		m_pagesize = HUGEPAGE_SIZE;
+		m_buf_size = item_size * buf_len;
+		if(m_buf_size % m_pagesize)
+			m_buf_size = (m_buf_size + m_pagesize) & ~(m_pagesize - 1);
+		base = mirror_map(m_buf_size, m_pagesize, MFD_HUGETLB);
+	}
+#endif /* D_USE_HUGEPAGES */
+
+	if(base == MAP_FAILED) {
+		m_pagesize = getpagesize();
+		m_buf_size = item_size * buf_len;
+		if(m_buf_size % m_pagesize)
+			m_buf_size = (m_buf_size + m_pagesize) & ~(m_pagesize - 1);
+		if((base = mirror_map(m_buf_size, m_pagesize, 0)) == MAP_FAILED) {
+			perror("memfd");
+			throw std::runtime_error("circular_buffer: memfd mmap");
+		}
+	}
+	m_buf_len = m_buf_size / item_size;
+
+	// save the base address for unmap later
+	m_base = base;
+
+	// save a pointer to the data
+	m_buf = (char *)base + m_pagesize;
+
+	m_r = m_w = 0;
+	m_read = m_written = 0;
+
+	m_item_size = item_size;
+
+	m_overwrite = overwrite;
+	m_spsc = spsc;
+
+	m_readers = 0;
+	memset(m_reader_read, 0, sizeof(m_reader_read));
+	memset(m_reader_overruns, 0, sizeof(m_reader_overruns));
+
+	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_space_cond, 0);
+}
+
+
+circular_buffer::~circular_buffer() {
+
+	munmap(m_base, 2 * m_pagesize + 2 * m_buf_size);
+}
+
+#elif !defined(D_HOST_OSX)
 #ifndef _WIN32
 circular_buffer::circular_buffer(const unsigned int buf_len,
-   const unsigned int item_size, const unsigned int overwrite) {
+   const unsigned int item_size, const unsigned int overwrite,
+   const unsigned int spsc) {
 
 	int shm_id_temp, shm_id_guard, shm_id_buf;
 	void *base;
@@ -66,6 +216,9 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 	if(!item_size)
 		throw std::runtime_error("circular_buffer: item size is 0");
 
+	if(spsc && overwrite)
+		throw std::runtime_error("circular_buffer: overwrite needs the lock");
+
 	// calculate buffer size
 	m_item_size = item_size;
 	m_buf_size = item_size * buf_len;
@@ -172,8 +325,14 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 	m_item_size = item_size;
 
 	m_overwrite = overwrite;
+	m_spsc = spsc;
+
+	m_readers = 0;
+	memset(m_reader_read, 0, sizeof(m_reader_read));
+	memset(m_reader_overruns, 0, sizeof(m_reader_overruns));
 
 	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_space_cond, 0);
 }
 
 circular_buffer::~circular_buffer() {
@@ -186,7 +345,8 @@ circular_buffer::~circular_buffer() {
 
 #else
 circular_buffer::circular_buffer(const unsigned int buf_len,
-   const unsigned int item_size, const unsigned int overwrite) {
+   const unsigned int item_size, const unsigned int overwrite,
+   const unsigned int spsc) {
 
 	if(!buf_len)
 		throw std::runtime_error("circular_buffer: buffer len is 0");
@@ -194,6 +354,9 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 	if(!item_size)
 		throw std::runtime_error("circular_buffer: item size is 0");
 
+	if(spsc && overwrite)
+		throw std::runtime_error("circular_buffer: overwrite needs the lock");
+
 	// calculate buffer size
 	m_item_size = item_size;
 	m_buf_size = item_size * buf_len;
@@ -258,8 +421,14 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 	m_item_size = item_size;
 
 	m_overwrite = overwrite;
+	m_spsc = spsc;
+
+	m_readers = 0;
+	memset(m_reader_read, 0, sizeof(m_reader_read));
+	memset(m_reader_overruns, 0, sizeof(m_reader_overruns));
 
 	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_space_cond, 0);
 
   }
 
@@ -269,7 +438,7 @@ circular_buffer::~circular_buffer() {
 	CloseHandle(d_handle);
 }
 #endif
-#else /* !D_HOST_OSX */
+#else /* HAVE_MEMFD_CREATE */
 
 
 /*
@@ -279,7 +448,8 @@ circular_buffer::~circular_buffer() {
  * was a reason.
  */
 circular_buffer::circular_buffer(const unsigned int buf_len,
-   const unsigned int item_size, const unsigned int overwrite) {
+   const unsigned int item_size, const unsigned int overwrite,
+   const unsigned int spsc) {
 
 	int shm_fd;
 	char shm_name[255]; // XXX should be NAME_MAX
@@ -291,6 +461,9 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 	if(!item_size)
 		throw std::runtime_error("circular_buffer: item size is 0");
 
+	if(spsc && overwrite)
+		throw std::runtime_error("circular_buffer: overwrite needs the lock");
+
 	// calculate buffer size
 	m_item_size = item_size;
 	m_buf_size = item_size * buf_len;
@@ -378,8 +551,14 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 	m_item_size = item_size;
 
 	m_overwrite = overwrite;
+	m_spsc = spsc;
+
+	m_readers = 0;
+	memset(m_reader_read, 0, sizeof(m_reader_read));
+	memset(m_reader_overruns, 0, sizeof(m_reader_overruns));
 
 	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_space_cond, 0);
 }
 
 
@@ -387,7 +566,7 @@ circular_buffer::~circular_buffer() {
 
 	munmap(m_base, 2 * m_pagesize + 2 * m_buf_size);
 }
-#endif /* !D_HOST_OSX */
+#endif /* HAVE_MEMFD_CREATE */
 
 
 /*
@@ -398,6 +577,10 @@ unsigned int circular_buffer::data_available() {
 
 	unsigned int amt;
 
+	if(m_spsc)
+		return __atomic_load_n(&m_written, __ATOMIC_ACQUIRE) -
+		   __atomic_load_n(&m_read, __ATOMIC_ACQUIRE);
+
 	pthread_mutex_lock(&m_mutex);
 	amt = m_written - m_read;	// item_size
 	pthread_mutex_unlock(&m_mutex);
@@ -410,8 +593,12 @@ unsigned int circular_buffer::space_available() {
 
 	unsigned int amt;
 
+	if(m_spsc)
+		return m_buf_len - (__atomic_load_n(&m_written, __ATOMIC_ACQUIRE) -
+		   __atomic_load_n(&m_read, __ATOMIC_ACQUIRE));
+
 	pthread_mutex_lock(&m_mutex);
-	amt = m_buf_len - (m_written - m_read);
+	amt = m_buf_len - (m_written - tail());
 	pthread_mutex_unlock(&m_mutex);
 
 	return amt;
@@ -422,6 +609,58 @@ unsigned int circular_buffer::space_available() {
 #define MIN(a, b) ((a)<(b)?(a):(b))
 #endif /* !MIN */
 
+
+/*
+ * Lock-free single-producer/single-consumer mode.
+ *
+ * m_written is only stored by the producer and m_read only by the consumer.
+ * Each side publishes its own counter with release semantics once it is done
+ * with the data and loads the other side's counter with acquire semantics
+ * before it touches the data.  The counters are never reset, the byte offsets
+ * are derived from them instead of being kept in m_r and m_w.
+ */
+inline unsigned int circular_buffer::offset(unsigned long long count) {
+
+	return (count * m_item_size) % m_buf_size;
+}
+
+
+unsigned int circular_buffer::spsc_read(void *buf, const unsigned int buf_len,
+   const int copy) {
+
+	unsigned long long r;
+	unsigned int len, avail;
+
+	// the producer's counter is loaded once, the copy and the new m_read
+	// must agree on how much there was
+	r = __atomic_load_n(&m_read, __ATOMIC_RELAXED);
+	avail = __atomic_load_n(&m_written, __ATOMIC_ACQUIRE) - r;
+	len = (buf_len < avail)? buf_len : avail;
+	if(copy)
+		memcpy(buf, (char *)m_buf + offset(r), len * m_item_size);
+	__atomic_store_n(&m_read, r + len, __ATOMIC_RELEASE);
+
+	return len;
+}
+
+
+unsigned int circular_buffer::spsc_write(const void *buf,
+   const unsigned int buf_len, const int copy) {
+
+	unsigned long long w;
+	unsigned int len, space;
+
+	// likewise the consumer's
+	w = __atomic_load_n(&m_written, __ATOMIC_RELAXED);
+	space = m_buf_len - (w - __atomic_load_n(&m_read, __ATOMIC_ACQUIRE));
+	len = (buf_len < space)? buf_len : space;
+	if(copy)
+		memcpy((char *)m_buf + offset(w), buf, len * m_item_size);
+	__atomic_store_n(&m_written, w + len, __ATOMIC_RELEASE);
+
+	return len;
+}
+
 /*
  * m_buf_size is in terms of bytes
  * m_r and m_w are offsets in bytes
@@ -433,15 +672,19 @@ unsigned int circular_buffer::read(void *buf, const unsigned int buf_len) {
 
 	unsigned int len;
 
+	if(m_spsc)
+		return spsc_read(buf, buf_len, 1);
+
 	pthread_mutex_lock(&m_mutex);
 	len = MIN(buf_len, m_written - m_read);
 	memcpy(buf, (char *)m_buf + m_r, len * m_item_size);
 	m_read += len;
-	if(m_read == m_written) {
+	if(!m_readers && (m_read == m_written)) {
 		m_r = m_w = 0;
 		m_read = m_written = 0;
 	} else
 		m_r = (m_r + len * m_item_size) % m_buf_size;
+	pthread_cond_broadcast(&m_space_cond);
 	pthread_mutex_unlock(&m_mutex);
 
 	return len;
@@ -457,8 +700,16 @@ unsigned int circular_buffer::read(void *buf, const unsigned int buf_len) {
 void *circular_buffer::peek(unsigned int *buf_len) {
 
 	unsigned int len;
+	unsigned long long r;
 	void *p;
 
+	if(m_spsc) {
+		r = __atomic_load_n(&m_read, __ATOMIC_RELAXED);
+		if(buf_len)
+			*buf_len = __atomic_load_n(&m_written, __ATOMIC_ACQUIRE) - r;
+		return (char *)m_buf + offset(r);
+	}
+
 	pthread_mutex_lock(&m_mutex);
 	len = m_written - m_read;
 	p = (char *)m_buf + m_r;
@@ -474,10 +725,19 @@ void *circular_buffer::peek(unsigned int *buf_len) {
 void *circular_buffer::poke(unsigned int *buf_len) {
 
 	unsigned int len;
+	unsigned long long w;
 	void *p;
 
+	if(m_spsc) {
+		w = __atomic_load_n(&m_written, __ATOMIC_RELAXED);
+		if(buf_len)
+			*buf_len = m_buf_len -
+			   (w - __atomic_load_n(&m_read, __ATOMIC_ACQUIRE));
+		return (char *)m_buf + offset(w);
+	}
+
 	pthread_mutex_lock(&m_mutex);
-	len = m_buf_len - (m_written - m_read);
+	len = m_buf_len - (m_written - tail());
 	p = (char *)m_buf + m_w;
 	pthread_mutex_unlock(&m_mutex);
 
@@ -492,14 +752,18 @@ unsigned int circular_buffer::purge(const unsigned int buf_len) {
 
 	unsigned int len;
 
+	if(m_spsc)
+		return spsc_read(0, buf_len, 0);
+
 	pthread_mutex_lock(&m_mutex);
 	len = MIN(buf_len, m_written - m_read);
 	m_read += len;
-	if(m_read == m_written) {
+	if(!m_readers && (m_read == m_written)) {
 		m_r = m_w = 0;
 		m_read = m_written = 0;
 	} else
 		m_r = (m_r + len * m_item_size) % m_buf_size;
+	pthread_cond_broadcast(&m_space_cond);
 	pthread_mutex_unlock(&m_mutex);
 
 	return len;
@@ -511,6 +775,9 @@ unsigned int circular_buffer::write(const void *buf,
 
 	unsigned int len, buf_off = 0;
 
+	if(m_spsc)
+		return spsc_write(buf, buf_len, 1);
+
 	pthread_mutex_lock(&m_mutex);
 	if(m_overwrite) {
 		if(buf_len > m_buf_len) {
@@ -519,7 +786,7 @@ unsigned int circular_buffer::write(const void *buf,
 		} else
 			len = buf_len;
 	} else
-		len = MIN(buf_len, m_buf_len - (m_written - m_read));
+		len = MIN(buf_len, m_buf_len - (m_written - tail()));
 	memcpy((char *)m_buf + m_w, (char *)buf + buf_off * m_item_size,
 	   len * m_item_size);
 	m_written += len;
@@ -528,6 +795,8 @@ unsigned int circular_buffer::write(const void *buf,
 		m_read = m_written - m_buf_len;
 		m_r = m_w;
 	}
+	if(m_readers)
+		advance_readers();
 	pthread_mutex_unlock(&m_mutex);
 
 	return len;
@@ -536,26 +805,50 @@ unsigned int circular_buffer::write(const void *buf,
 
 void circular_buffer::wrote(unsigned int len) {
 
+	if(m_spsc) {
+		spsc_write(0, len, 0);
+		return;
+	}
+
 	pthread_mutex_lock(&m_mutex);
 	m_written += len;
 	m_w = (m_w + len * m_item_size) % m_buf_size;
+	if(m_readers)
+		advance_readers();
 	pthread_mutex_unlock(&m_mutex);
 }
 
 
+/*
+ * In single-producer/single-consumer mode flush() belongs to the consumer and
+ * discards whatever has been written so far.
+ */
 void circular_buffer::flush() {
 
+	if(m_spsc) {
+		flush_nolock();
+		return;
+	}
+
 	pthread_mutex_lock(&m_mutex);
-	m_read = m_written = 0;
-	m_r = m_w = 0;
+	flush_nolock();
 	pthread_mutex_unlock(&m_mutex);
 }
 
 
 void circular_buffer::flush_nolock() {
 
+	if(m_spsc) {
+		__atomic_store_n(&m_read,
+		   __atomic_load_n(&m_written, __ATOMIC_ACQUIRE),
+		   __ATOMIC_RELEASE);
+		return;
+	}
+
 	m_read = m_written = 0;
 	m_r = m_w = 0;
+	memset(m_reader_read, 0, sizeof(m_reader_read));
+	pthread_cond_broadcast(&m_space_cond);
 }
 
 
@@ -575,3 +868,155 @@ unsigned int circular_buffer::buf_len() {
 
 	return m_buf_len;
 }
+
+
+/*
+ * Broadcast mode.
+ *
+ * Every reader has its own cursor in m_reader_read, the plain read() and
+ * purge() keep using m_read.  While readers are attached the counters
+ * aren't reset when the buffer runs empty, the cursors are absolute.
+ */
+int circular_buffer::add_reader() {
+
+	int i;
+
+	if(m_spsc)
+		throw std::runtime_error("circular_buffer: readers need the lock");
+
+	pthread_mutex_lock(&m_mutex);
+	for(i = 0; (i < MAX_READERS) && (m_readers & (1 << i)); i++)
+		;
+	if(i == MAX_READERS) {
+		pthread_mutex_unlock(&m_mutex);
+		return -1;
+	}
+
+	// a new reader starts with what the plain reader hasn't read yet
+	m_readers |= 1 << i;
+	m_reader_read[i] = m_read;
+	m_reader_overruns[i] = 0;
+	pthread_mutex_unlock(&m_mutex);
+
+	return i;
+}
+
+
+void circular_buffer::remove_reader(int reader) {
+
+	pthread_mutex_lock(&m_mutex);
+	m_readers &= ~(1 << reader);
+	pthread_cond_broadcast(&m_space_cond);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+void *circular_buffer::peek(int reader, unsigned int *buf_len) {
+
+	unsigned int len;
+	void *p;
+
+	pthread_mutex_lock(&m_mutex);
+	len = m_written - m_reader_read[reader];
+	p = (char *)m_buf + offset(m_reader_read[reader]);
+	pthread_mutex_unlock(&m_mutex);
+
+	if(buf_len)
+		*buf_len = len;
+
+	return p;
+}
+
+
+unsigned int circular_buffer::purge(int reader, const unsigned int buf_len) {
+
+	unsigned int len;
+
+	pthread_mutex_lock(&m_mutex);
+	len = MIN(buf_len, m_written - m_reader_read[reader]);
+	m_reader_read[reader] += len;
+	pthread_cond_broadcast(&m_space_cond);
+	pthread_mutex_unlock(&m_mutex);
+
+	return len;
+}
+
+
+unsigned int circular_buffer::data_available(int reader) {
+
+	unsigned int amt;
+
+	pthread_mutex_lock(&m_mutex);
+	amt = m_written - m_reader_read[reader];
+	pthread_mutex_unlock(&m_mutex);
+
+	return amt;
+}
+
+
+unsigned long long circular_buffer::overruns(int reader) {
+
+	unsigned long long n;
+
+	pthread_mutex_lock(&m_mutex);
+	n = m_reader_overruns[reader];
+	pthread_mutex_unlock(&m_mutex);
+
+	return n;
+}
+
+
+/*
+ * Wait until len items, or the whole buffer, can be written.  Returns the
+ * space there is.
+ */
+unsigned int circular_buffer::wait_space(const unsigned int len) {
+
+	unsigned int amt;
+
+	pthread_mutex_lock(&m_mutex);
+	while(m_buf_len - (m_written - tail()) < MIN(len, m_buf_len))
+		pthread_cond_wait(&m_space_cond, &m_mutex);
+	amt = m_buf_len - (m_written - tail());
+	pthread_mutex_unlock(&m_mutex);
+
+	return amt;
+}
+
+
+/*
+ * With the lock held, the slowest cursor.
+ */
+unsigned long long circular_buffer::tail() {
+
+	unsigned long long t = m_read;
+	int i;
+
+	for(i = 0; m_readers >> i; i++) {
+		if((m_readers & (1 << i)) && (m_reader_read[i] < t))
+			t = m_reader_read[i];
+	}
+
+	return t;
+}
+
+
+/*
+ * With the lock held, after an overwriting write: readers more than a
+ * buffer behind lose the oldest items.
+ */
+void circular_buffer::advance_readers() {
+
+	unsigned long long oldest;
+	int i;
+
+	if(!m_overwrite || (m_written <= m_buf_len))
+		return;
+	oldest = m_written - m_buf_len;
+	for(i = 0; m_readers >> i; i++) {
+		if((m_readers & (1 << i)) && (m_reader_read[i] < oldest)) {
+			m_reader_overruns[i] += oldest - m_reader_read[i];
+			m_reader_read[i] = oldest;
+		}
+	}
+}
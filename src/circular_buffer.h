@@ -49,9 +49,22 @@
 #include <Windows.h>
 #endif
 
+/*
+ * With spsc set, the buffer runs without its mutex: exactly one thread may
+ * write (write, poke, wrote) and exactly one thread may read (read, peek,
+ * purge, flush).  This mode can't be combined with overwrite.
+ *
+ * More readers can be attached with add_reader(), each with its own read
+ * cursor over the same mapping and zero-copy peek(reader) and
+ * purge(reader).  The producer only gets the space the slowest of them,
+ * plain read() and purge() included, is done with.  It can wait for it
+ * with wait_space(), or with overwrite it goes on and a reader that falls
+ * a buffer behind loses the oldest items, counted in overruns(reader).
+ * Readers need the mutex.
+ */
 class circular_buffer {
 public:
-	circular_buffer(const unsigned int buf_len, const unsigned int item_size = 1, const unsigned int overwrite = 0);
+	circular_buffer(const unsigned int buf_len, const unsigned int item_size = 1, const unsigned int overwrite = 0, const unsigned int spsc = 0);
 	~circular_buffer();
 
 	unsigned int read(void *buf, const unsigned int buf_len);
@@ -68,7 +81,23 @@ public:
 	void unlock();
 	unsigned int buf_len();
 
+	int add_reader();
+	void remove_reader(int reader);
+	void *peek(int reader, unsigned int *buf_len);
+	unsigned int purge(int reader, const unsigned int buf_len);
+	unsigned int data_available(int reader);
+	unsigned long long overruns(int reader);
+	unsigned int wait_space(const unsigned int len);
+
+	static const int MAX_READERS = 8;
+
 private:
+	inline unsigned int offset(unsigned long long count);
+	unsigned int spsc_read(void *buf, const unsigned int buf_len, const int copy);
+	unsigned int spsc_write(const void *buf, const unsigned int buf_len, const int copy);
+	unsigned long long tail();
+	void advance_readers();
+
 #ifdef _WIN32
 	HANDLE d_handle;
 	LPVOID d_first_copy;
@@ -79,9 +108,15 @@ private:
 	unsigned long long m_read, m_written;
 
 	unsigned int m_overwrite;
+	unsigned int m_spsc;
 
 	void *m_base;
 	unsigned int m_pagesize;
 
+	unsigned int m_readers;
+	unsigned long long m_reader_read[MAX_READERS];
+	unsigned long long m_reader_overruns[MAX_READERS];
+
 	pthread_mutex_t	m_mutex;
+	pthread_cond_t	m_space_cond;
 };
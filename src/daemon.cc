@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "sample_source.h"
+#include "pipeline.h"
+#include "arfcn_freq.h"
+#include "offset.h"
+#include "c0_detect.h"
+#include "daemon.h"
+
+extern int g_verbosity;
+
+static const int	MAX_ARGS	= 16;
+static const int	MAX_BANDS	= 8;
+static const int	RECV_TIMEOUT	= 5;
+
+enum {
+	JOB_ERROR = -1,
+	JOB_DONE,
+	JOB_QUIT
+};
+
+
+/*
+ * Calibrate on freq, as kal -f does.
+ */
+static int job_offset(sample_source *u, scan_pipeline *p, double freq,
+   double target_ppm, double max_time) {
+
+	int bi = BI_NOT_DEFINED, chan;
+
+	if((freq < 869e6) || (2e9 < freq)) {
+		printf("error: bad frequency: %lf\n", freq);
+		return -1;
+	}
+	if(!u->tune(freq)) {
+		fprintf(stderr, "error: usrp_source::tune\n");
+		return -1;
+	}
+	chan = freq_to_arfcn(freq, &bi);
+	printf("Using %s channel %d (%.1fMHz)\n", bi_to_str(bi), chan,
+	   freq / 1e6);
+	fflush(stdout);
+
+	return offset_detect(u, p, target_ppm, max_time);
+}
+
+
+/*
+ * Run one request line, its output going to stdout.
+ */
+static int run_job(sample_source *u, scan_pipeline *p, char *line) {
+
+	char *argv[MAX_ARGS], *v;
+	int i, argc, chan = -1, bi = BI_NOT_DEFINED, nbands = 0;
+	int bands[MAX_BANDS];
+	double freq = -1.0, sweep_rate = 0.0, target_ppm = 0.0, max_time = 0.0;
+	sweep_chan c0;
+
+	// split first, str_to_bands() has a strtok() of its own
+	for(argc = 0; argc < MAX_ARGS; argc++) {
+		if(!(argv[argc] = strtok(argc? 0 : line, " \t\r\n")))
+			break;
+	}
+	if(!argc) {
+		printf("error: empty request\n");
+		return JOB_ERROR;
+	}
+	if(!strcmp(argv[0], "quit"))
+		return JOB_QUIT;
+
+	for(i = 1; i < argc; i++) {
+		if(!(v = strchr(argv[i], '='))) {
+			printf("error: bad argument: ``%s''\n", argv[i]);
+			return JOB_ERROR;
+		}
+		*v++ = 0;
+		if(!strcmp(argv[i], "chan"))
+			chan = strtoul(v, 0, 0);
+		else if(!strcmp(argv[i], "freq"))
+			freq = strtod(v, 0);
+		else if(!strcmp(argv[i], "band")) {
+			if((bi = str_to_bi(v)) == -1) {
+				printf("error: bad band indicator: ``%s''\n", v);
+				return JOB_ERROR;
+			}
+		} else if(!strcmp(argv[i], "bands")) {
+			if((nbands = str_to_bands(v, bands, MAX_BANDS)) <= 0) {
+				printf("error: bad bands: ``%s''\n", v);
+				return JOB_ERROR;
+			}
+		} else if(!strcmp(argv[i], "sweep"))
+			sweep_rate = strtod(v, 0);
+		else if(!strcmp(argv[i], "ppm"))
+			target_ppm = strtod(v, 0);
+		else if(!strcmp(argv[i], "time"))
+			max_time = strtod(v, 0);
+		else {
+			printf("error: unknown argument: ``%s''\n", argv[i]);
+			return JOB_ERROR;
+		}
+	}
+
+	if(!strcmp(argv[0], "offset")) {
+		if((freq < 0.0) && (chan >= 0))
+			freq = arfcn_to_freq(chan, &bi);
+		return job_offset(u, p, freq, target_ppm, max_time)? JOB_ERROR : JOB_DONE;
+	}
+
+	if(!nbands) {
+		printf("error: %s requires bands\n", argv[0]);
+		return JOB_ERROR;
+	}
+	if(!strcmp(argv[0], "scan"))
+		return c0_detect(u, bands, nbands, sweep_rate, p)? JOB_ERROR : JOB_DONE;
+	if(!strcmp(argv[0], "find")) {
+		if(c0_find(u, bands, nbands, sweep_rate, p, &c0))
+			return JOB_ERROR;
+		return job_offset(u, p, c0.freq, target_ppm, max_time)? JOB_ERROR : JOB_DONE;
+	}
+
+	printf("error: unknown command: ``%s''\n", argv[0]);
+	return JOB_ERROR;
+}
+
+
+/*
+ * Read the request line, run it with stdout on the connection and leave
+ * the pipeline empty for the next one.  The source keeps streaming between
+ * jobs unless one failed.
+ */
+static int serve(sample_source *u, scan_pipeline *p, int fd) {
+
+	char line[BUFSIZ];
+	unsigned int len = 0;
+	int n, r, saved;
+	struct timeval tv;
+	scan_job *j;
+
+	tv.tv_sec = RECV_TIMEOUT;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	while(len < sizeof(line) - 1) {
+		if((n = read(fd, line + len, sizeof(line) - 1 - len)) <= 0)
+			break;
+		len += n;
+		if(memchr(line + len - n, '\n', n))
+			break;
+	}
+	line[len] = 0;
+	if(!len)
+		return JOB_ERROR;
+	if(g_verbosity > 0)
+		fprintf(stderr, "request: %s", line);
+
+	fflush(stdout);
+	if((saved = dup(1)) == -1) {
+		fprintf(stderr, "error: dup: %s\n", strerror(errno));
+		return JOB_ERROR;
+	}
+	dup2(fd, 1);
+
+	r = run_job(u, p, line);
+	while((j = p->wait_done()))
+		p->put_job(j);
+	if(r == JOB_ERROR)
+		u->stop();
+
+	printf("status: %d\n", (r == JOB_ERROR)? -1 : 0);
+	fflush(stdout);
+	dup2(saved, 1);
+	close(saved);
+
+	return r;
+}
+
+
+int kal_daemon(sample_source *u, scan_pipeline *p, const char *path) {
+
+	int s, t, fd, r = JOB_DONE;
+	struct sockaddr_un addr;
+	struct stat st;
+
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "error: socket path too long: %s\n", path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if((s = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		fprintf(stderr, "error: socket: %s\n", strerror(errno));
+		return -1;
+	}
+	// only a socket left behind by an earlier run is taken over
+	if(!lstat(path, &st)) {
+		if(!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "error: %s exists and is not a socket\n",
+			   path);
+			close(s);
+			return -1;
+		}
+		if((t = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+			fprintf(stderr, "error: socket: %s\n", strerror(errno));
+			close(s);
+			return -1;
+		}
+		if(!connect(t, (struct sockaddr *)&addr, sizeof(addr)) ||
+		   (errno != ECONNREFUSED)) {
+			fprintf(stderr, "error: %s is already in use\n", path);
+			close(t);
+			close(s);
+			return -1;
+		}
+		close(t);
+		unlink(path);
+	}
+	if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) ||
+	   listen(s, 8)) {
+		fprintf(stderr, "error: %s: %s\n", path, strerror(errno));
+		close(s);
+		return -1;
+	}
+
+	// a client that goes away mid-job mustn't take the daemon with it
+	signal(SIGPIPE, SIG_IGN);
+
+	fprintf(stderr, "listening on %s\n", path);
+	while(r != JOB_QUIT) {
+		if((fd = accept(s, 0, 0)) == -1) {
+			if(errno == EINTR)
+				continue;
+			fprintf(stderr, "error: accept: %s\n", strerror(errno));
+			break;
+		}
+		r = serve(u, p, fd);
+		close(fd);
+	}
+
+	close(s);
+	unlink(path);
+	u->stop();
+
+	return (r == JOB_QUIT)? 0 : -1;
+}
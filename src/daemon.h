@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Calibration daemon
+ *
+ * Keeps the source open and the detectors planned, and takes measurement
+ * jobs one at a time from clients on a UNIX socket.  A client sends one
+ * line, a command followed by key=value arguments,
+ *
+ *	offset chan=ARFCN|freq=HZ [band=BAND] [ppm=TARGET] [time=SECONDS]
+ *	scan bands=BAND[,BAND...] [sweep=RATE]
+ *	find bands=BAND[,BAND...] [sweep=RATE] [ppm=TARGET] [time=SECONDS]
+ *	quit
+ *
+ * and gets back what kal would have printed on stdout for the same options
+ * followed by a "status: N" line, then the connection is closed.
+ */
+
+#pragma once
+
+class sample_source;
+class scan_pipeline;
+
+int kal_daemon(sample_source *u, scan_pipeline *p, const char *path);
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include "decimator.h"
+#include "util.h"
+
+
+decimator::decimator(const unsigned int factor,
+   const unsigned int taps_per_phase) {
+
+	unsigned int i;
+	float *h;
+
+	if(!factor)
+		throw std::runtime_error("decimator: factor must be at least 1");
+
+	m_factor = factor;
+	m_h_len = factor * taps_per_phase;
+
+	/*
+	 * The cutoff sits a little inside the output Nyquist frequency.  The
+	 * transition band folds back onto the edges of the output band, the
+	 * adjacent channel at 200kHz lands in the stop band.
+	 */
+	h = new float[m_h_len];
+	lowpass(h, m_h_len, 0.45 / factor);
+
+	// reversed, so each output is a straight dot product
+	m_h = new float[m_h_len];
+	for(i = 0; i < m_h_len; i++)
+		m_h[i] = h[m_h_len - 1 - i];
+	delete[] h;
+
+	m_buf_len = 0;
+	m_buf = 0;
+	reset();
+}
+
+
+decimator::~decimator() {
+
+	delete[] m_buf;
+	delete[] m_h;
+}
+
+
+/*
+ * Forget the filter history, e.g., after a retune.
+ */
+void decimator::reset() {
+
+	if(m_buf)
+		std::fill_n(m_buf, m_h_len - 1, complex(0, 0));
+	m_phase = 0;
+}
+
+
+/*
+ * Most output samples wrote() can produce from len input samples.
+ */
+unsigned int decimator::max_out(unsigned int len) {
+
+	return (len + m_factor - 1) / m_factor;
+}
+
+
+/*
+ * Return room for len input samples, following the filter history.
+ */
+complex *decimator::poke(unsigned int len) {
+
+	complex *b;
+
+	if(m_h_len - 1 + len > m_buf_len) {
+		// complex() is zero, a new buffer starts with a clear history
+		b = new complex[m_h_len - 1 + len];
+		if(m_buf) {
+			memcpy(b, m_buf, (m_h_len - 1) * sizeof(complex));
+			delete[] m_buf;
+		}
+		m_buf = b;
+		m_buf_len = m_h_len - 1 + len;
+	}
+
+	return m_buf + m_h_len - 1;
+}
+
+
+/*
+ * Filter the len samples written after poke() into out.  Returns the number
+ * of output samples, at most max_out(len).
+ */
+unsigned int decimator::wrote(unsigned int len, complex *out) {
+
+	unsigned int n, t, i, end = m_h_len - 1 + len;
+	float re, im;
+	const float *x;
+
+	for(n = 0, t = m_h_len - 1 + m_phase; t < end; n++, t += m_factor) {
+		x = (const float *)(m_buf + t + 1 - m_h_len);
+		re = im = 0.0;
+		for(i = 0; i < m_h_len; i++) {
+			re += m_h[i] * x[2 * i];
+			im += m_h[i] * x[2 * i + 1];
+		}
+		out[n] = complex(re, im);
+	}
+	m_phase = t - end;
+
+	// keep the history for the next block
+	memmove(m_buf, m_buf + len, (m_h_len - 1) * sizeof(complex));
+
+	return n;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * decimator
+ *
+ * Decimating FIR for bringing a receiver's native rate down to the GSM rate.
+ * Only every factor'th output is computed, which is the polyphase form of
+ * the filter written out directly.  Input is written in place with poke()
+ * and wrote(), like circular_buffer, and the filter history is carried over
+ * between blocks.
+ */
+
+#pragma once
+
+#include "usrp_complex.h"
+
+class decimator {
+public:
+	decimator(const unsigned int factor, const unsigned int taps_per_phase = 24);
+	~decimator();
+
+	complex *poke(unsigned int len);
+	unsigned int wrote(unsigned int len, complex *out);
+	unsigned int max_out(unsigned int len);
+	void reset();
+
+	unsigned int factor() { return m_factor; };
+
+private:
+	unsigned int	m_factor,
+			m_h_len,
+			m_buf_len,
+			m_phase;
+	float		*m_h;
+	complex		*m_buf;
+};
@@ -0,0 +1,706 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * dev_emu
+ *
+ * A stand-in for librtlsdr, or libxtrx when built with XTRX_DEV, with the
+ * timing of the real device and no hardware.  Preload it,
+ *
+ *	LD_PRELOAD=./libkal_emu.so kal -s GSM900
+ *
+ * and usrp_source or xtrx_source talk to it as to the library.
+ *
+ * The device samples at the real rate from the moment streaming starts,
+ * whether anyone reads or not.  A read waits until the last sample it
+ * asks for has been taken, plus a random delay of up to the transfer
+ * jitter, as a USB or DMA transfer completes.  The device holds only
+ * so many samples; when the consumer lags further behind, the oldest are
+ * lost and an overrun is counted.  librtlsdr says nothing about it, the
+ * stream just jumps ahead, xtrx_recv_sync_ex() returns short.  Retuning
+ * blocks the caller for the tune latency while the stream runs on at the
+ * old frequency, and the new frequency shows from the sample taken when
+ * the tune returns.  For the settling time after that a DC step fades out
+ * while the signal fades in, as the PLL locks.
+ *
+ * The samples themselves come from a synth_source, lost samples aren't
+ * generated.  The environment sets it up,
+ *
+ *	KAL_EMU_SIGNAL	synth_source spec, default "synth"
+ *	KAL_EMU_JITTER	transfer jitter in us, default 500 (rtl), 50 (xtrx)
+ *	KAL_EMU_TUNE	tune latency in ms, default 20 (rtl), 2 (xtrx)
+ *	KAL_EMU_SETTLE	settling time in ms, default 0
+ *	KAL_EMU_FIFO	samples the device holds, default 65536 (rtl), the
+ *			async buffers when larger, 262144 (xtrx)
+ *
+ * Samples, overruns and tunes are reported on stderr at close.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef XTRX_DEV
+#include <xtrx_api.h>
+#else
+#include <rtl-sdr.h>
+#endif
+
+#include "synth_source.h"
+
+int g_verbosity = 0;
+
+#ifdef XTRX_DEV
+static const char *EMU_NAME = "xtrx";
+static const double DEF_JITTER = 50e-6;
+static const double DEF_TUNE = 2e-3;
+static const unsigned int DEF_FIFO = 262144;
+static const double DEF_RATE = 13e6 / 48.0;
+static const float SCALE = 8.0;		// C0 at about -12 dBFS of 32767
+#else
+static const char *EMU_NAME = "rtl";
+static const double DEF_JITTER = 500e-6;
+static const double DEF_TUNE = 20e-3;
+static const unsigned int DEF_FIFO = 65536;
+static const double DEF_RATE = 2048000.0;
+static const float SCALE = 0.04;	// C0 at about 40 counts
+#endif
+
+static const unsigned int MAX_EVENTS = 16;
+static const float SETTLE_DC = 3000.0;	// three times the synthetic C0
+static const unsigned int GEN_LEN = 4096;
+
+
+struct emu_dev {
+	pthread_mutex_t		mutex;
+	synth_source		*syn;
+
+	double			rate,
+				freq,
+				jitter,
+				tune_latency,
+				settle,
+				settle_end,
+				t0;
+	unsigned int		fifo,
+				running,
+				seed;
+	volatile int		cancel;
+
+	unsigned long long	taken,		// samples handed out or lost
+				delivered,
+				dropped;
+	unsigned int		overruns,
+				tunes;
+
+	// retunes that take effect at a sample not yet handed out
+	struct {
+		unsigned long long	at;
+		double			freq;
+	}			events[MAX_EVENTS];
+	unsigned int		nevents;
+
+	complex			gen[GEN_LEN];
+};
+
+
+static double now() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void sleep_until(double t) {
+
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)t;
+	ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR)
+		;
+}
+
+
+static double env(const char *name, double def) {
+
+	const char *v = getenv(name);
+
+	return (v && *v)? strtod(v, 0) : def;
+}
+
+
+static emu_dev *emu_open() {
+
+	const char *spec = getenv("KAL_EMU_SIGNAL");
+	emu_dev *d = new emu_dev;
+
+	pthread_mutex_init(&d->mutex, 0);
+	d->syn = new synth_source((spec && *spec)? spec : "synth");
+	if(d->syn->open(0)) {
+		delete d->syn;
+		delete d;
+		return 0;
+	}
+	d->rate = DEF_RATE;
+	d->freq = 0.0;
+	d->jitter = env("KAL_EMU_JITTER", DEF_JITTER * 1e6) * 1e-6;
+	d->tune_latency = env("KAL_EMU_TUNE", DEF_TUNE * 1e3) * 1e-3;
+	d->settle = env("KAL_EMU_SETTLE", 0.0) * 1e-3;
+	d->settle_end = 0.0;
+	d->fifo = (unsigned int)env("KAL_EMU_FIFO", DEF_FIFO);
+	d->t0 = 0.0;
+	d->running = d->cancel = 0;
+	d->seed = 1;
+	d->taken = d->delivered = d->dropped = 0;
+	d->overruns = d->tunes = 0;
+	d->nevents = 0;
+	d->syn->set_sample_rate(d->rate);
+
+	return d;
+}
+
+
+static void emu_close(emu_dev *d) {
+
+	double secs = d->delivered / d->rate;
+
+	fprintf(stderr, "%s emulator: %llu samples (%.1fs), %u overruns, "
+	   "%llu samples lost, %u tunes\n", EMU_NAME, d->delivered, secs,
+	   d->overruns, d->dropped, d->tunes);
+	pthread_mutex_destroy(&d->mutex);
+	delete d->syn;
+	delete d;
+}
+
+
+/*
+ * Retunes queued while streaming take effect now.  Called with the mutex
+ * held.
+ */
+static void apply_events(emu_dev *d) {
+
+	if(d->nevents) {
+		d->syn->tune(d->events[d->nevents - 1].freq);
+		d->nevents = 0;
+	}
+}
+
+
+/*
+ * Streaming (re)starts with the next read.
+ */
+static void emu_restart(emu_dev *d) {
+
+	pthread_mutex_lock(&d->mutex);
+	apply_events(d);
+	d->running = 0;
+	pthread_mutex_unlock(&d->mutex);
+}
+
+
+static void emu_set_rate(emu_dev *d, double rate) {
+
+	pthread_mutex_lock(&d->mutex);
+	apply_events(d);
+	d->rate = rate;
+	d->running = 0;
+	d->syn->set_sample_rate(rate);
+	pthread_mutex_unlock(&d->mutex);
+}
+
+
+/*
+ * The synthesizer, PLL and I2C traffic take tune_latency.  The stream
+ * doesn't stop, what is taken meanwhile is still at the old frequency.
+ */
+static void emu_tune(emu_dev *d, double freq) {
+
+	if(d->tune_latency > 0.0)
+		sleep_until(now() + d->tune_latency);
+
+	pthread_mutex_lock(&d->mutex);
+	d->freq = freq;
+	d->tunes++;
+	d->settle_end = now() + d->settle;
+	if(!d->running) {
+		apply_events(d);
+		d->syn->tune(freq);
+	} else {
+		if(d->nevents == MAX_EVENTS) {
+			// collapse the oldest, their samples are long lost anyway
+			d->syn->tune(d->events[0].freq);
+			memmove(d->events, d->events + 1, (MAX_EVENTS - 1) * sizeof(d->events[0]));
+			d->nevents--;
+		}
+		d->events[d->nevents].at = (unsigned long long)((now() - d->t0) * d->rate);
+		d->events[d->nevents].freq = freq;
+		d->nevents++;
+	}
+	pthread_mutex_unlock(&d->mutex);
+}
+
+
+/*
+ * Samples from position pos on taken while the last retune settled.
+ */
+static void unsettle(emu_dev *d, unsigned long long pos, complex *out,
+   unsigned int len) {
+
+	unsigned int i;
+	double f;
+
+	for(i = 0; i < len; i++) {
+		f = (d->settle_end - d->t0 - (pos + i) / d->rate) / d->settle;
+		if(f <= 0.0)
+			break;
+		if(f > 1.0)
+			continue;
+		out[i] = out[i] * (float)(1.0 - f) + complex(SETTLE_DC * f, 0.0);
+	}
+}
+
+
+/*
+ * Samples from position pos on, with the retunes due by then applied.
+ */
+static void generate(emu_dev *d, unsigned long long pos, complex *out,
+   unsigned int len) {
+
+	unsigned int n, avail;
+	unsigned long long at;
+	circular_buffer *cb = d->syn->get_buffer();
+
+	while(len) {
+		n = len;
+		while(d->nevents && (d->events[0].at <= pos)) {
+			d->syn->tune(d->events[0].freq);
+			memmove(d->events, d->events + 1, (d->nevents - 1) * sizeof(d->events[0]));
+			d->nevents--;
+		}
+		if(d->nevents && ((at = d->events[0].at) < pos + n))
+			n = (unsigned int)(at - pos);
+
+		avail = cb->data_available();
+		if(avail < n) {
+			d->syn->fill(n, 0);
+			avail = cb->data_available();
+		}
+		if(n > avail)
+			n = avail;
+		cb->read(out, n);
+		if((d->settle > 0.0) &&
+		   (d->settle_end > d->t0 + pos / d->rate))
+			unsettle(d, pos, out, n);
+		out += n;
+		pos += n;
+		len -= n;
+	}
+}
+
+
+/*
+ * Take len samples off the stream, passing them to sink as they are
+ * generated, and wait for the device to have sampled them.  Returns len,
+ * or 0 on an overrun when stop_on_overrun.
+ */
+typedef void (*emu_sink)(void *ctx, const complex *in, unsigned int off, unsigned int len);
+
+static unsigned int emu_read(emu_dev *d, unsigned int len, int stop_on_overrun,
+   emu_sink sink, void *ctx) {
+
+	unsigned long long produced, pos, lag;
+	unsigned int n, done;
+	double t, due;
+
+	pthread_mutex_lock(&d->mutex);
+	t = now();
+	if(!d->running) {
+		d->running = 1;
+		d->t0 = t;
+		d->taken = 0;
+	}
+
+	// what the consumer left too long is gone
+	produced = (unsigned long long)((t - d->t0) * d->rate);
+	if(produced > d->taken + d->fifo) {
+		lag = produced - d->taken - d->fifo;
+		d->taken += lag;
+		d->dropped += lag;
+		d->overruns++;
+		if(g_verbosity > 0)
+			fprintf(stderr, "%s emulator: overrun, %llu samples lost\n", EMU_NAME, lag);
+		if(stop_on_overrun) {
+			pthread_mutex_unlock(&d->mutex);
+			return 0;
+		}
+	}
+
+	pos = d->taken;
+	d->taken += len;
+	due = d->t0 + d->taken / d->rate;
+	d->seed = d->seed * 1103515245 + 12345;
+	due += d->jitter * ((d->seed >> 8) & 0xffff) / 65536.0;
+
+	for(done = 0; done < len; done += n) {
+		n = len - done;
+		if(n > GEN_LEN)
+			n = GEN_LEN;
+		generate(d, pos + done, d->gen, n);
+		sink(ctx, d->gen, done, n);
+	}
+	d->delivered += len;
+	pthread_mutex_unlock(&d->mutex);
+
+	// the transfer completes when its last sample has been taken
+	sleep_until(due);
+
+	return len;
+}
+
+
+#ifdef XTRX_DEV
+
+/*
+ * libxtrx
+ */
+
+struct xtrx_dev {
+	emu_dev		*d;
+};
+
+
+static void sink_cf32(void *ctx, const complex *in, unsigned int off,
+   unsigned int len) {
+
+	float *out = (float *)ctx + 2 * off;
+	unsigned int i;
+
+	for(i = 0; i < len; i++) {
+		out[2 * i] = in[i].real() * SCALE;
+		out[2 * i + 1] = in[i].imag() * SCALE;
+	}
+}
+
+
+int xtrx_open(const char *device, unsigned flags, struct xtrx_dev **dev) {
+
+	emu_dev *d;
+
+	if(!(d = emu_open()))
+		return -ENODEV;
+	*dev = new xtrx_dev;
+	(*dev)->d = d;
+	return 0;
+}
+
+
+void xtrx_close(struct xtrx_dev *dev) {
+
+	emu_close(dev->d);
+	delete dev;
+}
+
+
+int xtrx_set_ref_clk(struct xtrx_dev *dev, unsigned refclkhz,
+   xtrx_clock_source_t clksrc) {
+
+	return 0;
+}
+
+
+int xtrx_set_samplerate(struct xtrx_dev *dev, double cgen_rate, double rxrate,
+   double txrate, unsigned flags, double *actualcgen, double *actualrx,
+   double *actualtx) {
+
+	emu_set_rate(dev->d, rxrate);
+	if(actualcgen)
+		*actualcgen = cgen_rate;
+	if(actualrx)
+		*actualrx = rxrate;
+	if(actualtx)
+		*actualtx = txrate;
+	return 0;
+}
+
+
+int xtrx_tune(struct xtrx_dev *dev, xtrx_tune_t type, double freq,
+   double *actualfreq) {
+
+	emu_tune(dev->d, freq);
+	if(actualfreq)
+		*actualfreq = freq;
+	return 0;
+}
+
+
+int xtrx_tune_rx_bandwidth(struct xtrx_dev *dev, xtrx_channel_t ch, double bw,
+   double *actualbw) {
+
+	if(actualbw)
+		*actualbw = bw;
+	return 0;
+}
+
+
+int xtrx_set_gain(struct xtrx_dev *dev, xtrx_channel_t ch,
+   xtrx_gain_type_t gt, double gain, double *actualgain) {
+
+	if(actualgain)
+		*actualgain = gain;
+	return 0;
+}
+
+
+int xtrx_set_antenna(struct xtrx_dev *dev, xtrx_antenna_t antenna) {
+
+	return 0;
+}
+
+
+int xtrx_run_ex(struct xtrx_dev *dev, const xtrx_run_params_t *params) {
+
+	emu_restart(dev->d);
+	return 0;
+}
+
+
+int xtrx_stop(struct xtrx_dev *dev, xtrx_direction_t dir) {
+
+	emu_restart(dev->d);
+	return 0;
+}
+
+
+/*
+ * An overrun ends the read early, here before anything was received.
+ */
+int xtrx_recv_sync_ex(struct xtrx_dev *dev, xtrx_recv_ex_info_t *info) {
+
+	info->out_samples = emu_read(dev->d, info->samples, 1, sink_cf32,
+	   info->buffers[0]);
+	info->out_overrun_at = info->out_samples;
+	return 0;
+}
+
+#else
+
+/*
+ * librtlsdr
+ */
+
+struct rtlsdr_dev {
+	emu_dev		*d;
+	uint32_t	rate;
+	int		gain;
+};
+
+
+static void sink_cu8(void *ctx, const complex *in, unsigned int off,
+   unsigned int len) {
+
+	unsigned char *out = (unsigned char *)ctx + 2 * off;
+	unsigned int i;
+	float v;
+
+	for(i = 0; i < 2 * len; i++) {
+		v = 127.5f + ((i & 1)? in[i / 2].imag() : in[i / 2].real()) * SCALE;
+		out[i] = (v < 0.0f)? 0 : (v > 255.0f)? 255 : (unsigned char)v;
+	}
+}
+
+
+uint32_t rtlsdr_get_device_count(void) {
+
+	return 1;
+}
+
+
+const char *rtlsdr_get_device_name(uint32_t index) {
+
+	return index? "" : "Emulated RTL2832U";
+}
+
+
+int rtlsdr_get_device_usb_strings(uint32_t index, char *manufact,
+   char *product, char *serial) {
+
+	if(index)
+		return -1;
+	strcpy(manufact, "kal");
+	strcpy(product, "RTL2838UHIDIR emulator");
+	strcpy(serial, "EMU00001");
+	return 0;
+}
+
+
+int rtlsdr_open(rtlsdr_dev_t **dev, uint32_t index) {
+
+	emu_dev *d;
+
+	if(index || !(d = emu_open()))
+		return -1;
+	*dev = new rtlsdr_dev;
+	(*dev)->d = d;
+	(*dev)->rate = (uint32_t)DEF_RATE;
+	(*dev)->gain = 0;
+	return 0;
+}
+
+
+int rtlsdr_close(rtlsdr_dev_t *dev) {
+
+	emu_close(dev->d);
+	delete dev;
+	return 0;
+}
+
+
+int rtlsdr_set_center_freq(rtlsdr_dev_t *dev, uint32_t freq) {
+
+	emu_tune(dev->d, freq);
+	return 0;
+}
+
+
+uint32_t rtlsdr_get_center_freq(rtlsdr_dev_t *dev) {
+
+	return (uint32_t)dev->d->freq;
+}
+
+
+int rtlsdr_set_freq_correction(rtlsdr_dev_t *dev, int ppm) {
+
+	return 0;
+}
+
+
+int rtlsdr_set_tuner_gain(rtlsdr_dev_t *dev, int gain) {
+
+	dev->gain = gain;
+	return 0;
+}
+
+
+int rtlsdr_set_tuner_gain_mode(rtlsdr_dev_t *dev, int manual) {
+
+	return 0;
+}
+
+
+/*
+ * The RTL2832 resamples from its 28.8MHz crystal by a ratio with 22
+ * fractional bits, as librtlsdr works it out.
+ */
+int rtlsdr_set_sample_rate(rtlsdr_dev_t *dev, uint32_t rate) {
+
+	const double xtal = 28800000.0 * (1 << 22);
+	uint32_t ratio;
+
+	if((rate <= 225000) || (rate > 3200000) ||
+	   ((rate > 300000) && (rate <= 900000)))
+		return -EINVAL;
+
+	ratio = (uint32_t)(xtal / rate) & 0x0ffffffc;
+	ratio |= (ratio & 0x08000000) << 1;
+	dev->rate = rate;
+	emu_set_rate(dev->d, xtal / ratio);
+	return 0;
+}
+
+
+uint32_t rtlsdr_get_sample_rate(rtlsdr_dev_t *dev) {
+
+	return dev->rate;
+}
+
+
+int rtlsdr_reset_buffer(rtlsdr_dev_t *dev) {
+
+	emu_restart(dev->d);
+	return 0;
+}
+
+
+int rtlsdr_read_sync(rtlsdr_dev_t *dev, void *buf, int len, int *n_read) {
+
+	if(len <= 0)
+		return -1;
+	*n_read = 2 * emu_read(dev->d, len / 2, 0, sink_cu8, buf);
+	return 0;
+}
+
+
+/*
+ * The async buffers are the device FIFO as far as overruns go.
+ */
+int rtlsdr_read_async(rtlsdr_dev_t *dev, rtlsdr_read_async_cb_t cb, void *ctx,
+   uint32_t buf_num, uint32_t buf_len) {
+
+	emu_dev *d = dev->d;
+	unsigned char *buf;
+	unsigned int fifo = d->fifo;
+
+	if(!buf_num)
+		buf_num = 15;
+	if(!buf_len || (buf_len % 512))
+		buf_len = 16 * 32 * 512;
+	if(buf_num * buf_len / 2 > d->fifo)
+		d->fifo = buf_num * buf_len / 2;
+
+	buf = new unsigned char[buf_len];
+	d->cancel = 0;
+	while(!d->cancel) {
+		emu_read(d, buf_len / 2, 0, sink_cu8, buf);
+		cb(buf, buf_len, ctx);
+	}
+	delete[] buf;
+	d->fifo = fifo;
+
+	return 0;
+}
+
+
+int rtlsdr_cancel_async(rtlsdr_dev_t *dev) {
+
+	dev->d->cancel = 1;
+	return 0;
+}
+
+
+int rtlsdr_set_offset_tuning(rtlsdr_dev_t *dev, int on) {
+
+	return 0;
+}
+
+#endif /* XTRX_DEV */
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "drift.h"
+
+// a priori drift variance, (ppm / s)^2
+static const double DRIFT_P0 = 1e-6;
+
+const double drift_tracker::GATE = 5.0;
+const unsigned int drift_tracker::SETTLE = 10;
+const unsigned int drift_tracker::RESET = 20;
+
+
+/*
+ * r is the variance of one offset measurement and q the spectral density
+ * of the drift rate's random walk, both in ppm units.
+ */
+drift_tracker::drift_tracker(double r, double q) {
+
+	m_r = r;
+	m_q = q;
+	m_t = 0.0;
+	m_x[0] = m_x[1] = 0.0;
+	memset(m_p, 0, sizeof(m_p));
+	m_n = m_rejected = 0;
+	m_run = 0;
+}
+
+
+/*
+ * Returns 0 if the offset, ppm at time t seconds, was used, -1 if it was
+ * gated out.  Nothing is gated while the filter settles, and a run of
+ * RESET rejections in a row means the filter lost the carrier, it starts
+ * over from the offset at hand.
+ */
+int drift_tracker::add(double t, double ppm) {
+
+	double dt, p00, p01, p11, s, k0, k1, v;
+
+	// the first measurement sets the state, the drift is unknown
+	if(!m_n || (m_run >= RESET)) {
+		m_t = t;
+		m_x[0] = ppm;
+		m_x[1] = 0.0;
+		m_p[0][0] = m_r;
+		m_p[0][1] = m_p[1][0] = 0.0;
+		m_p[1][1] = DRIFT_P0;
+		m_n = 1;
+		m_run = 0;
+		return 0;
+	}
+
+	// predict
+	dt = t - m_t;
+	p00 = m_p[0][0] + dt * (2 * m_p[0][1] + dt * m_p[1][1]) + m_q * dt * dt * dt / 3;
+	p01 = m_p[0][1] + dt * m_p[1][1] + m_q * dt * dt / 2;
+	p11 = m_p[1][1] + m_q * dt;
+
+	// gate, then update
+	v = ppm - (m_x[0] + dt * m_x[1]);
+	s = p00 + m_r;
+	if((m_n > SETTLE) && (v * v > GATE * GATE * s)) {
+		m_rejected++;
+		m_run++;
+		return -1;
+	}
+	m_run = 0;
+	k0 = p00 / s;
+	k1 = p01 / s;
+	m_x[0] += dt * m_x[1] + k0 * v;
+	m_x[1] += k1 * v;
+	m_p[0][0] = (1 - k0) * p00;
+	m_p[0][1] = m_p[1][0] = (1 - k0) * p01;
+	m_p[1][1] = p11 - k1 * p01;
+	m_t = t;
+	m_n++;
+
+	return 0;
+}
+
+
+double drift_tracker::ppm_sigma() {
+
+	return sqrt(m_p[0][0]);
+}
+
+
+double drift_tracker::drift_sigma() {
+
+	return sqrt(m_p[1][1]);
+}
+
+
+allan_dev::allan_dev(double tau0, unsigned int octaves) {
+
+	m_tau0 = tau0;
+	m_octaves = octaves;
+	m_x_len = (1 << octaves) + 1;
+	m_x = new double[m_x_len];
+	m_sum = new double[octaves];
+	m_cnt = new unsigned long[octaves];
+	memset(m_sum, 0, octaves * sizeof(double));
+	memset(m_cnt, 0, octaves * sizeof(unsigned long));
+
+	m_bin_start = m_bin_sum = m_last = m_phase = 0.0;
+	m_bin_n = 0;
+	m_started = 0;
+	m_n = m_gaps = 0;
+}
+
+
+allan_dev::~allan_dev() {
+
+	delete[] m_cnt;
+	delete[] m_sum;
+	delete[] m_x;
+}
+
+
+/*
+ * Fractional frequency y at time t seconds.  A bin nothing landed in holds
+ * the previous bin's value.
+ */
+void allan_dev::add(double t, double y) {
+
+	if(!m_started) {
+		m_bin_start = t;
+		m_started = 1;
+	}
+	while(t >= m_bin_start + m_tau0) {
+		if(m_bin_n) {
+			m_last = m_bin_sum / m_bin_n;
+		} else
+			m_gaps++;
+		add_bin(m_last);
+		m_bin_start += m_tau0;
+		m_bin_sum = 0.0;
+		m_bin_n = 0;
+	}
+	m_bin_sum += y;
+	m_bin_n++;
+}
+
+
+/*
+ * With phase x_n, at averaging time m * tau0
+ *
+ *	avar = sum (x_{n+2m} - 2 x_{n+m} + x_n)^2 / (2 m^2 tau0^2 N)
+ *
+ * over the N second differences seen so far.
+ */
+void allan_dev::add_bin(double y) {
+
+	unsigned int k, m, i;
+	double d;
+
+	m_phase += y * m_tau0;
+	i = m_n % m_x_len;
+	m_x[i] = m_phase;
+	m_n++;
+
+	for(k = 0; k < m_octaves; k++) {
+		m = 1 << k;
+		if(m_n <= 2 * m)
+			break;
+		d = m_x[i] - 2 * m_x[(i + m_x_len - m) % m_x_len] +
+		   m_x[(i + m_x_len - 2 * m) % m_x_len];
+		m_sum[k] += d * d;
+		m_cnt[k]++;
+	}
+}
+
+
+double allan_dev::adev(unsigned int k) {
+
+	double m = 1 << k;
+
+	if(!m_cnt[k])
+		return 0.0;
+	return sqrt(m_sum[k] / (2 * m * m * m_tau0 * m_tau0 * m_cnt[k]));
+}
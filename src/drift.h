@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Oscillator drift
+ *
+ * drift_tracker is a two state Kalman filter, frequency error and its rate
+ * of change, fed one FCCH offset at a time.  The drift rate is modelled as
+ * a random walk with spectral density q, so the filter follows thermal
+ * drift without being told how fast it is.  Offsets more than GATE sigma
+ * from the prediction are taken for false detections and dropped.
+ *
+ * allan_dev computes the overlapping Allan deviation at octave spaced
+ * averaging times tau0 * 2^k as samples come in.  Samples are averaged into
+ * tau0 bins and integrated into phase; only the last 2^octaves phase points
+ * and a sum per octave are kept, so memory doesn't grow with the run.
+ */
+
+#pragma once
+
+class drift_tracker {
+public:
+	drift_tracker(double r, double q);
+
+	int add(double t, double ppm);
+
+	double ppm() { return m_x[0]; };
+	double drift() { return m_x[1]; };
+	double ppm_sigma();
+	double drift_sigma();
+	unsigned long count() { return m_n; };
+	unsigned long rejected() { return m_rejected; };
+
+	static const double		GATE;
+	static const unsigned int	SETTLE,
+					RESET;
+
+private:
+	double		m_r,
+			m_q,
+			m_t,
+			m_x[2],
+			m_p[2][2];
+	unsigned long	m_n,
+			m_rejected;
+	unsigned int	m_run;
+};
+
+
+class allan_dev {
+public:
+	allan_dev(double tau0, unsigned int octaves);
+	~allan_dev();
+
+	void add(double t, double y);
+
+	unsigned int octaves() { return m_octaves; };
+	double tau(unsigned int k) { return m_tau0 * (1 << k); };
+	double adev(unsigned int k);
+	unsigned long count(unsigned int k) { return m_cnt[k]; };
+	unsigned long gaps() { return m_gaps; };
+
+private:
+	void add_bin(double y);
+
+	double		m_tau0,
+			m_bin_start,
+			m_bin_sum,
+			m_last,
+			m_phase;
+	unsigned int	m_bin_n,
+			m_octaves,
+			m_x_len;
+	int		m_started;
+
+	double		*m_x;		// phase, ring of m_x_len
+	unsigned long	m_n;		// bins so far
+
+	double		*m_sum;
+	unsigned long	*m_cnt,
+			m_gaps;
+};
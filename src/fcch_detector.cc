@@ -47,11 +47,17 @@
 #include <stdexcept>
 #include <string.h>
 #include "fcch_detector.h"
+#include "instr.h"
+#include "trace.h"
 
-extern int g_debug;
 
 static const char * const fftw_plan_name = ".kal_fftw_plan";
 
+enum {
+	LOW	= 0,
+	HIGH	= 1
+};
+
 
 fcch_detector::fcch_detector(const float sample_rate, const unsigned int D,
    const float p, const float G) {
@@ -65,6 +71,8 @@ fcch_detector::fcch_detector(const float sample_rate, const unsigned int D,
 	m_p = p;
 	m_G = G;
 	m_e = 0.0;
+	m_count = 0;
+	m_block_s = HIGH;
 
 	m_sample_rate = sample_rate;
 	m_fcch_burst_len =
@@ -75,9 +83,9 @@ fcch_detector::fcch_detector(const float sample_rate, const unsigned int D,
 	m_w = new complex[m_w_len];
 	memset(m_w, 0, sizeof(complex) * m_w_len);
 
-	m_x_cb = new circular_buffer(8192, sizeof(complex), 0);
+	m_x_cb = new circular_buffer(8192, sizeof(complex), 0, 1);
 	m_y_cb = new circular_buffer(8192, sizeof(complex), 1);
-	m_e_cb = new circular_buffer(1015808, sizeof(float), 0);
+	m_e_cb = new circular_buffer(1015808, sizeof(float), 0, 1);
 
 	m_in = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * FFT_SIZE);
 	m_out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * FFT_SIZE);
@@ -85,7 +93,7 @@ fcch_detector::fcch_detector(const float sample_rate, const unsigned int D,
 		throw std::runtime_error("fcch_detector: fftw_malloc failed!");
 #ifndef _WIN32
 	home = getenv("HOME");
-	if(strlen(home) + strlen(fftw_plan_name) + 2 < sizeof(plan_name)) {
+	if(home && (strlen(home) + strlen(fftw_plan_name) + 2 < sizeof(plan_name))) {
 		strcpy(plan_name, home);
 		strcat(plan_name, "/");
 		strcat(plan_name, fftw_plan_name);
@@ -126,42 +134,39 @@ fcch_detector::~fcch_detector() {
 		delete m_e_cb;
 		m_e_cb = 0;
 	}
+	if(m_plan) {
+		fftw_destroy_plan(m_plan);
+		m_plan = 0;
+	}
+	fftw_free(m_out);
+	fftw_free(m_in);
 }
 
 
-enum {
-	LOW	= 0,
-	HIGH	= 1
-};
-
-static unsigned int g_count = 0,
-		    g_block_s = HIGH;
-
+void fcch_detector::low_to_high_init() {
 
-static inline void low_to_high_init() {
-
-	g_count = 0;
-	g_block_s = HIGH;
+	m_count = 0;
+	m_block_s = HIGH;
 }
 
 
-static inline unsigned int low_to_high(float e, float a) {
+inline unsigned int fcch_detector::low_to_high(float e, float a) {
 
 	unsigned int r = 0;
 
 	if(e > a) {
-		if(g_block_s == LOW) {
-			r = g_count;
-			g_block_s = HIGH;
-			g_count = 0;
+		if(m_block_s == LOW) {
+			r = m_count;
+			m_block_s = HIGH;
+			m_count = 0;
 		}
-		g_count += 1;
+		m_count += 1;
 	} else {
-		if(g_block_s == HIGH) {
-			g_block_s = LOW;
-			g_count = 0;
+		if(m_block_s == HIGH) {
+			m_block_s = LOW;
+			m_count = 0;
 		}
-		g_count += 1;
+		m_count += 1;
 	}
 
 	return r;
@@ -227,7 +232,10 @@ static inline complex interpolate_point(const complex *s, const unsigned int s_l
 }
 
 
-static inline float peak_detect(const complex *s, const unsigned int s_len, complex *peak, float *avg_power) {
+/*
+ * Index of the strongest bin, refined between bins by sinc interpolation.
+ */
+float fcch_detector::peak_detect(const complex *s, const unsigned int s_len, complex *peak, float *avg_power) {
 
 	unsigned int i;
 	float max = -1.0, max_i = -1.0, sample_power, sum_power, early_i, late_i, incr;
@@ -303,6 +311,7 @@ float fcch_detector::freq_detect(const complex *s, const unsigned int s_len, flo
 	unsigned int i, len;
 	float max_i, avg_power;
 	complex fft[FFT_SIZE], peak;
+	uint64_t t = instr_begin(INSTR_FREQ_DETECT);
 
 	len = MIN(s_len, FFT_SIZE);
 	for(i = 0; i < len; i++) {
@@ -323,6 +332,7 @@ float fcch_detector::freq_detect(const complex *s, const unsigned int s_len, flo
 	max_i = peak_detect(fft, FFT_SIZE, &peak, &avg_power);
 	if(pm)
 		*pm = norm(peak) / avg_power;
+	instr_end(INSTR_FREQ_DETECT, t);
 	return itof(max_i, m_sample_rate, FFT_SIZE);
 }
 
@@ -345,14 +355,16 @@ static inline void display_complex(const complex *s, unsigned int s_len) {
  */
 unsigned int fcch_detector::scan(const complex *s, const unsigned int s_len, float *offset, unsigned int *consumed) {
 
-	static const float sps = m_sample_rate / (1625000.0 / 6.0);
-	static const unsigned int MIN_FB_LEN = 100 * sps;
+	// per instance, detectors may run at different rates and in parallel
+	const float sps = m_sample_rate / (1625000.0 / 6.0);
+	const unsigned int MIN_FB_LEN = 100 * sps;
 	static const unsigned int MIN_PM = 50; // XXX arbitrary, depends on decimation
 
 	unsigned int len = 0, t, e_count, i, l_count, y_offset, y_len;
 	float e, *a, loff = 0, pm;
 	double sum = 0.0, avg, limit;
 	const complex *y;
+	uint64_t t_scan = instr_begin(INSTR_SCAN), t_nlms = instr_begin(INSTR_NLMS);
 
 	// calculate the error for each sample
 	while(len < s_len) {
@@ -365,15 +377,14 @@ unsigned int fcch_detector::scan(const complex *s, const unsigned int s_len, flo
 	}
 	if(consumed)
 		*consumed = len;
+	instr_end(INSTR_NLMS, t_nlms);
 
 	// calculate average error over entire buffer
 	a = (float *)m_e_cb->peek(&e_count);
 	avg = sum / (double)e_count;
 	limit = 0.7 * avg;
 
-	if(g_debug) {
-		printf("debug: error limit: %.1lf\n", limit);
-	}
+	trace_debug(TRACE_ERROR_LIMIT, limit);
 
 	// find neighborhoods where the error is smaller than the limit
 	low_to_high_init();
@@ -387,8 +398,7 @@ unsigned int fcch_detector::scan(const complex *s, const unsigned int s_len, flo
 			y_len = (l_count < m_fcch_burst_len)? l_count : m_fcch_burst_len;
 			y = s + y_offset;
 			loff = freq_detect(y, y_len, &pm);
-			if(g_debug)
-				printf("debug: %.0f\t%f\t%f\n", (double)l_count / sps, pm, loff);
+			trace_debug(TRACE_FCCH_CANDIDATE, l_count / sps, pm, loff);
 			if(pm > MIN_PM)
 				break;
 		}
@@ -398,16 +408,17 @@ unsigned int fcch_detector::scan(const complex *s, const unsigned int s_len, flo
 	m_x_cb->flush();
 	m_y_cb->flush();
 
-	if(pm <= MIN_PM)
+	if(pm <= MIN_PM) {
+		instr_end(INSTR_SCAN, t_scan);
 		return 0;
+	}
 
 	if(offset)
 		*offset = loff;
 
-	if(g_debug) {
-		printf("debug: fcch_detector finished -----------------------------\n");
-	}
+	trace_debug(TRACE_FCCH_FOUND);
 
+	instr_end(INSTR_SCAN, t_scan);
 	return 1;
 }
 
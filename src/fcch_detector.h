@@ -41,6 +41,8 @@
  * code should take that into consideration.
  */
 
+#pragma once
+
 #include <fftw3.h>
 
 #include "circular_buffer.h"
@@ -63,17 +65,23 @@ public:
 	unsigned int x_buf_len();
 	unsigned int y_buf_len();
 	unsigned int x_purge(unsigned int);
+	static float peak_detect(const complex *s, const unsigned int s_len, complex *peak, float *avg_power);
 
 private:
 #define GSM_RATE (1625000.0 / 6.0)
 #define FFT_SIZE 1024
 
+	void low_to_high_init();
+	inline unsigned int low_to_high(float e, float a);
+
 	unsigned int	m_w_len,
 			m_D,
 			m_check_G,
 			m_filter_delay,
 			m_lpf_len,
-			m_fcch_burst_len;
+			m_fcch_burst_len,
+			m_count,
+			m_block_s;
 	float		m_sample_rate,
 			m_p,
 			m_G,
@@ -0,0 +1,679 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdexcept>
+
+#include "file_source.h"
+#include "iq_recorder.h"
+#include "arfcn_freq.h"
+#include "instr.h"
+
+extern int g_verbosity;
+
+#define GSM_RATE (1625000.0 / 6.0)
+
+static const char * const fmt_names[] = { "", "cu8", "cs16", "cf32" };
+static const unsigned int fmt_sizes[] = { 0, 2, 4, 8 };
+
+
+/*
+ * FNV-1a
+ */
+static unsigned int name_hash(const char *s) {
+
+	unsigned int h = 2166136261u;
+
+	for(; *s; s++)
+		h = (h ^ (unsigned char)*s) * 16777619u;
+	return h;
+}
+
+
+file_source::file_source(const char *spec) {
+
+	strncpy(m_path, spec, sizeof(m_path) - 1);
+	m_path[sizeof(m_path) - 1] = 0;
+	m_dir = m_kal = 0;
+	m_fmt = FMT_NONE;
+	m_arfcn = -1;
+	m_rate = GSM_RATE;
+	m_file_freq = 0.0;
+	m_sample_rate = 0.0;
+	m_decimation = m_gsm_decimation = 1;
+	m_sample_size = 0;
+	m_outside = m_warned = m_loop = 0;
+	memset(&m_file, 0, sizeof(m_file));
+	m_segs = 0;
+	m_sel = 0;
+	m_nsegs = m_nsel = 0;
+	m_sel_count = 0;
+	m_center_freq = 0.0;
+	m_freq_corr = 0.0;
+	m_device_id[0] = 0;
+
+	m_cb = new circular_buffer(CB_LEN, sizeof(complex), 0);
+	m_dec = 0;
+	m_tmp = new complex[BLOCK];
+	m_plays = new play[MAX_PLAYS];
+	m_nplays = m_next_play = 0;
+	m_pos = position(m_center_freq);
+}
+
+
+file_source::~file_source() {
+
+	unmap(&m_file);
+	delete[] m_sel;
+	delete[] m_segs;
+	delete[] m_tmp;
+	delete[] m_plays;
+	delete m_dec;
+	delete m_cb;
+}
+
+
+int file_source::str_to_fmt(const char *s) {
+
+	int i;
+
+	for(i = FMT_CU8; i <= FMT_CF32; i++) {
+		if(!strcmp(s, fmt_names[i]))
+			return i;
+	}
+	return FMT_NONE;
+}
+
+
+/*
+ * Parse the spec and, for a single file, map it.
+ */
+int file_source::open(unsigned int subdev) {
+
+	char *opt, *v, *ext;
+	const char *name;
+	struct stat st;
+
+	if(!strncmp(m_path, "file:", 5)) {
+		memmove(m_path, m_path + 5, strlen(m_path + 5) + 1);
+	} else if(!strncmp(m_path, "dir:", 4)) {
+		memmove(m_path, m_path + 4, strlen(m_path + 4) + 1);
+		m_dir = 1;
+	} else {
+		fprintf(stderr, "error: bad input: ``%s''\n", m_path);
+		return -1;
+	}
+
+	// options follow the path
+	if((opt = strchr(m_path, ',')))
+		*opt++ = 0;
+	for(opt = opt? strtok(opt, ",") : 0; opt; opt = strtok(0, ",")) {
+		if(!strcmp(opt, "loop")) {
+			m_loop = 1;
+			continue;
+		}
+		if(!(v = strchr(opt, '='))) {
+			fprintf(stderr, "error: bad input option: ``%s''\n", opt);
+			return -1;
+		}
+		*v++ = 0;
+		if(!strcmp(opt, "fmt")) {
+			if((m_fmt = str_to_fmt(v)) == FMT_NONE) {
+				fprintf(stderr, "error: bad sample format: ``%s''\n", v);
+				return -1;
+			}
+		} else if(!strcmp(opt, "rate"))
+			m_rate = strtod(v, 0);
+		else if(!strcmp(opt, "freq"))
+			m_file_freq = strtod(v, 0);
+		else {
+			fprintf(stderr, "error: unknown input option: ``%s''\n", opt);
+			return -1;
+		}
+	}
+	if(!m_dir && is_kal(m_path)) {
+		if(open_kal())
+			return -1;
+	} else if((m_fmt == FMT_NONE) && !m_dir && (ext = strrchr(m_path, '.')))
+		m_fmt = str_to_fmt(ext + 1);
+	if(m_fmt == FMT_NONE) {
+		if(!m_dir) {
+			fprintf(stderr, "error: %s: sample format unknown, use "
+			   "fmt=\n", m_path);
+			return -1;
+		}
+		m_fmt = FMT_CU8;
+	}
+	m_sample_size = fmt_sizes[m_fmt];
+
+	// decimate to close to the GSM rate, as the receivers do
+	m_gsm_decimation = (unsigned int)round(m_rate / GSM_RATE);
+	if(!m_gsm_decimation ||
+	   (fabs(m_rate / m_gsm_decimation - GSM_RATE) > 0.02 * GSM_RATE)) {
+		fprintf(stderr, "error: %s: rate %.0f isn't a multiple of the "
+		   "GSM rate\n", m_path, m_rate);
+		return -1;
+	}
+	if(m_gsm_decimation > 1)
+		m_dec = new decimator(m_gsm_decimation);
+	m_decimation = m_gsm_decimation;
+	m_sample_rate = m_rate / m_decimation;
+
+	if(m_dir) {
+		if(stat(m_path, &st) || !S_ISDIR(st.st_mode)) {
+			fprintf(stderr, "error: %s: not a directory\n", m_path);
+			return -1;
+		}
+		if(strlen(m_path) + sizeof("/-2147483648.cf32") > PATH_MAX) {
+			fprintf(stderr, "error: %s: path too long\n", m_path);
+			return -1;
+		}
+	} else if(!m_kal && map(m_path, &m_file, m_sample_size))
+		return -1;
+
+	// a long name is cut short, a hash of all of it keeps it apart
+	name = (name = strrchr(m_path, '/'))? name + 1 : m_path;
+	if(snprintf(m_device_id, sizeof(m_device_id), "file-%s", name) >=
+	   (int)sizeof(m_device_id)) {
+		snprintf(m_device_id, sizeof(m_device_id), "file-%.40s-%08x",
+		   name, name_hash(name));
+	}
+
+	if(g_verbosity > 0) {
+		fprintf(stderr, "Replaying %s %s, %s at %.0f, decimation %u\n",
+		   m_dir? "directory" : (m_kal? "recording" : "file"), m_path,
+		   fmt_names[m_fmt], m_rate, m_decimation);
+	}
+	update_nco();
+
+	return 0;
+}
+
+
+int file_source::map(const char *path, mapping *m, unsigned int size) {
+
+	int fd;
+	struct stat st;
+
+	if((fd = ::open(path, O_RDONLY)) == -1) {
+		fprintf(stderr, "error: %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if(fstat(fd, &st) || (st.st_size < (off_t)(BLOCK * size))) {
+		fprintf(stderr, "error: %s: too short\n", path);
+		close(fd);
+		return -1;
+	}
+	m->len = st.st_size;
+	m->count = m->len / size;
+	m->base = mmap(0, m->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(m->base == MAP_FAILED) {
+		fprintf(stderr, "error: %s: mmap: %s\n", path, strerror(errno));
+		m->base = 0;
+		return -1;
+	}
+	madvise(m->base, m->len, MADV_SEQUENTIAL);
+
+	return 0;
+}
+
+
+void file_source::unmap(mapping *m) {
+
+	if(m->base)
+		munmap(m->base, m->len);
+	memset(m, 0, sizeof(*m));
+}
+
+
+int file_source::is_kal(const char *path) {
+
+	char magic[8];
+	int fd, r;
+
+	if((fd = ::open(path, O_RDONLY)) == -1)
+		return 0;
+	r = (read(fd, magic, sizeof(magic)) == sizeof(magic)) &&
+	   !memcmp(magic, KAL_MAGIC, sizeof(magic));
+	close(fd);
+
+	return r;
+}
+
+
+/*
+ * Index the chunks of a recording.  The first chunk gives the format and
+ * rate, chunks taken at another rate (a wideband scan in the middle of the
+ * run) are left out.  Samples from before a retune settled are skipped.
+ */
+int file_source::open_kal() {
+
+	const char *p;
+	const kal_chunk *h;
+	size_t off;
+	unsigned int n, other = 0;
+
+	if(map(m_path, &m_file, 1))
+		return -1;
+	p = (const char *)m_file.base;
+
+	for(n = 0, off = 0; off + sizeof(kal_chunk) <= m_file.len; off += h->len, n++) {
+		h = (const kal_chunk *)(p + off);
+		if(memcmp(h->magic, KAL_MAGIC, sizeof(h->magic)) ||
+		   (h->hdr_len < sizeof(kal_chunk)) || (h->len < h->hdr_len))
+			break;
+	}
+	if(!n) {
+		fprintf(stderr, "error: %s: not a recording\n", m_path);
+		return -1;
+	}
+
+	h = (const kal_chunk *)p;
+	if((h->fmt < FMT_CU8) || (h->fmt > FMT_CF32)) {
+		fprintf(stderr, "error: %s: bad sample format %u\n", m_path, h->fmt);
+		return -1;
+	}
+	m_fmt = h->fmt;
+	m_sample_size = fmt_sizes[m_fmt];
+	m_rate = h->rate;
+
+	m_segs = new segment[n];
+	m_sel = new unsigned int[n];
+	for(m_nsegs = 0, off = 0; n--; off += h->len) {
+		h = (const kal_chunk *)(p + off);
+		if((h->fmt != (unsigned int)m_fmt) || (h->rate != m_rate)) {
+			other++;
+			continue;
+		}
+		if((off + h->len > m_file.len) || (h->count <= h->skip) ||
+		   (h->hdr_len + h->count * m_sample_size > h->len))
+			continue;
+		m_segs[m_nsegs].data = p + off + h->hdr_len + h->skip * m_sample_size;
+		m_segs[m_nsegs].count = h->count - h->skip;
+		m_segs[m_nsegs].freq = h->freq;
+		m_nsegs++;
+	}
+	m_kal = 1;
+
+	if(g_verbosity > 0) {
+		fprintf(stderr, "%s: %u chunks from %s", m_path, m_nsegs,
+		   ((const kal_chunk *)p)->device);
+		if(other)
+			fprintf(stderr, ", %u at other rates left out", other);
+		fprintf(stderr, "\n");
+	}
+
+	return 0;
+}
+
+
+/*
+ * Where playback at freq has got to.  A scan comes back to a channel for
+ * another look, it goes on from there.  Past MAX_PLAYS frequencies the
+ * oldest are forgotten and start over.
+ */
+unsigned long *file_source::position(double freq) {
+
+	unsigned int i;
+	play *p;
+
+	for(i = 0; i < m_nplays; i++) {
+		if(fabs(m_plays[i].freq - freq) < 1.0)
+			return &m_plays[i].pos;
+	}
+	if(m_nplays < MAX_PLAYS)
+		p = &m_plays[m_nplays++];
+	else
+		p = &m_plays[m_next_play++ % MAX_PLAYS];
+	p->freq = freq;
+	p->pos = 0;
+
+	return &p->pos;
+}
+
+
+/*
+ * How many samples there are to play at the current frequency.
+ */
+unsigned long file_source::recorded() {
+
+	if(m_outside)
+		return 0;
+	if(m_kal)
+		return m_sel_count;
+	return m_file.base? m_file.count : 0;
+}
+
+
+/*
+ * Where the samples at pos are, at most *len of them in one piece.  0 if
+ * there is nothing recorded there or the recording has ended.
+ */
+const void *file_source::samples(unsigned long pos, unsigned int *len) {
+
+	unsigned long at, count;
+	unsigned int i;
+	const segment *g;
+
+	count = recorded();
+	if(!count || (!m_loop && (pos >= count)))
+		return 0;
+	at = pos % count;
+
+	if(m_kal) {
+		for(i = 0; at >= m_segs[m_sel[i]].count; i++)
+			at -= m_segs[m_sel[i]].count;
+		g = &m_segs[m_sel[i]];
+		if(at + *len > g->count)
+			*len = g->count - at;
+		return g->data + at * m_sample_size;
+	}
+
+	if(at + *len > m_file.count)
+		*len = m_file.count - at;
+	return (const char *)m_file.base + at * m_sample_size;
+}
+
+
+/*
+ * The chunks of a recording taken at freq, played one after the other.
+ */
+void file_source::select(double freq) {
+
+	unsigned int i;
+
+	m_nsel = 0;
+	m_sel_count = 0;
+	for(i = 0; i < m_nsegs; i++) {
+		if(fabs(m_segs[i].freq - freq) < 1.0) {
+			m_sel[m_nsel++] = i;
+			m_sel_count += m_segs[i].count;
+		}
+	}
+	if(!m_nsel && (g_verbosity > 2))
+		fprintf(stderr, "nothing recorded at %.1fMHz\n", freq / 1e6);
+}
+
+
+/*
+ * Whatever lies beyond the edges of a wideband recording would alias back
+ * into it, the channels there are made silent instead.  Decimating to one
+ * channel, the whole channel has to fit.
+ */
+int file_source::outside(double freq) {
+
+	static const double HALF_CHAN = 100e3;
+
+	if(m_dir || (m_file_freq <= 0.0))
+		return 0;
+	return fabs(freq - m_file_freq) >= m_rate / 2 - ((m_decimation > 1)? HALF_CHAN : 0.0);
+}
+
+
+/*
+ * A channel at freq sits at freq - m_file_freq in a wideband recording, mix
+ * it down.  As with the receivers, a crystal ppm fast puts the carrier
+ * ppm * fc below where we tuned.
+ */
+void file_source::update_nco() {
+
+	double off = 0.0;
+
+	if(!m_dir && (m_file_freq > 0.0))
+		off = m_file_freq - m_center_freq;
+	m_nco.set_freq(off + m_center_freq * m_freq_corr * 1e-6, m_rate);
+}
+
+
+int file_source::tune(double freq) {
+
+	char path[PATH_MAX];
+	int arfcn;
+	uint64_t t;
+
+	if(freq == m_center_freq)
+		return 1;
+	t = instr_begin(INSTR_TUNE);
+	m_center_freq = freq;
+	m_pos = position(freq);
+
+	if(m_dir && ((arfcn = freq_to_arfcn(freq)) != m_arfcn)) {
+		unmap(&m_file);
+		m_arfcn = arfcn;
+		// open() made sure the name fits
+		if((snprintf(path, sizeof(path), "%s/%d.%s", m_path, arfcn,
+		   fmt_names[m_fmt]) < (int)sizeof(path)) && !access(path, F_OK))
+			map(path, &m_file, m_sample_size);
+		if(!m_file.base && (g_verbosity > 2))
+			fprintf(stderr, "no recording for channel %d\n", arfcn);
+	}
+	if(m_kal)
+		select(freq);
+	m_outside = outside(freq);
+	if(m_outside && !m_warned) {
+		fprintf(stderr, "warning: %.1fMHz is outside the recording, "
+		   "channels there are silent\n", freq / 1e6);
+		m_warned = 1;
+	}
+
+	if(m_dec)
+		m_dec->reset();
+	update_nco();
+	m_cb->flush();
+
+	instr_end(INSTR_TUNE, t);
+	return 1;
+}
+
+
+int file_source::set_freq_correction(double ppm) {
+
+	m_freq_corr = ppm;
+	update_nco();
+
+	return 0;
+}
+
+
+/*
+ * A recording has the one rate, it is delivered undecimated.  Callers go
+ * by sample_rate() afterwards.
+ */
+int file_source::set_sample_rate(double rate) {
+
+	m_decimation = 1;
+	m_sample_rate = m_rate;
+	m_outside = outside(m_center_freq);
+	m_cb->flush();
+
+	return 0;
+}
+
+
+int file_source::reset_sample_rate() {
+
+	m_decimation = m_gsm_decimation;
+	m_sample_rate = m_rate / m_decimation;
+	m_outside = outside(m_center_freq);
+	if(m_dec)
+		m_dec->reset();
+	m_cb->flush();
+
+	return 0;
+}
+
+
+float file_source::sample_rate() {
+
+	return m_sample_rate;
+}
+
+
+bool file_source::set_gain(float gain) {
+
+	return true;
+}
+
+
+void file_source::start() {
+}
+
+
+void file_source::stop() {
+}
+
+
+/*
+ * Mix len samples in the file's format at in into out.
+ */
+unsigned int file_source::convert(const void *in, complex *out,
+   unsigned int len) {
+
+	unsigned int i;
+	const short *s;
+
+	switch(m_fmt) {
+		case FMT_CU8:
+			m_nco.mix((const unsigned char *)in, out, len);
+			break;
+
+		case FMT_CS16:
+			s = (const short *)in;
+			for(i = 0; i < len; i++)
+				m_tmp[i] = complex(s[2 * i], s[2 * i + 1]);
+			m_nco.mix(m_tmp, out, len);
+			break;
+
+		case FMT_CF32:
+			m_nco.mix((const complex *)in, out, len);
+			break;
+	}
+
+	return len;
+}
+
+
+int file_source::fill(unsigned int num_samples, unsigned int *overrun_i) {
+
+	unsigned int i, n, space, max_out;
+	const void *p;
+	complex *c, *out;
+	uint64_t t = instr_begin(INSTR_FILL);
+
+	max_out = (m_decimation > 1)? m_dec->max_out(BLOCK) : BLOCK;
+	while((m_cb->data_available() < num_samples) && (m_cb->space_available() >= max_out)) {
+		c = (complex *)m_cb->poke(&space);
+		out = (m_decimation > 1)? m_dec->poke(BLOCK) : c;
+
+		// up to BLOCK samples, stopping at the end of the recording
+		n = BLOCK;
+		if((p = samples(*m_pos, &n))) {
+			convert(p, out, n);
+		} else {
+			for(i = 0; i < n; i++)
+				out[i] = 0.0;
+		}
+		*m_pos += n;
+		instr_count(INSTR_SAMPLES, n);
+
+		if(m_decimation > 1)
+			i = m_dec->wrote(n, c);
+		else
+			i = n;
+		m_cb->wrote(i);
+	}
+
+	if(overrun_i)
+		*overrun_i = 0;
+
+	instr_end(INSTR_FILL, t);
+	return (!m_loop && (*m_pos > recorded()))? 1 : 0;
+}
+
+
+circular_buffer *file_source::get_buffer() {
+
+	return m_cb;
+}
+
+
+/*
+ * Grow the buffer to hold at least len samples.  What it held is dropped and
+ * it may move, so call get_buffer() again afterwards.
+ */
+int file_source::reserve(unsigned int len) {
+
+	circular_buffer *cb;
+
+	if(len <= m_cb->buf_len())
+		return 0;
+	try {
+		cb = new circular_buffer(len, sizeof(complex), 0);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		return -1;
+	}
+	delete m_cb;
+	m_cb = cb;
+	return 0;
+}
+
+
+int file_source::flush(unsigned int flush_count) {
+
+	m_cb->flush();
+	if(flush_count) {
+		fill(flush_count * 512, 0);
+		m_cb->flush();
+	}
+
+	return 0;
+}
+
+
+/*
+ * Nothing to settle, a recording retunes instantly.
+ */
+void file_source::report_settle() {
+}
+
+
+const char *file_source::device_id() {
+
+	return m_device_id;
+}
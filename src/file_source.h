@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * file_source
+ *
+ * Replays IQ recordings through the same interface as the receivers, as
+ * fast as the detectors take the samples.  The input is given as
+ *
+ *	file:PATH[,fmt=cu8|cs16|cf32][,rate=HZ][,freq=HZ][,loop]
+ *	dir:PATH[,fmt=cu8|cs16|cf32][,rate=HZ][,loop]
+ *
+ * A single file recorded at freq covers whatever lies within its bandwidth,
+ * tune() selects a channel by mixing it down and decimating to the GSM
+ * rate.  Without freq the file is taken to be centered wherever we tune.  A
+ * directory holds one recording per channel, named ARFCN.fmt and centered
+ * on the channel, and channels without a file are silent.  A .kal file
+ * recorded with -W is recognized by its header, which gives the format and
+ * rate, and each tune plays what was recorded at that frequency.
+ *
+ * The recordings are mapped rather than read.  Every sample is converted
+ * and mixed from the mapping into the decimator, or straight into the
+ * buffer without one; cs16 is widened into a scratch block first.  Each
+ * frequency plays its recording from the start and goes on from where it
+ * was when tuned to again.  At the end the channel goes silent and fill()
+ * returns 1, a measurement stops there rather than counting the same bursts
+ * twice.  With loop the recording starts over instead, with a jump in
+ * phase where it wraps.  The rate defaults to the GSM rate, the format to
+ * the file's extension.
+ */
+
+#pragma once
+
+#include "usrp_complex.h"
+#include "circular_buffer.h"
+#include "sample_source.h"
+#include "nco.h"
+#include "decimator.h"
+
+class file_source : public sample_source {
+public:
+	file_source(const char *spec);
+	~file_source();
+
+	int open(unsigned int subdev);
+	int fill(unsigned int num_samples, unsigned int *overrun);
+	int tune(double freq);
+	int set_freq_correction(double ppm);
+	int set_sample_rate(double rate);
+	int reset_sample_rate();
+	bool set_gain(float gain);
+	void start();
+	void stop();
+	int flush(unsigned int flush_count = 0);
+	circular_buffer *get_buffer();
+	int reserve(unsigned int len);
+	void report_settle();
+	const char *device_id();
+
+	float sample_rate();
+
+	enum {
+		FMT_NONE,
+		FMT_CU8,
+		FMT_CS16,
+		FMT_CF32
+	};
+
+	static int str_to_fmt(const char *s);
+
+private:
+	struct segment {
+		const char	*data;
+		unsigned long	count;		// samples
+		double		freq;
+	};
+
+	struct mapping {
+		void		*base;
+		size_t		len;
+		unsigned long	count;		// samples
+	};
+
+	struct play {
+		double		freq;
+		unsigned long	pos;		// samples
+	};
+
+	int map(const char *path, mapping *m, unsigned int size);
+	void unmap(mapping *m);
+	static int is_kal(const char *path);
+	int open_kal();
+	void select(double freq);
+	unsigned long *position(double freq);
+	unsigned long recorded();
+	const void *samples(unsigned long pos, unsigned int *len);
+	int outside(double freq);
+	void update_nco();
+	unsigned int convert(const void *in, complex *out, unsigned int len);
+
+	char		m_path[BUFSIZ];
+	int		m_dir,
+			m_kal,
+			m_fmt,
+			m_arfcn,
+			m_outside,
+			m_warned,
+			m_loop;
+	double		m_rate,
+			m_file_freq;
+	float		m_sample_rate;
+	unsigned int	m_decimation,
+			m_gsm_decimation,
+			m_sample_size;
+	unsigned long	*m_pos;
+	play		*m_plays;
+	unsigned int	m_nplays,
+			m_next_play;
+	mapping		m_file;
+	segment		*m_segs;
+	unsigned int	*m_sel,
+			m_nsegs,
+			m_nsel;
+	unsigned long	m_sel_count;
+
+	circular_buffer	*m_cb;
+	decimator	*m_dec;
+	nco		m_nco;
+	complex		*m_tmp;
+	char		m_device_id[64];
+
+	static const unsigned int	CB_LEN		= (16 * 16384);
+	static const unsigned int	BLOCK		= 8192;
+	static const unsigned int	MAX_PLAYS	= 1024;
+};
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "instr.h"
+#include "trace.h"
+
+int g_instr = 0;
+
+/*
+ * Bucket 0 holds durations under 1us, bucket k those under 2^k us.
+ */
+static const unsigned int HIST_LEN = 32;
+
+/*
+ * Channels are kept by tuned frequency in an open addressed table, more
+ * slots than all bands have channels.
+ */
+static const unsigned int CHAN_BITS = 11;
+static const unsigned int CHAN_SLOTS = 1 << CHAN_BITS;
+
+static const char *stage_name[INSTR_STAGES] = {
+	"tune", "flush", "fill", "read", "nlms", "freq_detect", "scan", "wait",
+	"idle"
+};
+
+static const char *counter_name[INSTR_COUNTERS] = {
+	"samples", "overruns", "found", "notfound", "retries"
+};
+
+struct stage_stats {
+	uint64_t	count,
+			total,		// ns
+			min,
+			max,
+			hist[HIST_LEN];
+};
+
+struct chan_stats {
+	uint32_t	key;		// freq / 100 + 1, 0 while free
+	uint64_t	count[INSTR_STAGES],
+			total[INSTR_STAGES],
+			counter[INSTR_COUNTERS];
+};
+
+static stage_stats	s_stage[INSTR_STAGES];
+static uint64_t		s_counter[INSTR_COUNTERS];
+static chan_stats	s_chan[CHAN_SLOTS];
+static uint64_t		s_start;
+static FILE		*s_out;
+static int		s_json;
+
+static __thread chan_stats	*t_chan;
+
+
+uint64_t instr_now() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+static inline void atomic_min(uint64_t *p, uint64_t v) {
+
+	uint64_t o = __atomic_load_n(p, __ATOMIC_RELAXED);
+
+	while((v < o) && !__atomic_compare_exchange_n(p, &o, v, 1,
+	   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+
+static inline void atomic_max(uint64_t *p, uint64_t v) {
+
+	uint64_t o = __atomic_load_n(p, __ATOMIC_RELAXED);
+
+	while((v > o) && !__atomic_compare_exchange_n(p, &o, v, 1,
+	   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+
+const char *instr_stage_name(unsigned int stage) {
+
+	return (stage < INSTR_STAGES)? stage_name[stage] : "?";
+}
+
+
+/*
+ * The channel this thread is on, as keyed in the table, 0 for none.
+ */
+uint32_t instr_channel_key() {
+
+	return t_chan? t_chan->key : 0;
+}
+
+
+uint64_t instr_start(unsigned int stage) {
+
+	uint64_t t = instr_now();
+
+	if(g_trace)
+		trace_put(TRACE_BEGIN, stage, t, instr_channel_key());
+	return t;
+}
+
+
+void instr_record(unsigned int stage, uint64_t start) {
+
+	uint64_t t = instr_now(), d = t - start, us = d / 1000;
+	stage_stats *s = &s_stage[stage];
+	unsigned int b;
+
+	if(g_trace)
+		trace_put(TRACE_END, stage, t, instr_channel_key());
+	if(!g_instr)
+		return;
+
+	b = us? 64 - __builtin_clzll(us) : 0;
+	if(b >= HIST_LEN)
+		b = HIST_LEN - 1;
+
+	__atomic_fetch_add(&s->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&s->total, d, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&s->hist[b], 1, __ATOMIC_RELAXED);
+	atomic_min(&s->min, d);
+	atomic_max(&s->max, d);
+
+	if(t_chan) {
+		__atomic_fetch_add(&t_chan->count[stage], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&t_chan->total[stage], d, __ATOMIC_RELAXED);
+	}
+}
+
+
+void instr_add(unsigned int counter, uint64_t n) {
+
+	__atomic_fetch_add(&s_counter[counter], n, __ATOMIC_RELAXED);
+	if(t_chan)
+		__atomic_fetch_add(&t_chan->counter[counter], n, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * What this thread records from now on also goes to the channel at freq.
+ */
+void instr_set_channel(double freq) {
+
+	uint32_t key = (uint32_t)(freq / 100.0 + 0.5) + 1, o;
+	unsigned int i, n;
+
+	if(t_chan && (t_chan->key == key))
+		return;
+
+	i = (key * 2654435761u) >> (32 - CHAN_BITS);
+	for(n = 0; n < CHAN_SLOTS; n++, i = (i + 1) & (CHAN_SLOTS - 1)) {
+		o = __atomic_load_n(&s_chan[i].key, __ATOMIC_ACQUIRE);
+		if(!o) {
+			if(__atomic_compare_exchange_n(&s_chan[i].key, &o, key, 0,
+			   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				o = key;
+		}
+		if(o == key) {
+			t_chan = &s_chan[i];
+			return;
+		}
+	}
+	t_chan = 0;
+}
+
+
+/*
+ * Start recording, the summary is written to path at exit.
+ */
+int instr_enable(const char *path) {
+
+	unsigned int i;
+
+	if(!strcmp(path, "-")) {
+		s_out = stderr;
+		s_json = 0;
+	} else {
+		if(!(s_out = fopen(path, "w"))) {
+			perror(path);
+			return -1;
+		}
+		s_json = 1;
+	}
+
+	for(i = 0; i < INSTR_STAGES; i++)
+		s_stage[i].min = ~0ull;
+	s_start = instr_now();
+	g_instr = 1;
+	atexit(instr_report);
+
+	return 0;
+}
+
+
+static int cmp_chan(const void *a, const void *b) {
+
+	uint32_t ka = (*(const chan_stats **)a)->key,
+	   kb = (*(const chan_stats **)b)->key;
+
+	return (ka > kb) - (ka < kb);
+}
+
+
+/*
+ * The channels seen, in frequency order.  Returns how many.
+ */
+static unsigned int sorted_chans(chan_stats **c) {
+
+	unsigned int i, n = 0;
+
+	for(i = 0; i < CHAN_SLOTS; i++) {
+		if(s_chan[i].key)
+			c[n++] = &s_chan[i];
+	}
+	qsort(c, n, sizeof(*c), cmp_chan);
+
+	return n;
+}
+
+
+static double chan_freq(const chan_stats *c) {
+
+	return (c->key - 1) * 100.0;
+}
+
+
+static void report_text(FILE *f, double wall, chan_stats **c, unsigned int nchan) {
+
+	unsigned int i, k, b;
+	const stage_stats *s;
+
+	fprintf(f, "instrumentation, %.3fs:\n", wall);
+	fprintf(f, "stage\t\tcount\ttotal s\tmean us\tmin us\tmax us\n");
+	for(i = 0; i < INSTR_STAGES; i++) {
+		s = &s_stage[i];
+		if(!s->count)
+			continue;
+		fprintf(f, "%-12s\t%llu\t%.3f\t%.0f\t%.0f\t%.0f\n", stage_name[i],
+		   (unsigned long long)s->count, s->total * 1e-9,
+		   s->total * 1e-3 / s->count, s->min * 1e-3, s->max * 1e-3);
+	}
+
+	fprintf(f, "durations, count below us:\n");
+	for(i = 0; i < INSTR_STAGES; i++) {
+		s = &s_stage[i];
+		if(!s->count)
+			continue;
+		fprintf(f, "%-12s", stage_name[i]);
+		for(b = 0; b < HIST_LEN; b++) {
+			if(s->hist[b])
+				fprintf(f, "\t%llu:%llu", 1ull << b, (unsigned long long)s->hist[b]);
+		}
+		fprintf(f, "\n");
+	}
+
+	fprintf(f, "counters:");
+	for(k = 0; k < INSTR_COUNTERS; k++)
+		fprintf(f, "\t%s %llu", counter_name[k], (unsigned long long)s_counter[k]);
+	fprintf(f, "\n");
+
+	if(!nchan)
+		return;
+	fprintf(f, "per channel, ms:\nfreq");
+	for(i = 0; i < INSTR_STAGES; i++)
+		fprintf(f, "\t%.5s", stage_name[i]);
+	for(k = INSTR_OVERRUNS; k < INSTR_COUNTERS; k++)
+		fprintf(f, "\t%.5s", counter_name[k]);
+	fprintf(f, "\n");
+	for(i = 0; i < nchan; i++) {
+		fprintf(f, "%.1fMHz", chan_freq(c[i]) / 1e6);
+		for(k = 0; k < INSTR_STAGES; k++)
+			fprintf(f, "\t%.1f", c[i]->total[k] * 1e-6);
+		for(k = INSTR_OVERRUNS; k < INSTR_COUNTERS; k++)
+			fprintf(f, "\t%llu", (unsigned long long)c[i]->counter[k]);
+		fprintf(f, "\n");
+	}
+}
+
+
+static void report_json(FILE *f, double wall, chan_stats **c, unsigned int nchan) {
+
+	unsigned int i, k, b;
+	const stage_stats *s;
+
+	fprintf(f, "{\n  \"wall_s\": %.6f,\n  \"stages\": {", wall);
+	for(i = 0; i < INSTR_STAGES; i++) {
+		s = &s_stage[i];
+		fprintf(f, "%s\n    \"%s\": {\"count\": %llu, \"total_s\": %.6f, "
+		   "\"min_us\": %.3f, \"max_us\": %.3f, \"hist_us\": [", i? "," : "",
+		   stage_name[i], (unsigned long long)s->count, s->total * 1e-9,
+		   s->count? s->min * 1e-3 : 0.0, s->max * 1e-3);
+		for(b = 0; b < HIST_LEN; b++)
+			fprintf(f, "%s%llu", b? ", " : "", (unsigned long long)s->hist[b]);
+		fprintf(f, "]}");
+	}
+	fprintf(f, "\n  },\n  \"counters\": {");
+	for(k = 0; k < INSTR_COUNTERS; k++) {
+		fprintf(f, "%s\"%s\": %llu", k? ", " : "", counter_name[k],
+		   (unsigned long long)s_counter[k]);
+	}
+	fprintf(f, "},\n  \"channels\": [");
+	for(i = 0; i < nchan; i++) {
+		fprintf(f, "%s\n    {\"freq\": %.0f", i? "," : "", chan_freq(c[i]));
+		for(k = 0; k < INSTR_STAGES; k++) {
+			fprintf(f, ", \"%s_s\": %.6f, \"%s_count\": %llu",
+			   stage_name[k], c[i]->total[k] * 1e-9, stage_name[k],
+			   (unsigned long long)c[i]->count[k]);
+		}
+		for(k = 0; k < INSTR_COUNTERS; k++) {
+			fprintf(f, ", \"%s\": %llu", counter_name[k],
+			   (unsigned long long)c[i]->counter[k]);
+		}
+		fprintf(f, "}");
+	}
+	fprintf(f, "\n  ]\n}\n");
+}
+
+
+/*
+ * Runs at exit.  Threads still recording may be missed, not torn: every
+ * field is read whole.
+ */
+void instr_report() {
+
+	static chan_stats *c[CHAN_SLOTS];
+	unsigned int nchan;
+	double wall;
+
+	if(!g_instr)
+		return;
+	g_instr = 0;
+
+	wall = (instr_now() - s_start) * 1e-9;
+	nchan = sorted_chans(c);
+	if(s_json)
+		report_json(s_out, wall, c, nchan);
+	else
+		report_text(s_out, wall, c, nchan);
+	if(s_out != stderr)
+		fclose(s_out);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * instr
+ *
+ * Where a run spends its time.  A stage is timed from instr_begin() to
+ * instr_end() on the monotonic clock, counters are bumped with
+ * instr_count().  Both go into fixed tables with atomic adds, so any
+ * thread records without a lock.  Each stage keeps its count, total, min,
+ * max and a log2 histogram of durations, and stages and counters are also
+ * totalled per channel, the one a thread last named with instr_channel().
+ * Stages nest, a fill inside a flush counts for both.  With tracing on,
+ * the same probes put begin and end events in the thread's trace ring,
+ * see trace.h.
+ *
+ * Nothing is recorded until instr_enable() or trace_enable(), until then
+ * each probe is a load and a branch.  The summary goes out at exit, as
+ * text on stderr for the path "-", as JSON to any other path.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+enum {
+	INSTR_TUNE,
+	INSTR_FLUSH,
+	INSTR_FILL,
+	INSTR_READ,		// blocked in the device library
+	INSTR_NLMS,		// the adaptive filter over a block
+	INSTR_FREQ_DETECT,
+	INSTR_SCAN,
+	INSTR_WAIT,		// capture thread waiting on the detectors
+	INSTR_IDLE,		// worker waiting for a block
+	INSTR_STAGES
+};
+
+enum {
+	INSTR_SAMPLES,
+	INSTR_OVERRUNS,
+	INSTR_FOUND,
+	INSTR_NOTFOUND,
+	INSTR_RETRIES,
+	INSTR_COUNTERS
+};
+
+extern int g_instr, g_trace;
+
+uint64_t instr_now();
+uint64_t instr_start(unsigned int stage);
+void instr_record(unsigned int stage, uint64_t start);
+void instr_add(unsigned int counter, uint64_t n);
+void instr_set_channel(double freq);
+int instr_enable(const char *path);
+void instr_report();
+const char *instr_stage_name(unsigned int stage);
+uint32_t instr_channel_key();
+
+static inline uint64_t instr_begin(unsigned int stage) {
+
+	return (g_instr | g_trace)? instr_start(stage) : 0;
+}
+
+static inline void instr_end(unsigned int stage, uint64_t start) {
+
+	if(start)
+		instr_record(stage, start);
+}
+
+static inline void instr_count(unsigned int counter, uint64_t n = 1) {
+
+	if(g_instr)
+		instr_add(counter, n);
+}
+
+static inline void instr_channel(double freq) {
+
+	if(g_instr | g_trace)
+		instr_set_channel(freq);
+}
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <stdexcept>
+
+#include "iq_recorder.h"
+
+extern int g_verbosity;
+
+
+iq_recorder::iq_recorder(const char *path, int fmt, unsigned int sample_size,
+   const char *device) {
+
+	unsigned int i;
+
+	strncpy(m_path, path, sizeof(m_path) - 1);
+	m_path[sizeof(m_path) - 1] = 0;
+	strncpy(m_device, device, sizeof(m_device) - 1);
+	m_device[sizeof(m_device) - 1] = 0;
+	m_fd = -1;
+	m_fmt = fmt;
+	m_sample_size = sample_size;
+	m_direct = m_failed = m_stop = m_running = 0;
+	m_freq = m_rate = m_gain = 0.0;
+	m_cur = 0;
+	m_hdr = 0;
+	m_dropped = m_dropped_total = m_written = 0;
+
+	// O_DIRECT wants the buffers aligned
+	if(posix_memalign((void **)&m_mem, ALIGN, (size_t)NCHUNKS * CHUNK_LEN))
+		throw std::runtime_error("iq_recorder: posix_memalign failed");
+	m_free = new char *[NCHUNKS];
+	m_queue = new char *[NCHUNKS];
+	for(i = 0; i < NCHUNKS; i++)
+		m_free[i] = m_mem + (size_t)i * CHUNK_LEN;
+	m_nfree = NCHUNKS;
+	m_q_head = m_q_len = 0;
+
+	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_cond, 0);
+}
+
+
+iq_recorder::~iq_recorder() {
+
+	close();
+	pthread_cond_destroy(&m_cond);
+	pthread_mutex_destroy(&m_mutex);
+	delete[] m_queue;
+	delete[] m_free;
+	free(m_mem);
+}
+
+
+/*
+ * Around the page cache where that can be done: O_DIRECT, or F_NOCACHE on
+ * macOS.  Otherwise the writes are buffered.
+ */
+int iq_recorder::open() {
+
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+	m_fd = -1;
+#ifdef O_DIRECT
+	if((m_fd = ::open(m_path, flags | O_DIRECT, 0644)) != -1)
+		m_direct = 1;
+#endif
+	if(m_fd == -1)
+		m_fd = ::open(m_path, flags, 0644);
+	if(m_fd == -1) {
+		fprintf(stderr, "error: %s: %s\n", m_path, strerror(errno));
+		return -1;
+	}
+#ifdef F_NOCACHE
+	if(!m_direct && (fcntl(m_fd, F_NOCACHE, 1) != -1))
+		m_direct = 1;
+#endif
+
+	if(pthread_create(&m_thread, 0, writer_main, this)) {
+		fprintf(stderr, "error: iq_recorder: pthread_create\n");
+		::close(m_fd);
+		m_fd = -1;
+		return -1;
+	}
+	m_running = 1;
+
+	if(g_verbosity > 0) {
+		fprintf(stderr, "Recording to %s%s\n", m_path,
+		   m_direct? " (uncached)" : "");
+	}
+
+	return 0;
+}
+
+
+/*
+ * Write out what is left and wait for the writer.
+ */
+void iq_recorder::close() {
+
+	if(!m_running)
+		return;
+
+	queue_chunk();
+	pthread_mutex_lock(&m_mutex);
+	m_stop = 1;
+	pthread_cond_broadcast(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+	pthread_join(m_thread, 0);
+	m_running = 0;
+
+	::close(m_fd);
+	m_fd = -1;
+
+	if(m_dropped_total)
+		fprintf(stderr, "warning: %s: %llu samples not recorded, the "
+		   "disk didn't keep up\n", m_path, m_dropped_total);
+	if(g_verbosity > 0)
+		fprintf(stderr, "Recorded %llu bytes to %s\n", m_written, m_path);
+}
+
+
+/*
+ * Samples after this are taken at freq, rate and gain.
+ */
+void iq_recorder::set_meta(double freq, double rate, double gain) {
+
+	if((freq == m_freq) && (rate == m_rate) && (gain == m_gain))
+		return;
+	if(m_hdr && m_hdr->count)
+		queue_chunk();
+	m_freq = freq;
+	m_rate = rate;
+	m_gain = gain;
+	if(m_hdr) {
+		m_hdr->freq = freq;
+		m_hdr->rate = rate;
+		m_hdr->gain = gain;
+	}
+}
+
+
+/*
+ * Room for len samples in the chunk being filled, 0 when every chunk is
+ * waiting for the disk.  Either way, wrote() says what was read.
+ */
+void *iq_recorder::poke(unsigned int len) {
+
+	unsigned int l = len * m_sample_size;
+
+	if(!m_running || (l > CHUNK_LEN - HDR_LEN))
+		return 0;
+	if(m_cur && (HDR_LEN + m_hdr->count * m_sample_size + l > CHUNK_LEN))
+		queue_chunk();
+
+	if(!m_cur) {
+		pthread_mutex_lock(&m_mutex);
+		if(m_nfree)
+			m_cur = m_free[--m_nfree];
+		pthread_mutex_unlock(&m_mutex);
+		if(!m_cur)
+			return 0;
+
+		m_hdr = (kal_chunk *)m_cur;
+		memset(m_hdr, 0, HDR_LEN);
+		memcpy(m_hdr->magic, KAL_MAGIC, sizeof(m_hdr->magic));
+		m_hdr->hdr_len = HDR_LEN;
+		m_hdr->fmt = m_fmt;
+		m_hdr->freq = m_freq;
+		m_hdr->rate = m_rate;
+		m_hdr->gain = m_gain;
+		memcpy(m_hdr->device, m_device, sizeof(m_hdr->device));
+	}
+
+	return m_cur + HDR_LEN + m_hdr->count * m_sample_size;
+}
+
+
+/*
+ * len samples were read, into the space from poke() if there was any.  The
+ * first skip of them were taken before the last retune settled.
+ */
+void iq_recorder::wrote(unsigned int len, unsigned int skip) {
+
+	struct timeval tv;
+
+	if(!m_running)
+		return;
+	if(!m_cur) {
+		m_dropped += len;
+		m_dropped_total += len;
+		return;
+	}
+
+	// a retune starts a chunk, so unsettled samples can only lead
+	if(m_hdr->skip == m_hdr->count)
+		m_hdr->skip += skip;
+	if(!m_hdr->count) {
+		gettimeofday(&tv, 0);
+		m_hdr->time = tv.tv_sec + tv.tv_usec * 1e-6;
+		if(m_rate > 0.0)
+			m_hdr->time -= len / m_rate;
+		m_hdr->dropped = m_dropped;
+		m_dropped = 0;
+	}
+	m_hdr->count += len;
+}
+
+
+/*
+ * Hand the chunk being filled to the writer, padded out to ALIGN.
+ */
+void iq_recorder::queue_chunk() {
+
+	size_t len;
+
+	if(!m_cur)
+		return;
+	if(!m_hdr->count) {
+		pthread_mutex_lock(&m_mutex);
+		m_free[m_nfree++] = m_cur;
+		pthread_mutex_unlock(&m_mutex);
+		m_cur = 0;
+		m_hdr = 0;
+		return;
+	}
+
+	len = HDR_LEN + m_hdr->count * m_sample_size;
+	m_hdr->len = (len + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+	memset(m_cur + len, 0, m_hdr->len - len);
+
+	pthread_mutex_lock(&m_mutex);
+	m_queue[(m_q_head + m_q_len++) % NCHUNKS] = m_cur;
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+	m_cur = 0;
+	m_hdr = 0;
+}
+
+
+void *iq_recorder::writer_main(void *arg) {
+
+	((iq_recorder *)arg)->writer();
+	return 0;
+}
+
+
+void iq_recorder::writer() {
+
+	char *c;
+
+	pthread_mutex_lock(&m_mutex);
+	for(;;) {
+		while(!m_q_len && !m_stop)
+			pthread_cond_wait(&m_cond, &m_mutex);
+		if(!m_q_len)
+			break;
+		c = m_queue[m_q_head];
+		m_q_head = (m_q_head + 1) % NCHUNKS;
+		m_q_len--;
+		pthread_mutex_unlock(&m_mutex);
+
+		if(!m_failed && write_chunk(c))
+			m_failed = 1;
+
+		pthread_mutex_lock(&m_mutex);
+		m_free[m_nfree++] = c;
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+int iq_recorder::write_chunk(char *c) {
+
+	size_t len = ((kal_chunk *)c)->len, off = 0;
+	ssize_t r;
+
+	while(off < len) {
+		r = write(m_fd, c + off, len - off);
+		if(r > 0) {
+			off += r;
+			continue;
+		}
+		if((r < 0) && (errno == EINTR))
+			continue;
+
+#ifdef O_DIRECT
+		// some filesystems only refuse O_DIRECT when written to
+		if((r < 0) && (errno == EINVAL) && m_direct) {
+			fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+			m_direct = 0;
+			continue;
+		}
+#endif
+		fprintf(stderr, "error: %s: %s, recording stopped\n", m_path,
+		   (r < 0)? strerror(errno) : "short write");
+		return -1;
+	}
+	m_written += len;
+
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * iq_recorder
+ *
+ * Tees the raw samples a receiver reads into a .kal file, so a calibration
+ * can be looked at again afterwards with -I file:NAME.kal.  The file is a
+ * run of chunks, each a kal_chunk header followed by samples in the
+ * receiver's native format and padded to ALIGN.  A chunk holds samples
+ * taken with the one frequency, rate and gain; a change starts a new chunk.
+ *
+ * The receiver reads straight into the chunk being filled with poke() and
+ * wrote().  Full chunks go to a writer thread that writes them whole with
+ * O_DIRECT, or F_NOCACHE on macOS, where the filesystem takes it.  The
+ * capture never waits on the disk: with every chunk still queued for
+ * writing, samples are left out of the recording and the next chunk says
+ * how many.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define KAL_MAGIC	"kaliq01"
+
+struct kal_chunk {
+	char		magic[8];	// KAL_MAGIC
+	uint32_t	hdr_len;	// samples start here
+	uint32_t	fmt;		// file_source::FMT_*
+	uint64_t	len;		// whole chunk, header and padding included
+	uint64_t	count;		// samples
+	uint64_t	skip;		// leading samples taken before the tuner settled
+	uint64_t	dropped;	// samples left out just before this chunk
+	double		freq;		// tuned frequency
+	double		rate;		// receiver's sample rate
+	double		gain;
+	double		time;		// first sample, seconds since the epoch
+	char		device[64];
+};
+
+
+class iq_recorder {
+public:
+	iq_recorder(const char *path, int fmt, unsigned int sample_size, const char *device);
+	~iq_recorder();
+
+	int open();
+	void close();
+
+	void set_meta(double freq, double rate, double gain);
+	void *poke(unsigned int len);
+	void wrote(unsigned int len, unsigned int skip);
+
+	unsigned long long written() { return m_written; };
+	unsigned long long dropped() { return m_dropped_total; };
+
+	static const unsigned int	ALIGN		= 4096;
+	static const unsigned int	HDR_LEN		= 256;
+	static const unsigned int	CHUNK_LEN	= (1 << 20);
+	static const unsigned int	NCHUNKS		= 32;
+
+private:
+	static void *writer_main(void *arg);
+	void writer();
+	int write_chunk(char *c);
+	void queue_chunk();
+
+	char			m_path[BUFSIZ],
+				m_device[64];
+	int			m_fd,
+				m_fmt,
+				m_direct,
+				m_failed,
+				m_stop,
+				m_running;
+	unsigned int		m_sample_size;
+
+	double			m_freq,
+				m_rate,
+				m_gain;
+
+	char			*m_mem;
+	char			*m_cur;		// chunk being filled
+	kal_chunk		*m_hdr;		// its header
+	unsigned long long	m_dropped,	// since the last chunk
+				m_dropped_total,
+				m_written;
+
+	char			**m_free;	// free chunks
+	char			**m_queue;	// waiting to be written
+	unsigned int		m_nfree,
+				m_q_head,
+				m_q_len;
+
+	pthread_t		m_thread;
+	pthread_mutex_t		m_mutex;
+	pthread_cond_t		m_cond;
+};
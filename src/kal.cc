@@ -61,10 +61,17 @@
 #include "usrp_source.h"
 #endif
 
+#include "file_source.h"
+#include "synth_source.h"
 #include "fcch_detector.h"
+#include "pipeline.h"
 #include "arfcn_freq.h"
 #include "offset.h"
 #include "c0_detect.h"
+#include "scan_cache.h"
+#include "daemon.h"
+#include "instr.h"
+#include "trace.h"
 #include "version.h"
 #ifdef _WIN32
 #include <getopt.h>
@@ -73,6 +80,7 @@
 #endif
 
 #define GSM_RATE (1625000.0 / 6.0)
+#define MAX_BANDS 8
 
 
 int g_verbosity = 0;
@@ -88,17 +96,38 @@ void usage(char *prog) {
 	printf("\n");
 	printf("\tClock Offset Calculation:\n");
 	printf("\t\t%s <-f frequency | -c channel> [options]\n", basename(prog));
+	printf("\t\t%s <-s band indicator> -a [options]\n", basename(prog));
+	printf("\n");
+	printf("\tCalibration Daemon:\n");
+	printf("\t\t%s <-S socket path> [options]\n", basename(prog));
 	printf("\n");
 	printf("Where options are:\n");
-	printf("\t-s\tband to scan (GSM850, GSM-R, GSM900, EGSM, DCS, PCS)\n");
+	printf("\t-s\tbands to scan, comma separated (GSM850, GSM-R, GSM900, EGSM, DCS, PCS) or all\n");
 	printf("\t-f\tfrequency of nearby GSM base station\n");
 	printf("\t-c\tchannel of nearby GSM base station\n");
 	printf("\t-b\tband indicator (GSM850, GSM-R, GSM900, EGSM, DCS, PCS)\n");
 	printf("\t-g\tgain in dB\n");
 	printf("\t-d\trtl-sdr device index\n");
 	printf("\t-e\tinitial frequency error in ppm\n");
+	printf("\t-j\tdetector threads (default: one per extra core)\n");
+	printf("\t-p\tmeasure channel power from spectra at this sample rate, e.g., 2.4e6\n");
+	printf("\t-r\thardware sample rate, e.g., 1.083e6 or 2.166e6 (rtl-sdr)\n");
+	printf("\t-w\twideband scan sample rate, a multiple of 200kHz\n");
+	printf("\t-t\tstop the offset calculation once it is good to this many ppm\n");
+	printf("\t-T\tstop the offset calculation after this many seconds (default with -t: 30)\n");
+	printf("\t-k\ttrack drift, with a summary every this many seconds (-T to stop)\n");
+	printf("\t-S\trun as a daemon taking jobs on this UNIX socket\n");
+	printf("\t-a\tfind the strongest base station in the -s bands and calibrate on it\n");
+	printf("\t-C\twarm start the scan from the cache in ~/.kal_scan_cache\n");
+	printf("\t-I\treplay a recording instead: file:PATH or dir:PATH,\n");
+	printf("\t\toptionally followed by ,fmt=cu8|cs16|cf32 ,rate=HZ ,freq=HZ ,loop\n");
+	printf("\t\tor a synthetic base station: synth:[freq=HZ][,ppm=][,snr=DB]\n");
+	printf("\t\t[,aci=DB][,dc=DB][,drop=P][,rate=HZ][,seed=N]\n");
+	printf("\t-W\trecord every sample read to this .kal file, replay with -I file:\n");
+	printf("\t-P\ttime the stages and report at exit, on stderr for -, else as JSON to this file\n");
+	printf("\t-X\trecord a per-thread timeline to this file, convert with kal_trace\n");
 	printf("\t-v\tverbose\n");
-	printf("\t-D\tenable debug messages\n");
+	printf("\t-D\tenable debug messages, with -X printed in time order at exit\n");
 	printf("\t-h\thelp\n");
 	exit(-1);
 }
@@ -108,19 +137,31 @@ int main(int argc, char **argv) {
 
 	char *endptr;
 	int c, antenna = 1, bi = BI_NOT_DEFINED, chan = -1, bts_scan = 0;
-	int ppm_error = 0;
-	unsigned int subdev = 0, decimation = 32;
+	int warm_start = 0, find_c0 = 0;
+	int bands[MAX_BANDS], nbands = 0;
+	char band_names[BUFSIZ];
+	char *daemon_path = 0, *input_spec = 0, *record_path = 0, *instr_path = 0,
+	   *trace_path = 0;
+	int r;
+	unsigned int subdev = 0;
+	unsigned int nworkers = scan_pipeline::default_workers();
 #ifdef XTRX_DEV
+	unsigned int decimation = 32;
 	long int fpga_master_clock_freq = 0;
 #else
+	double hw_rate = GSM_RATE;
 	long int fpga_master_clock_freq = 52000000;
 #endif
 	float gain = 0;
-	double freq = -1.0;
-	usrp_source *u;
+	double freq = -1.0, wide_rate = 0.0, sweep_rate = 0.0, ppm_error = 0.0;
+	double target_ppm = 0.0, max_time = 0.0, track_interval = 0.0;
+	sample_source *u;
+	scan_pipeline *p;
+	scan_cache *cache = 0;
+	sweep_chan c0;
 	unsigned loglevel = 2;
 
-	while((c = getopt(argc, argv, "F:l:f:c:s:b:R:A:g:e:d:vDh?")) != EOF) {
+	while((c = getopt(argc, argv, "F:l:f:c:s:b:R:A:g:e:d:j:p:r:w:t:T:S:k:I:W:P:X:aCvDh?")) != EOF) {
 		switch(c) {
 			case 'l':
 				loglevel = atoi(optarg);
@@ -135,11 +176,8 @@ int main(int argc, char **argv) {
 				break;
 
 			case 's':
-				if((bi = str_to_bi(optarg)) == -1) {
-					fprintf(stderr, "error: bad band "
-					   "indicator: ``%s''\n", optarg);
+				if((nbands = str_to_bands(optarg, bands, MAX_BANDS)) <= 0)
 					usage(argv[0]);
-				}
 				bts_scan = 1;
 				break;
 
@@ -201,13 +239,71 @@ int main(int argc, char **argv) {
 				break;
 
 			case 'e':
-				ppm_error = strtol(optarg, 0, 0);
+				ppm_error = strtod(optarg, 0);
 				break;
 
 			case 'd':
 				subdev = strtol(optarg, 0, 0);
 				break;
 
+			case 'j':
+				nworkers = strtoul(optarg, 0, 0);
+				break;
+
+			case 'p':
+				sweep_rate = strtod(optarg, 0);
+				break;
+
+			case 'r':
+#ifndef XTRX_DEV
+				hw_rate = strtod(optarg, 0);
+#endif
+				break;
+
+			case 'w':
+				wide_rate = strtod(optarg, 0);
+				break;
+
+			case 't':
+				target_ppm = strtod(optarg, 0);
+				break;
+
+			case 'T':
+				max_time = strtod(optarg, 0);
+				break;
+
+			case 'k':
+				track_interval = strtod(optarg, 0);
+				break;
+
+			case 'I':
+				input_spec = optarg;
+				break;
+
+			case 'W':
+				record_path = optarg;
+				break;
+
+			case 'P':
+				instr_path = optarg;
+				break;
+
+			case 'X':
+				trace_path = optarg;
+				break;
+
+			case 'S':
+				daemon_path = optarg;
+				break;
+
+			case 'a':
+				find_c0 = 1;
+				break;
+
+			case 'C':
+				warm_start = 1;
+				break;
+
 			case 'v':
 				g_verbosity++;
 				break;
@@ -227,11 +323,17 @@ int main(int argc, char **argv) {
 
 	// sanity check frequency / channel
 	if(bts_scan) {
-		if(bi == BI_NOT_DEFINED) {
+		if(!nbands) {
 			fprintf(stderr, "error: scaning requires band\n");
 			usage(argv[0]);
 		}
-	} else {
+		band_names[0] = 0;
+		for(c = 0; c < nbands; c++) {
+			snprintf(band_names + strlen(band_names),
+			   sizeof(band_names) - strlen(band_names), "%s%s",
+			   c? ", " : "", bi_to_str(bands[c]));
+		}
+	} else if(!daemon_path) {
 		if(freq < 0.0) {
 			if(chan < 0) {
 				fprintf(stderr, "error: must enter channel or "
@@ -264,13 +366,45 @@ int main(int argc, char **argv) {
 		printf("debug: Mac OS X version\n");
 #endif
 		printf("debug: FPGA Master Clock Freq:\t%li\n", fpga_master_clock_freq);
+#ifdef XTRX_DEV
 		printf("debug: decimation            :\t%u\n", decimation);
+#else
+		printf("debug: Hardware sample rate  :\t%.0f\n", hw_rate);
+#endif
 		printf("debug: RX Subdev Spec        :\t%s\n", subdev? "B" : "A");
 		printf("debug: Antenna               :\t%s\n", antenna? "RX2" : "TX/RX");
 		printf("debug: Gain                  :\t%f\n", gain);
+		printf("debug: Detector threads      :\t%u\n", nworkers);
+		if(wide_rate > 0.0)
+			printf("debug: Wideband scan rate    :\t%.0f\n", wide_rate);
+		if(sweep_rate > 0.0)
+			printf("debug: Spectrum sweep rate   :\t%.0f\n", sweep_rate);
+		if(target_ppm > 0.0)
+			printf("debug: Offset target         :\t%.3f ppm\n", target_ppm);
+		if(max_time > 0.0)
+			printf("debug: Offset time limit     :\t%.1f s\n", max_time);
 	}
 
-	u = new usrp_source(decimation, fpga_master_clock_freq, loglevel);
+	if(instr_path && instr_enable(instr_path)) {
+		fprintf(stderr, "error: can't write the report to %s\n", instr_path);
+		return -1;
+	}
+	if((trace_path || g_debug) && trace_enable(trace_path, g_debug)) {
+		fprintf(stderr, "error: can't write the trace to %s\n", trace_path);
+		return -1;
+	}
+	trace_thread_name("main");
+
+	if(input_spec && !strncmp(input_spec, "synth", 5))
+		u = new synth_source(input_spec);
+	else if(input_spec)
+		u = new file_source(input_spec);
+	else
+#ifdef XTRX_DEV
+		u = new usrp_source(decimation, fpga_master_clock_freq, loglevel);
+#else
+		u = new usrp_source((float)hw_rate, fpga_master_clock_freq, loglevel);
+#endif
 	if(!u) {
 		fprintf(stderr, "error: usrp_source\n");
 		return -1;
@@ -287,14 +421,62 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	if (ppm_error != 0) {
+	if (ppm_error != 0.0) {
 		if(u->set_freq_correction(ppm_error) < 0) {
 			fprintf(stderr, "error: usrp_source::set_freq_correction\n");
 			return -1;
 		}
 	}
 
+	if(record_path && u->record(record_path)) {
+		fprintf(stderr, "error: can't record to %s\n", record_path);
+		return -1;
+	}
+
+	if(bts_scan && !find_c0 && (wide_rate > 0.0)) {
+		fprintf(stderr, "%s: Scanning for %s base stations.\n",
+		   basename(argv[0]), band_names);
+
+		if(warm_start) {
+			fprintf(stderr, "warning: the wideband scan doesn't use "
+			   "the scan cache\n");
+		}
+		r = c0_detect_wideband(u, bands, nbands, wide_rate, nworkers);
+		if(g_verbosity > 0)
+			u->report_settle();
+		delete u;
+		return r;
+	}
+
+	p = new scan_pipeline(u->sample_rate(), nworkers);
+
+	if(daemon_path) {
+		r = kal_daemon(u, p, daemon_path);
+		delete p;
+		delete u;
+		return r;
+	}
+
+	/*
+	 * Scan and calibrate in one go: the strongest C0 found is used with
+	 * the same source and detectors.
+	 */
+	if(bts_scan && find_c0) {
+		fprintf(stderr, "%s: Looking for a %s base station.\n",
+		   basename(argv[0]), band_names);
+		if(c0_find(u, bands, nbands, sweep_rate, p, &c0)) {
+			delete p;
+			delete u;
+			return -1;
+		}
+		freq = c0.freq;
+		chan = c0.arfcn;
+		bi = c0.bi;
+		bts_scan = 0;
+	}
+
 	if(!bts_scan) {
+		instr_channel(freq);
 		if(!u->tune(freq)) {
 			fprintf(stderr, "error: usrp_source::tune\n");
 			return -1;
@@ -305,11 +487,27 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "Using %s channel %d (%.1fMHz)\n",
 		   bi_to_str(bi), chan, freq / 1e6);
 
-		return offset_detect(u);
+		if(track_interval > 0.0)
+			r = offset_track(u, p, track_interval, max_time);
+		else
+			r = offset_detect(u, p, target_ppm, max_time);
+		if(g_verbosity > 0)
+			u->report_settle();
+		delete p;
+		delete u;
+		return r;
 	}
 
 	fprintf(stderr, "%s: Scanning for %s base stations.\n",
-	   basename(argv[0]), bi_to_str(bi));
-
-	return c0_detect(u, bi);
+	   basename(argv[0]), band_names);
+
+	if(warm_start)
+		cache = new scan_cache(u->device_id());
+	r = c0_detect(u, bands, nbands, sweep_rate, p, cache);
+	if(g_verbosity > 0)
+		u->report_settle();
+	delete cache;
+	delete p;
+	delete u;
+	return r;
 }
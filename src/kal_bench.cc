@@ -0,0 +1,490 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * kal_bench
+ *
+ * Times the DSP hot paths one at a time on synthetic input, so changes can
+ * be compared across versions and machines.  Each benchmark is repeated,
+ * doubling the count, until a run takes the minimum time, and the last run
+ * is reported:
+ *
+ *	bench		what was timed
+ *	op		what one operation is
+ *	ops		operations in the reported run
+ *	samples		samples (or items) those operations went through
+ *	ns_per_op	wall time per operation
+ *	samples_per_s	throughput
+ *	cycles_per_op	time stamp counter ticks per operation, where there is
+ *			one (x86), -1 elsewhere
+ *
+ * as CSV, or JSON with -J.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#else
+#define PACKAGE_VERSION "custom build"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "usrp_complex.h"
+#include "circular_buffer.h"
+#include "fcch_detector.h"
+#include "synth_source.h"
+#include "nco.h"
+#include "decimator.h"
+#include "version.h"
+
+int g_verbosity = 0;
+int g_debug = 0;
+
+// one capture as the scan takes it: 12 frames and a burst
+static const unsigned int CAPTURE_LEN = 15157;
+static const unsigned int BLOCK = 16384;
+static const unsigned int CB_BLOCK = 512;
+static const unsigned int CB_LEN = 16 * 16384;
+
+static complex g_capture[CAPTURE_LEN];
+static complex g_block[BLOCK], g_out[BLOCK];
+static unsigned char g_u8[2 * BLOCK];
+static fcch_detector *g_detector;
+static synth_source *g_synth;
+static volatile float g_sink;
+
+
+static double now() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static inline unsigned long long ticks() {
+
+#if HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+
+/*
+ * Each benchmark runs ops operations and returns the samples they took.
+ */
+static unsigned long long bench_next_norm_error(unsigned long long ops) {
+
+	unsigned long long i;
+	float e = 0.0;
+
+	for(i = 0; i < ops; i++) {
+		g_detector->update(g_capture + i % CAPTURE_LEN, 1);
+		g_detector->next_norm_error(&e);
+	}
+	g_sink = e;
+
+	return ops;
+}
+
+
+static unsigned long long bench_scan(unsigned long long ops) {
+
+	unsigned long long i;
+	unsigned int consumed;
+	float offset = 0.0;
+
+	for(i = 0; i < ops; i++)
+		g_detector->scan(g_capture, CAPTURE_LEN, &offset, &consumed);
+	g_sink = offset;
+
+	return ops * CAPTURE_LEN;
+}
+
+
+static unsigned long long bench_freq_detect(unsigned long long ops) {
+
+	unsigned long long i;
+	float pm = 0.0;
+
+	for(i = 0; i < ops; i++)
+		g_sink = g_detector->freq_detect(g_capture, 148, &pm);
+
+	return ops * 148;
+}
+
+
+static unsigned long long bench_peak_detect(unsigned long long ops) {
+
+	unsigned long long i;
+	float avg;
+	complex peak;
+
+	for(i = 0; i < ops; i++)
+		g_sink = fcch_detector::peak_detect(g_block, 1024, &peak, &avg);
+
+	return ops * 1024;
+}
+
+
+static unsigned long long bench_nco_cu8(unsigned long long ops) {
+
+	unsigned long long i;
+	nco n;
+
+	n.set_freq(947.0, 4 * GSM_RATE);
+	for(i = 0; i < ops; i++)
+		n.mix(g_u8, g_out, BLOCK);
+	g_sink = g_out[0].real();
+
+	return ops * BLOCK;
+}
+
+
+static unsigned long long bench_nco_cf32(unsigned long long ops) {
+
+	unsigned long long i;
+	nco n;
+
+	n.set_freq(947.0, 4 * GSM_RATE);
+	for(i = 0; i < ops; i++)
+		n.mix(g_block, g_out, BLOCK);
+	g_sink = g_out[0].real();
+
+	return ops * BLOCK;
+}
+
+
+/*
+ * What usrp_source::fill() does with a USB packet at 4x the GSM rate.
+ */
+static unsigned long long bench_fill_cu8(unsigned long long ops) {
+
+	unsigned long long i;
+	nco n;
+	decimator d(4);
+
+	n.set_freq(947.0, 4 * GSM_RATE);
+	for(i = 0; i < ops; i++) {
+		n.mix(g_u8, d.poke(BLOCK), BLOCK);
+		d.wrote(BLOCK, g_out);
+	}
+	g_sink = g_out[0].real();
+
+	return ops * BLOCK;
+}
+
+
+static unsigned long long bench_synth(unsigned long long ops) {
+
+	unsigned long long i;
+	circular_buffer *cb = g_synth->get_buffer();
+
+	for(i = 0; i < ops; i++) {
+		g_synth->fill(BLOCK, 0);
+		cb->flush();
+	}
+
+	return ops * BLOCK;
+}
+
+
+static unsigned long long cb_single(unsigned long long ops, int spsc) {
+
+	unsigned long long i;
+	unsigned int len;
+	circular_buffer cb(CB_LEN, sizeof(complex), 0, spsc);
+
+	for(i = 0; i < ops; i++) {
+		cb.write(g_block, CB_BLOCK);
+		g_sink = ((complex *)cb.peek(&len))->real();
+		cb.purge(len);
+	}
+
+	return ops * CB_BLOCK;
+}
+
+
+static unsigned long long bench_cb_mutex(unsigned long long ops) {
+
+	return cb_single(ops, 0);
+}
+
+
+static unsigned long long bench_cb_spsc(unsigned long long ops) {
+
+	return cb_single(ops, 1);
+}
+
+
+struct cb_arg {
+	circular_buffer		*cb;
+	unsigned long long	items;
+};
+
+
+static void *cb_reader(void *arg) {
+
+	cb_arg *a = (cb_arg *)arg;
+	unsigned long long got = 0;
+	unsigned int len;
+	complex *c;
+
+	while(got < a->items) {
+		c = (complex *)a->cb->peek(&len);
+		if(!len) {
+			sched_yield();
+			continue;
+		}
+		g_sink = c->real();
+		a->cb->purge(len);
+		got += len;
+	}
+
+	return 0;
+}
+
+
+/*
+ * A capture thread writing and a reader taking the samples, as the receivers
+ * and detectors do.
+ */
+static unsigned long long cb_threaded(unsigned long long ops, int spsc) {
+
+	unsigned long long i;
+	unsigned int n, w;
+	pthread_t t;
+	cb_arg a;
+
+	a.cb = new circular_buffer(CB_LEN, sizeof(complex), 0, spsc);
+	a.items = ops * CB_BLOCK;
+	if(pthread_create(&t, 0, cb_reader, &a)) {
+		fprintf(stderr, "error: pthread_create\n");
+		exit(1);
+	}
+	for(i = 0; i < ops; i++) {
+		for(n = 0; n < CB_BLOCK; n += w) {
+			if(!(w = a.cb->write(g_block + n, CB_BLOCK - n)))
+				sched_yield();
+		}
+	}
+	pthread_join(t, 0);
+	delete a.cb;
+
+	return ops * CB_BLOCK;
+}
+
+
+static unsigned long long bench_cb_mutex_2t(unsigned long long ops) {
+
+	return cb_threaded(ops, 0);
+}
+
+
+static unsigned long long bench_cb_spsc_2t(unsigned long long ops) {
+
+	return cb_threaded(ops, 1);
+}
+
+
+static const struct bench {
+	const char		*name,
+				*op;
+	unsigned long long	(*run)(unsigned long long ops);
+} benches[] = {
+	{ "next_norm_error",	"sample",		bench_next_norm_error },
+	{ "scan",		"12 frame capture",	bench_scan },
+	{ "freq_detect",	"candidate",		bench_freq_detect },
+	{ "peak_detect",	"1024 bin spectrum",	bench_peak_detect },
+	{ "nco_mix_cu8",	"16384 samples",	bench_nco_cu8 },
+	{ "nco_mix_cf32",	"16384 samples",	bench_nco_cf32 },
+	{ "fill_cu8_dec4",	"16384 samples",	bench_fill_cu8 },
+	{ "synth",		"16384 samples",	bench_synth },
+	{ "cb_mutex",		"512 item write/peek/purge",	bench_cb_mutex },
+	{ "cb_spsc",		"512 item write/peek/purge",	bench_cb_spsc },
+	{ "cb_mutex_2t",	"512 items across threads",	bench_cb_mutex_2t },
+	{ "cb_spsc_2t",		"512 items across threads",	bench_cb_spsc_2t },
+	{ 0, 0, 0 }
+};
+
+
+static int setup() {
+
+	unsigned int i;
+	unsigned int len;
+	complex *c;
+	float offset;
+
+	g_synth = new synth_source("synth:freq=947e6,ppm=1,snr=20");
+	if(g_synth->open(0))
+		return -1;
+	g_synth->tune(947e6);
+	g_synth->fill(BLOCK, 0);
+	c = (complex *)g_synth->get_buffer()->peek(&len);
+	memcpy(g_block, c, sizeof(g_block));
+	g_synth->get_buffer()->flush();
+	g_synth->fill(CAPTURE_LEN, 0);
+	c = (complex *)g_synth->get_buffer()->peek(&len);
+	memcpy(g_capture, c, sizeof(g_capture));
+	g_synth->get_buffer()->flush();
+
+	for(i = 0; i < BLOCK; i++) {
+		g_u8[2 * i] = (unsigned char)(127.5 + g_block[i].real() / 16);
+		g_u8[2 * i + 1] = (unsigned char)(127.5 + g_block[i].imag() / 16);
+	}
+
+	g_detector = new fcch_detector(GSM_RATE);
+
+	// the scan should be timed finding something
+	if(!g_detector->scan(g_capture, CAPTURE_LEN, &offset, 0))
+		fprintf(stderr, "warning: no FCCH in the benchmark capture\n");
+
+	return 0;
+}
+
+
+static void usage(char *prog) {
+
+	printf("kal_bench v%s\n", kal_version_string);
+	printf("\nUsage:\n");
+	printf("\t%s [options] [benchmark ...]\n", prog);
+	printf("\n");
+	printf("Where options are:\n");
+	printf("\t-t\tminimum time per benchmark in seconds (default: 0.5)\n");
+	printf("\t-J\tJSON output instead of CSV\n");
+	printf("\t-l\tlist the benchmarks\n");
+	printf("\t-h\thelp\n");
+	exit(-1);
+}
+
+
+int main(int argc, char **argv) {
+
+	int c, i, j, json = 0, first = 1;
+	double min_time = 0.5, t0, t;
+	unsigned long long ops, samples, k0, k;
+	const bench *b;
+
+	while((c = getopt(argc, argv, "t:Jlh?")) != EOF) {
+		switch(c) {
+			case 't':
+				min_time = strtod(optarg, 0);
+				break;
+
+			case 'J':
+				json = 1;
+				break;
+
+			case 'l':
+				for(b = benches; b->name; b++)
+					printf("%s\t%s\n", b->name, b->op);
+				return 0;
+
+			case 'h':
+			case '?':
+			default:
+				usage(argv[0]);
+				break;
+		}
+	}
+
+	if(setup())
+		return -1;
+
+	if(json) {
+		printf("{\n\t\"version\": \"%s\",\n\t\"tsc\": %s,\n\t\"results\": [",
+		   kal_version_string, HAVE_TSC? "true" : "false");
+	} else
+		printf("bench,op,ops,samples,ns_per_op,samples_per_s,cycles_per_op\n");
+
+	for(b = benches; b->name; b++) {
+		// only the ones named
+		for(j = optind; j < argc; j++) {
+			if(!strcmp(argv[j], b->name))
+				break;
+		}
+		if((optind < argc) && (j == argc))
+			continue;
+
+		b->run(1);
+		for(ops = 1;; ops *= 2) {
+			t0 = now();
+			k0 = ticks();
+			samples = b->run(ops);
+			k = ticks() - k0;
+			t = now() - t0;
+			if(t >= min_time)
+				break;
+		}
+
+		if(json) {
+			printf("%s\n\t\t{ \"bench\": \"%s\", \"op\": \"%s\", "
+			   "\"ops\": %llu, \"samples\": %llu, \"ns_per_op\": %.3f, "
+			   "\"samples_per_s\": %.0f, \"cycles_per_op\": %.1f }",
+			   first? "" : ",", b->name, b->op, ops, samples,
+			   t * 1e9 / ops, samples / t,
+			   HAVE_TSC? (double)k / ops : -1.0);
+		} else {
+			printf("%s,%s,%llu,%llu,%.3f,%.0f,%.1f\n", b->name, b->op,
+			   ops, samples, t * 1e9 / ops, samples / t,
+			   HAVE_TSC? (double)k / ops : -1.0);
+		}
+		fflush(stdout);
+		first = 0;
+	}
+
+	if(json)
+		printf("\n\t]\n}\n");
+
+	for(i = optind; i < argc; i++) {
+		for(b = benches; b->name; b++) {
+			if(!strcmp(argv[i], b->name))
+				break;
+		}
+		if(!b->name)
+			fprintf(stderr, "warning: no benchmark ``%s''\n", argv[i]);
+	}
+
+	delete g_detector;
+	delete g_synth;
+
+	return 0;
+}
@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * kal_eval
+ *
+ * Measures what the FCCH detector gets right over a grid of inputs, so a
+ * change made for speed can be shown not to cost accuracy.  For every SNR,
+ * frequency offset and capture length a number of captures are scanned, as
+ * the offset calculation scans them, and for each configuration we report
+ *
+ *	det_rate	captures where the FCCH was found within TOLERANCE of
+ *			the true offset
+ *	fa_rate		noise only captures where something was found
+ *	rms_err_hz	RMS error of the offsets found
+ *	mean_err_hz	error of their trimmed mean, as offset_detect() takes it
+ *	ppm_err		the same in ppm at the carrier frequency
+ *	cpu_us		detector CPU time per capture
+ *
+ * The input is the synthetic source by default, or a recording with -I and
+ * the crystal error it was made with (-x).  The offsets are applied on top
+ * as a frequency correction, the SNR only applies to the synthetic input.
+ * The configurations are shared out over all cores.
+ *
+ * With -c, the results are compared against an earlier run's CSV and the
+ * exit status is 1 if detection got worse by more than chance explains, or
+ * false alarms or the RMS error went up.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#else
+#define PACKAGE_VERSION "custom build"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "usrp_complex.h"
+#include "fcch_detector.h"
+#include "sample_source.h"
+#include "synth_source.h"
+#include "file_source.h"
+#include "stats.h"
+#include "version.h"
+
+int g_verbosity = 0;
+int g_debug = 0;
+
+static const float TOLERANCE = 500.0;		// Hz
+static const float OFFSET_MAX = 40e3;		// as offset_detect()
+static const double AVG_TRIM = 0.1;
+static const double NOISE_AWAY = 10e6;		// puts the synthetic C0 out of band
+static const unsigned int MAX_GRID = 64;
+
+struct config {
+	double		snr,
+			offset;
+	unsigned int	frames;
+
+	// results
+	unsigned int	trials,
+			detected,
+			noise_trials,
+			false_alarms;
+	double		rms_err,
+			mean_err,
+			cpu_us;
+	int		failed;
+};
+
+static double g_snr[MAX_GRID], g_offset[MAX_GRID];
+static unsigned int g_frames[MAX_GRID];
+static double g_fc = 947e6, g_truth_ppm = 0.0;
+static unsigned int g_trials = 50;
+static const char *g_input = 0;
+
+static config *g_configs;
+static unsigned int g_nconfigs, g_next;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static unsigned int parse_list(const char *s, double *v) {
+
+	unsigned int n = 0;
+	char *e;
+
+	while(*s && (n < MAX_GRID)) {
+		v[n++] = strtod(s, &e);
+		if(e == s)
+			return 0;
+		s = (*e == ',')? e + 1 : e;
+	}
+
+	return n;
+}
+
+
+static double cpu_time() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static sample_source *open_source(const config *c, int noise, unsigned int seed) {
+
+	char spec[BUFSIZ];
+	sample_source *u;
+
+	if(g_input && !noise)
+		u = new file_source(g_input);
+	else {
+		snprintf(spec, sizeof(spec), "synth:freq=%.0f,snr=%.2f,seed=%u",
+		   g_fc + (noise? NOISE_AWAY : 0.0), c->snr, seed);
+		u = new synth_source(spec);
+	}
+	if(u->open(0)) {
+		delete u;
+		return 0;
+	}
+	u->tune(g_fc);
+	u->set_freq_correction(c->offset / g_fc * 1e6);
+
+	return u;
+}
+
+
+/*
+ * Scan n captures of len samples from u, returns the detections and keeps
+ * the errors of those near the truth.  A recording may run out first,
+ * *scanned is how many were.
+ */
+static unsigned int scan_captures(sample_source *u, fcch_detector *l,
+   unsigned int n, unsigned int len, double truth, robust_stats *errs,
+   running_stats *sq, double *cpu, unsigned int *scanned) {
+
+	unsigned int i, found = 0, avail, consumed;
+	float offset;
+	complex *b;
+	circular_buffer *cb = u->get_buffer();
+	double t;
+
+	for(i = 0; i < n; i++) {
+		if(u->fill(len, 0))
+			break;
+		b = (complex *)cb->peek(&avail);
+
+		t = cpu_time();
+		offset = 0.0;
+		if(l->scan(b, len, &offset, &consumed)) {
+			offset -= GSM_RATE / 4;
+			if(!errs)
+				found++;
+			else if(fabs(offset - truth) < TOLERANCE) {
+				found++;
+				sq->add((offset - truth) * (offset - truth));
+				if(fabs(offset) < OFFSET_MAX)
+					errs->add(offset - truth);
+			}
+		}
+		*cpu += cpu_time() - t;
+
+		cb->purge(len);
+	}
+
+	*scanned = i;
+	return found;
+}
+
+
+static void run_config(config *c, fcch_detector *l, unsigned int seed) {
+
+	sample_source *u;
+	robust_stats errs(AVG_TRIM);
+	running_stats sq;
+	unsigned int len;
+	double cpu = 0.0, truth;
+
+	len = (unsigned int)ceil((c->frames * 8 * 156.25 + 156.25));
+	truth = c->offset - g_fc * g_truth_ppm * 1e-6;
+
+	if(!(u = open_source(c, 0, seed))) {
+		c->failed = 1;
+		return;
+	}
+	c->detected = scan_captures(u, l, g_trials, len, truth, &errs, &sq, &cpu,
+	   &c->trials);
+	delete u;
+
+	// a recording too short for even one capture
+	if(!c->trials) {
+		fprintf(stderr, "error: %s: too short for a capture of %u frames\n",
+		   g_input, c->frames);
+		c->failed = 1;
+		return;
+	}
+
+	// a recording has no noise only counterpart
+	c->noise_trials = c->false_alarms = 0;
+	if(!g_input && (u = open_source(c, 1, seed))) {
+		c->false_alarms = scan_captures(u, l, g_trials, len, 0.0, 0, 0, &cpu,
+		   &c->noise_trials);
+		delete u;
+	}
+
+	c->rms_err = sq.count()? sqrt(sq.mean()) : NAN;
+	c->mean_err = errs.count()? errs.trimmed_mean() : NAN;
+	c->cpu_us = cpu * 1e6 / (c->trials + c->noise_trials);
+}
+
+
+static double det_rate(const config *c) {
+
+	return c->trials? (double)c->detected / c->trials : NAN;
+}
+
+
+static double fa_rate(const config *c) {
+
+	return c->noise_trials? (double)c->false_alarms / c->noise_trials : NAN;
+}
+
+
+static int same(double a, double b) {
+
+	return (isnan(a) && isnan(b)) || (a == b);
+}
+
+
+static void *worker(void *arg) {
+
+	fcch_detector l(GSM_RATE);
+	unsigned int i;
+
+	for(;;) {
+		pthread_mutex_lock(&g_mutex);
+		i = g_next++;
+		pthread_mutex_unlock(&g_mutex);
+		if(i >= g_nconfigs)
+			break;
+		run_config(&g_configs[i], &l, i + 1);
+	}
+
+	return 0;
+}
+
+
+/*
+ * Compare against a baseline CSV from an earlier run.  Detection may drop
+ * by two standard errors of the two rates before it counts.
+ */
+static int compare(const char *path) {
+
+	FILE *fp;
+	char line[BUFSIZ];
+	double snr, off, det, fa, rms, p, tol;
+	unsigned int frames, trials, i, worse = 0;
+	config *c;
+
+	if(!(fp = fopen(path, "r"))) {
+		perror(path);
+		return -1;
+	}
+	while(fgets(line, sizeof(line), fp)) {
+		if(sscanf(line, "%lf,%lf,%u,%u,%lf,%lf,%lf", &snr, &off,
+		   &frames, &trials, &det, &fa, &rms) != 7)
+			continue;
+		for(i = 0; i < g_nconfigs; i++) {
+			c = &g_configs[i];
+			if(same(c->snr, snr) && (c->offset == off) && (c->frames == frames))
+				break;
+		}
+		if((i == g_nconfigs) || c->failed)
+			continue;
+
+		p = (det + det_rate(c)) / 2;
+		tol = 2 * sqrt(p * (1 - p) * (1.0 / trials + 1.0 / c->trials)) + 0.01;
+		if(det_rate(c) < det - tol) {
+			fprintf(stderr, "worse: snr %.1f offset %.0f frames %u: "
+			   "detection %.3f, was %.3f\n", snr, off, frames,
+			   det_rate(c), det);
+			worse++;
+		}
+		p = (fa + fa_rate(c)) / 2;
+		tol = 2 * sqrt(p * (1 - p) * (1.0 / trials + 1.0 / c->trials)) + 0.01;
+		if(!isnan(fa) && (fa_rate(c) > fa + tol)) {
+			fprintf(stderr, "worse: snr %.1f offset %.0f frames %u: "
+			   "false alarms %.3f, was %.3f\n", snr, off, frames,
+			   fa_rate(c), fa);
+			worse++;
+		}
+		if(!isnan(rms) && (c->rms_err > 1.1 * rms + 1.0)) {
+			fprintf(stderr, "worse: snr %.1f offset %.0f frames %u: "
+			   "rms error %.1f Hz, was %.1f\n", snr, off, frames,
+			   c->rms_err, rms);
+			worse++;
+		}
+	}
+	fclose(fp);
+
+	return worse? 1 : 0;
+}
+
+
+/*
+ * JSON has no NaN, what couldn't be measured is null.
+ */
+static const char *json_num(char *buf, size_t len, const char *fmt, double x) {
+
+	if(isnan(x))
+		return "null";
+	snprintf(buf, len, fmt, x);
+	return buf;
+}
+
+
+static void usage(char *prog) {
+
+	printf("kal_eval v%s\n", kal_version_string);
+	printf("\nUsage:\n");
+	printf("\t%s [options]\n", prog);
+	printf("\n");
+	printf("Where options are:\n");
+	printf("\t-s\tSNRs in dB, comma separated (default: -3,0,3,6,10,20)\n");
+	printf("\t-o\toffsets in Hz, within +/-40kHz (default: -40000,-20000,-5000,0,5000,20000,40000)\n");
+	printf("\t-l\tcapture lengths in frames (default: 12)\n");
+	printf("\t-n\tcaptures per configuration (default: 50)\n");
+	printf("\t-f\tcarrier frequency for ppm (default: 947e6)\n");
+	printf("\t-I\ta recording to use instead, as kal -I, tuned to -f\n");
+	printf("\t-x\tcrystal error the recording was made with, in ppm\n");
+	printf("\t-j\tthreads (default: one per core)\n");
+	printf("\t-c\tcompare against this earlier CSV output, exit 1 if worse\n");
+	printf("\t-J\tJSON output instead of CSV\n");
+	printf("\t-h\thelp\n");
+	exit(-1);
+}
+
+
+int main(int argc, char **argv) {
+
+	int c, json = 0, first = 1;
+	char b0[32], b1[32], b2[32], b3[32], b4[32];
+	unsigned int nsnr, noff, nlen, i, j, k, nthreads = 0;
+	double v[MAX_GRID];
+	const char *baseline = 0;
+	pthread_t *threads;
+	config *cf;
+
+	nsnr = parse_list("-3,0,3,6,10,20", g_snr);
+	noff = parse_list("-40000,-20000,-5000,0,5000,20000,40000", g_offset);
+	nlen = 1;
+	g_frames[0] = 12;
+
+	while((c = getopt(argc, argv, "s:o:l:n:f:I:x:j:c:Jh?")) != EOF) {
+		switch(c) {
+			case 's':
+				nsnr = parse_list(optarg, g_snr);
+				break;
+
+			case 'o':
+				noff = parse_list(optarg, g_offset);
+				break;
+
+			case 'l':
+				nlen = parse_list(optarg, v);
+				for(i = 0; i < nlen; i++)
+					g_frames[i] = (unsigned int)v[i];
+				break;
+
+			case 'n':
+				g_trials = strtoul(optarg, 0, 0);
+				break;
+
+			case 'f':
+				g_fc = strtod(optarg, 0);
+				break;
+
+			case 'I':
+				g_input = optarg;
+				break;
+
+			case 'x':
+				g_truth_ppm = strtod(optarg, 0);
+				break;
+
+			case 'j':
+				nthreads = strtoul(optarg, 0, 0);
+				break;
+
+			case 'c':
+				baseline = optarg;
+				break;
+
+			case 'J':
+				json = 1;
+				break;
+
+			case 'h':
+			case '?':
+			default:
+				usage(argv[0]);
+				break;
+		}
+	}
+
+	if(!nsnr || !noff || !nlen || !g_trials) {
+		fprintf(stderr, "error: bad grid\n");
+		usage(argv[0]);
+	}
+	for(i = 0; i < noff; i++) {
+		if(fabs(g_offset[i]) > OFFSET_MAX) {
+			fprintf(stderr, "error: offset %.0f is beyond what "
+			   "offset_detect() accepts\n", g_offset[i]);
+			return -1;
+		}
+	}
+	for(i = 0; i < nlen; i++) {
+		if(!g_frames[i] || (g_frames[i] > 48)) {
+			fprintf(stderr, "error: capture length %u frames\n",
+			   g_frames[i]);
+			return -1;
+		}
+	}
+	if(g_input)
+		nsnr = 1;
+
+	g_nconfigs = nsnr * noff * nlen;
+	g_configs = new config[g_nconfigs];
+	memset(g_configs, 0, sizeof(config) * g_nconfigs);
+	cf = g_configs;
+	for(i = 0; i < nsnr; i++) {
+		for(j = 0; j < noff; j++) {
+			for(k = 0; k < nlen; k++) {
+				cf->snr = g_input? NAN : g_snr[i];
+				cf->offset = g_offset[j];
+				cf->frames = g_frames[k];
+				cf++;
+			}
+		}
+	}
+
+	if(!nthreads) {
+#ifdef _SC_NPROCESSORS_ONLN
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if(nthreads < 1)
+			nthreads = 1;
+	}
+	threads = new pthread_t[nthreads];
+	for(i = 0; i < nthreads; i++) {
+		if(pthread_create(&threads[i], 0, worker, 0)) {
+			fprintf(stderr, "error: pthread_create\n");
+			return -1;
+		}
+	}
+	for(i = 0; i < nthreads; i++)
+		pthread_join(threads[i], 0);
+	delete[] threads;
+
+	if(json)
+		printf("{\n\t\"version\": \"%s\",\n\t\"results\": [", kal_version_string);
+	else
+		printf("snr_db,offset_hz,frames,trials,det_rate,fa_rate,rms_err_hz,"
+		   "mean_err_hz,ppm_err,cpu_us\n");
+	for(i = 0; i < g_nconfigs; i++) {
+		cf = &g_configs[i];
+		if(cf->failed) {
+			fprintf(stderr, "error: configuration %u failed\n", i);
+			continue;
+		}
+		if(json) {
+			printf("%s\n\t\t{ \"snr_db\": %s, \"offset_hz\": %.0f, "
+			   "\"frames\": %u, \"trials\": %u, \"det_rate\": %.4f, "
+			   "\"fa_rate\": %s, \"rms_err_hz\": %s, "
+			   "\"mean_err_hz\": %s, \"ppm_err\": %s, "
+			   "\"cpu_us\": %.1f }", first? "" : ",",
+			   json_num(b0, sizeof(b0), "%.2f", cf->snr), cf->offset,
+			   cf->frames, cf->trials, det_rate(cf),
+			   json_num(b4, sizeof(b4), "%.4f", fa_rate(cf)),
+			   json_num(b1, sizeof(b1), "%.2f", cf->rms_err),
+			   json_num(b2, sizeof(b2), "%.2f", cf->mean_err),
+			   json_num(b3, sizeof(b3), "%.4f", cf->mean_err / g_fc * 1e6),
+			   cf->cpu_us);
+		} else {
+			printf("%.2f,%.0f,%u,%u,%.4f,%.4f,%.2f,%.2f,%.4f,%.1f\n",
+			   cf->snr, cf->offset, cf->frames, cf->trials,
+			   det_rate(cf), fa_rate(cf), cf->rms_err,
+			   cf->mean_err, cf->mean_err / g_fc * 1e6, cf->cpu_us);
+		}
+		first = 0;
+	}
+	if(json)
+		printf("\n\t]\n}\n");
+
+	return baseline? compare(baseline) : 0;
+}
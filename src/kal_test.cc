@@ -0,0 +1,1488 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kal_test
+ *
+ * Checks for the parts that are easy to get subtly wrong and hard to see go
+ * wrong in a scan.  Each test prints ok, or FAIL and why; the exit status is
+ * 1 if any failed.  Tests can be picked by name, -l lists them.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#else
+#define PACKAGE_VERSION "custom build"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <sched.h>
+#include <math.h>
+
+#include "arfcn_freq.h"
+#include "circular_buffer.h"
+#include "file_source.h"
+#include "iq_recorder.h"
+#include "stats.h"
+#include "version.h"
+
+// bytes through each stream test
+static const unsigned long long STREAM_BYTES = 64ull << 20;
+
+static char g_why[256];
+
+int g_verbosity = 0;
+
+
+static int fail(const char *fmt, ...) {
+
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(g_why, sizeof(g_why), fmt, ap);
+	va_end(ap);
+
+	return -1;
+}
+
+
+/*
+ * The stream is a byte sequence with a prime period, so data that comes out
+ * of the wrong place in the buffer, on either side of the wrap, shows.
+ */
+static inline unsigned char stream_byte(unsigned long long k) {
+
+	return k % 251;
+}
+
+
+static void stream_fill(unsigned char *p, unsigned long long k, unsigned int len) {
+
+	unsigned int i;
+
+	for(i = 0; i < len; i++)
+		p[i] = stream_byte(k + i);
+}
+
+
+static int stream_check(const unsigned char *p, unsigned long long k, unsigned int len) {
+
+	unsigned int i;
+
+	for(i = 0; i < len; i++) {
+		if(p[i] != stream_byte(k + i))
+			return fail("byte %llu is %u, expected %u", k + i, p[i], stream_byte(k + i));
+	}
+	return 0;
+}
+
+
+struct stream_arg {
+	circular_buffer		*cb;
+	unsigned int		item_size;
+	unsigned long long	items;
+	volatile int		stop;
+	int			bad;
+};
+
+
+/*
+ * Writes the stream in random sized pieces, by turns with write() and with
+ * poke() and wrote().
+ */
+static void *stream_producer(void *arg) {
+
+	stream_arg *a = (stream_arg *)arg;
+	circular_buffer *cb = a->cb;
+	unsigned int seed = 1, max = cb->buf_len() + cb->buf_len() / 2, want, n,
+	   space;
+	unsigned long long done = 0;
+	unsigned char *buf, *p;
+
+	if(!(buf = (unsigned char *)malloc(max * a->item_size))) {
+		a->bad = 1;
+		return 0;
+	}
+	while((done < a->items) && !a->stop) {
+		want = 1 + rand_r(&seed) % max;
+		if(want > a->items - done)
+			want = a->items - done;
+		if(rand_r(&seed) & 1) {
+			stream_fill(buf, done * a->item_size, want * a->item_size);
+			if((n = cb->write(buf, want)) > want) {
+				a->bad = 1;
+				break;
+			}
+		} else {
+			p = (unsigned char *)cb->poke(&space);
+			if(space > cb->buf_len()) {
+				a->bad = 1;
+				break;
+			}
+			n = (want < space)? want : space;
+			stream_fill(p, done * a->item_size, n * a->item_size);
+			cb->wrote(n);
+		}
+		done += n;
+		if(!n)
+			sched_yield();
+	}
+	free(buf);
+
+	return 0;
+}
+
+
+/*
+ * Reads it back on this thread, by turns with read() and with peek() and
+ * purge(), and checks every byte.
+ */
+static int cb_spsc_stream(unsigned int item_size) {
+
+	circular_buffer *cb;
+	stream_arg a;
+	pthread_t t;
+	unsigned int seed = 2, max, want, n, avail;
+	unsigned long long done = 0;
+	unsigned char *buf, *p;
+	int r = 0;
+
+	cb = new circular_buffer(1000, item_size, 0, 1);
+	max = cb->buf_len() + cb->buf_len() / 2;
+	if(!(buf = (unsigned char *)malloc(max * item_size))) {
+		delete cb;
+		return fail("out of memory");
+	}
+
+	a.cb = cb;
+	a.item_size = item_size;
+	a.items = STREAM_BYTES / item_size;
+	a.stop = 0;
+	a.bad = 0;
+	if(pthread_create(&t, 0, stream_producer, &a)) {
+		free(buf);
+		delete cb;
+		return fail("pthread_create");
+	}
+
+	while((done < a.items) && !r) {
+		want = 1 + rand_r(&seed) % max;
+		if(rand_r(&seed) & 1) {
+			if((n = cb->read(buf, want)) > want)
+				r = fail("read %u items, asked for %u", n, want);
+			else
+				r = stream_check(buf, done * item_size, n * item_size);
+		} else {
+			p = (unsigned char *)cb->peek(&avail);
+			if(avail > cb->buf_len()) {
+				r = fail("peek found %u items in a %u item buffer",
+				   avail, cb->buf_len());
+				break;
+			}
+			n = (want < avail)? want : avail;
+			if(!(r = stream_check(p, done * item_size, n * item_size)) &&
+			   (cb->purge(n) != n))
+				r = fail("purge dropped other than %u items", n);
+		}
+		done += n;
+		if(!n)
+			sched_yield();
+	}
+	a.stop = 1;
+	pthread_join(t, 0);
+	if(!r && a.bad)
+		r = fail("the producer was given more than it asked for");
+	if(!r && cb->data_available())
+		r = fail("%u items left over", cb->data_available());
+
+	free(buf);
+	delete cb;
+
+	return r;
+}
+
+
+static int test_cb_spsc_stream_1() {
+
+	return cb_spsc_stream(1);
+}
+
+
+// the items don't divide the mapping, they straddle the wrap
+static int test_cb_spsc_stream_7() {
+
+	return cb_spsc_stream(7);
+}
+
+
+static int test_cb_spsc_stream_8() {
+
+	return cb_spsc_stream(8);
+}
+
+
+/*
+ * The broadcast producer waits for space instead of taking what there is.
+ */
+static void *bcast_producer(void *arg) {
+
+	stream_arg *a = (stream_arg *)arg;
+	circular_buffer *cb = a->cb;
+	unsigned int seed = 3, max = cb->buf_len(), want, space;
+	unsigned long long done = 0;
+	unsigned char *buf, *p;
+
+	if(!(buf = (unsigned char *)malloc(max * a->item_size))) {
+		a->bad = 1;
+		return 0;
+	}
+	while((done < a->items) && !a->stop) {
+		want = 1 + rand_r(&seed) % max;
+		if(want > a->items - done)
+			want = a->items - done;
+		if(cb->wait_space(want) < want) {
+			a->bad = 1;
+			break;
+		}
+		if(rand_r(&seed) & 1) {
+			stream_fill(buf, done * a->item_size, want * a->item_size);
+			if(cb->write(buf, want) != want) {
+				a->bad = 1;
+				break;
+			}
+		} else {
+			p = (unsigned char *)cb->poke(&space);
+			stream_fill(p, done * a->item_size, want * a->item_size);
+			cb->wrote(want);
+		}
+		done += want;
+	}
+	free(buf);
+
+	return 0;
+}
+
+
+struct reader_arg {
+	circular_buffer		*cb;
+	int			reader;
+	unsigned int		item_size;
+	unsigned long long	items;
+	volatile int		stop;
+	int			r;
+	char			why[sizeof(g_why)];
+};
+
+
+/*
+ * An attached reader, slower than the others so the producer waits on it.
+ */
+static void *bcast_reader(void *arg) {
+
+	reader_arg *a = (reader_arg *)arg;
+	unsigned int seed = 4, want, n, avail;
+	unsigned long long done = 0;
+	unsigned char *p;
+
+	a->r = 0;
+	while((done < a->items) && !a->r && !a->stop) {
+		want = 1 + rand_r(&seed) % a->cb->buf_len();
+		p = (unsigned char *)a->cb->peek(a->reader, &avail);
+		if(avail > a->cb->buf_len()) {
+			a->r = fail("reader found %u items in a %u item buffer",
+			   avail, a->cb->buf_len());
+			break;
+		}
+		n = (want < avail)? want : avail;
+		if(!(a->r = stream_check(p, done * a->item_size, n * a->item_size)) &&
+		   (a->cb->purge(a->reader, n) != n))
+			a->r = fail("reader purge dropped other than %u items", n);
+		done += n;
+		if(!(rand_r(&seed) % 16))
+			usleep(100);
+		else if(!n)
+			sched_yield();
+	}
+	// the others mustn't wait on a reader that gave up
+	if(a->r) {
+		memcpy(a->why, g_why, sizeof(a->why));
+		a->cb->remove_reader(a->reader);
+	}
+
+	return 0;
+}
+
+
+/*
+ * The plain reader on this thread and an attached one both see the whole
+ * stream, with the producer held back by the slower.
+ */
+static int cb_bcast_stream(unsigned int item_size) {
+
+	circular_buffer *cb;
+	stream_arg a;
+	reader_arg ra;
+	pthread_t t, tr;
+	unsigned int seed = 5, max, want, n, avail;
+	unsigned long long done = 0;
+	unsigned char *buf, *p;
+	int r = 0;
+
+	cb = new circular_buffer(1000, item_size);
+	max = cb->buf_len();
+	if(!(buf = (unsigned char *)malloc(max * item_size))) {
+		delete cb;
+		return fail("out of memory");
+	}
+
+	a.cb = ra.cb = cb;
+	a.item_size = ra.item_size = item_size;
+	a.items = ra.items = (STREAM_BYTES / 8) / item_size;
+	a.stop = ra.stop = 0;
+	a.bad = 0;
+	if((ra.reader = cb->add_reader()) < 0) {
+		free(buf);
+		delete cb;
+		return fail("add_reader");
+	}
+	if(pthread_create(&tr, 0, bcast_reader, &ra)) {
+		free(buf);
+		delete cb;
+		return fail("pthread_create");
+	}
+	if(pthread_create(&t, 0, bcast_producer, &a)) {
+		pthread_join(tr, 0);
+		free(buf);
+		delete cb;
+		return fail("pthread_create");
+	}
+
+	while((done < a.items) && !r) {
+		want = 1 + rand_r(&seed) % max;
+		if(rand_r(&seed) & 1) {
+			n = cb->read(buf, want);
+			r = stream_check(buf, done * item_size, n * item_size);
+		} else {
+			p = (unsigned char *)cb->peek(&avail);
+			n = (want < avail)? want : avail;
+			if(!(r = stream_check(p, done * item_size, n * item_size)))
+				cb->purge(n);
+		}
+		done += n;
+		if(!n)
+			sched_yield();
+	}
+
+	// on a failure here the producer may be waiting on us, let it go
+	if(r) {
+		a.stop = ra.stop = 1;
+		cb->remove_reader(ra.reader);
+		cb->flush();
+	}
+	pthread_join(tr, 0);
+	if(!r && ra.r) {
+		memcpy(g_why, ra.why, sizeof(g_why));
+		r = -1;
+	}
+	cb->remove_reader(ra.reader);
+	a.stop = 1;
+	pthread_join(t, 0);
+	if(!r && a.bad)
+		r = fail("the producer got less space than it waited for");
+
+	free(buf);
+	delete cb;
+
+	return r;
+}
+
+
+static int test_cb_bcast_stream_1() {
+
+	return cb_bcast_stream(1);
+}
+
+
+static int test_cb_bcast_stream_8() {
+
+	return cb_bcast_stream(8);
+}
+
+
+/*
+ * With overwrite the producer never waits, a reader that doesn't keep up
+ * loses the oldest items and is told how many.
+ */
+static int test_cb_bcast_overwrite() {
+
+	circular_buffer *cb;
+	unsigned char buf[100], *p;
+	unsigned int i, k, len, n;
+	int reader, r = 0;
+
+	cb = new circular_buffer(1000, 1, 1);
+	n = cb->buf_len();
+	reader = cb->add_reader();
+	for(i = 0; i < 3 * n; i += k) {
+		k = (3 * n - i < sizeof(buf))? 3 * n - i : sizeof(buf);
+		stream_fill(buf, i, k);
+		if(cb->write(buf, k) != k) {
+			r = fail("write was cut short");
+			break;
+		}
+		cb->purge(k);
+	}
+	if(!r && (cb->overruns(reader) != 2 * n))
+		r = fail("%llu overruns, expected %u", cb->overruns(reader), 2 * n);
+	if(!r && (cb->space_available() != 0))
+		r = fail("%u items of space past the reader", cb->space_available());
+	if(!r) {
+		p = (unsigned char *)cb->peek(reader, &len);
+		if(len != n)
+			r = fail("reader has %u items, expected %u", len, n);
+		else
+			r = stream_check(p, 2 * n, n);
+	}
+	if(!r) {
+		cb->purge(reader, n);
+		if(cb->space_available() != n)
+			r = fail("%u items of space once read, expected %u",
+			   cb->space_available(), n);
+	}
+	cb->remove_reader(reader);
+	delete cb;
+
+	return r;
+}
+
+
+/*
+ * Fixed pseudo-random data, the same on every libc.
+ */
+static unsigned int g_seed;
+
+
+static double uniform() {
+
+	g_seed = g_seed * 1103515245 + 12345;
+	return ((g_seed >> 8) & 0xffffff) / 16777216.0;
+}
+
+
+static int cmp_float(const void *a, const void *b) {
+
+	float x = *(const float *)a, y = *(const float *)b;
+
+	return (x < y)? -1 : (x > y)? 1 : 0;
+}
+
+
+static int close_to(double x, double want, double tol) {
+
+	return fabs(x - want) <= tol * (1.0 + fabs(want));
+}
+
+
+/*
+ * Welford's update against the two pass mean and variance, on data with a
+ * large offset that a sum of squares would lose.
+ */
+static int test_stats_running() {
+
+	static const unsigned int LENS[] = { 1, 2, 1000 };
+	static const double OFFSET = 1e8;
+
+	double x[1000], m, v, min, max;
+	unsigned int i, k, n;
+	running_stats s;
+
+	g_seed = 1;
+	for(k = 0; k < sizeof(LENS) / sizeof(LENS[0]); k++) {
+		n = LENS[k];
+		s.reset();
+		m = 0.0;
+		for(i = 0; i < n; i++) {
+			x[i] = OFFSET + uniform();
+			s.add(x[i]);
+			m += x[i];
+		}
+		m /= n;
+		v = 0.0;
+		min = max = x[0];
+		for(i = 0; i < n; i++) {
+			v += (x[i] - m) * (x[i] - m);
+			if(x[i] < min)
+				min = x[i];
+			if(x[i] > max)
+				max = x[i];
+		}
+
+		if(s.count() != n)
+			return fail("n=%u: count %lu", n, s.count());
+		if(!close_to(s.mean(), m, 1e-12))
+			return fail("n=%u: mean %.9f, expected %.9f", n, s.mean(), m);
+		if(!close_to(s.pvariance(), v / n, 1e-6))
+			return fail("n=%u: pvariance %g, expected %g", n, s.pvariance(), v / n);
+		if(!close_to(s.variance(), (n > 1)? v / (n - 1) : 0.0, 1e-6))
+			return fail("n=%u: variance %g, expected %g", n, s.variance(),
+			   (n > 1)? v / (n - 1) : 0.0);
+		if((s.min() != min) || (s.max() != max))
+			return fail("n=%u: range %.9f..%.9f, expected %.9f..%.9f", n,
+			   s.min(), s.max(), min, max);
+	}
+
+	return 0;
+}
+
+
+/*
+ * Up to four samples the quantile is the nearest rank, after that the
+ * P-square estimate has to stay near the sorted data's.
+ */
+static int test_stats_p2_quantile() {
+
+	static const double P[] = { 0.1, 0.5, 0.9 };
+	static const unsigned int N = 10000;
+
+	float *x = new float[N], *y = new float[N];
+	unsigned int i, k, n;
+	double want;
+	int r = 0;
+
+	g_seed = 2;
+	for(i = 0; i < N; i++)
+		x[i] = uniform();
+
+	for(k = 0; !r && (k < sizeof(P) / sizeof(P[0])); k++) {
+		for(n = 1; !r && (n < 5); n++) {
+			p2_quantile q(P[k]);
+			for(i = 0; i < n; i++)
+				q.add(x[i]);
+			memcpy(y, x, n * sizeof(float));
+			qsort(y, n, sizeof(float), cmp_float);
+			want = y[(int)(P[k] * (n - 1) + 0.5)];
+			if(q.value() != want)
+				r = fail("p=%.1f n=%u: %f, expected %f", P[k], n, q.value(), want);
+		}
+
+		p2_quantile q(P[k]);
+		for(i = 0; i < N; i++)
+			q.add(x[i]);
+		memcpy(y, x, N * sizeof(float));
+		qsort(y, N, sizeof(float), cmp_float);
+		want = y[(unsigned int)(P[k] * (N - 1))];
+		if(!r && (fabs(q.value() - want) > 0.01))
+			r = fail("p=%.1f n=%u: %f, expected %f", P[k], N, q.value(), want);
+	}
+	delete[] x;
+	delete[] y;
+
+	return r;
+}
+
+
+/*
+ * Trimmed mean, spread and trim points straight from the sorted data.
+ */
+static void trimmed(const float *x, unsigned int n, double trim, double *mean,
+   double *std, double *lo, double *hi) {
+
+	float *y = new float[n];
+	unsigned int i, t;
+	double m = 0.0, v = 0.0;
+
+	memcpy(y, x, n * sizeof(float));
+	qsort(y, n, sizeof(float), cmp_float);
+	t = (unsigned int)(n * trim + 1e-9);
+	if(2 * t >= n)
+		t = (n - 1) / 2;
+	for(i = t; i < n - t; i++)
+		m += y[i];
+	m /= n - 2 * t;
+	for(i = t; i < n - t; i++)
+		v += (y[i] - m) * (y[i] - m);
+	*mean = m;
+	*std = sqrt(v / (n - 2 * t));
+	*lo = y[t];
+	*hi = y[n - t - 1];
+	delete[] y;
+}
+
+
+/*
+ * Normal-ish data with every twentieth sample an outlier far above, which
+ * the trim has to take out.
+ */
+static void outlier_data(float *x, unsigned int n) {
+
+	unsigned int i;
+
+	for(i = 0; i < n; i++) {
+		if(i % 20 == 7)
+			x[i] = 1000.0;
+		else
+			x[i] = uniform() + uniform() + uniform() - 1.5;
+	}
+}
+
+
+/*
+ * Up to EXACT samples the trim is exact, compare it at 1, a few and EXACT.
+ */
+static int test_stats_robust_exact() {
+
+	static const unsigned int LENS[] = { 1, 2, 3, 10, 127, robust_stats::EXACT };
+
+	float x[robust_stats::EXACT];
+	double mean, std, lo, hi;
+	unsigned int i, k, n;
+
+	g_seed = 3;
+	outlier_data(x, robust_stats::EXACT);
+	for(k = 0; k < sizeof(LENS) / sizeof(LENS[0]); k++) {
+		n = LENS[k];
+		robust_stats s(0.1);
+		for(i = 0; i < n; i++)
+			s.add(x[i]);
+		trimmed(x, n, 0.1, &mean, &std, &lo, &hi);
+
+		if(s.count() != n)
+			return fail("n=%u: count %lu", n, s.count());
+		if(!close_to(s.trimmed_mean(), mean, 1e-6))
+			return fail("n=%u: trimmed mean %f, expected %f", n, s.trimmed_mean(), mean);
+		if(!close_to(s.trimmed_stddev(), std, 1e-5))
+			return fail("n=%u: trimmed stddev %f, expected %f", n, s.trimmed_stddev(), std);
+		if((s.lo() != lo) || (s.hi() != hi))
+			return fail("n=%u: trim points %f..%f, expected %f..%f", n,
+			   s.lo(), s.hi(), lo, hi);
+		if((n == 1) && (s.std_error() != 0.0))
+			return fail("n=1: std error %f", s.std_error());
+		if((n > 1) && !(s.std_error() > 0.0))
+			return fail("n=%u: std error %f", n, s.std_error());
+	}
+
+	return 0;
+}
+
+
+/*
+ * An estimated quantile is within five ranks, or 3% of them, of the exact
+ * one.
+ */
+static int near_rank(const float *x, unsigned int n, double est, double want) {
+
+	unsigned int i, a = 0, b = 0, tol = (3 * n / 100 > 5)? 3 * n / 100 : 5;
+
+	for(i = 0; i < n; i++) {
+		a += (x[i] < est);
+		b += (x[i] < want);
+	}
+	return (a > b)? a - b <= tol : b - a <= tol;
+}
+
+
+/*
+ * Past EXACT samples the trim points are estimates, the trimmed mean must
+ * still be close to the exact one and shrug off the outliers, from the
+ * first streamed sample on.
+ */
+static int test_stats_robust_streaming() {
+
+	static const unsigned int LENS[] = { robust_stats::EXACT + 1, 1000, 100000 };
+	static const unsigned int N = 100000;
+
+	float *x = new float[N];
+	double mean, std, lo, hi, se = 0.0;
+	unsigned int i, k, n;
+	int r = 0;
+
+	g_seed = 4;
+	outlier_data(x, N);
+	for(k = 0; !r && (k < sizeof(LENS) / sizeof(LENS[0])); k++) {
+		n = LENS[k];
+		robust_stats s(0.1);
+		for(i = 0; i < n; i++)
+			s.add(x[i]);
+		trimmed(x, n, 0.1, &mean, &std, &lo, &hi);
+
+		if(s.count() != n)
+			r = fail("n=%u: count %lu", n, s.count());
+		else if(fabs(s.trimmed_mean() - mean) > 0.1 * std)
+			r = fail("n=%u: trimmed mean %f, expected %f", n, s.trimmed_mean(), mean);
+		else if(fabs(s.trimmed_stddev() - std) > 0.1 * std)
+			r = fail("n=%u: trimmed stddev %f, expected %f", n, s.trimmed_stddev(), std);
+		else if(!near_rank(x, n, s.lo(), lo) || !near_rank(x, n, s.hi(), hi))
+			r = fail("n=%u: trim points %f..%f, expected %f..%f", n,
+			   s.lo(), s.hi(), lo, hi);
+		else if(!(s.std_error() > 0.0) || (se && (s.std_error() >= se)))
+			r = fail("n=%u: std error %f", n, s.std_error());
+		se = s.std_error();
+	}
+	delete[] x;
+
+	return r;
+}
+
+
+/*
+ * select_kth() against the sorted data, for every k of short arrays and some
+ * of long ones, with and without repeated values; low_mean() with it.
+ */
+static int test_stats_select_kth() {
+
+	static const unsigned int LENS[] = { 1, 2, 3, 10, robust_stats::EXACT, 1000 };
+
+	float x[1000], y[1000], b[1000], v;
+	unsigned int i, k, n, l, dup, step;
+	double m;
+
+	g_seed = 5;
+	for(dup = 0; dup < 2; dup++) {
+		for(l = 0; l < sizeof(LENS) / sizeof(LENS[0]); l++) {
+			n = LENS[l];
+			for(i = 0; i < n; i++)
+				x[i] = dup? (float)(int)(8 * uniform()) : uniform();
+			memcpy(y, x, n * sizeof(float));
+			qsort(y, n, sizeof(float), cmp_float);
+
+			step = (n > 200)? 37 : 1;
+			for(k = 0; k < n; k += step) {
+				memcpy(b, x, n * sizeof(float));
+				v = select_kth(b, n, k);
+				if(v != y[k])
+					return fail("n=%u k=%u: %f, expected %f", n, k, v, y[k]);
+				for(i = 0; i < n; i++) {
+					if((i < k)? (b[i] > v) : (b[i] < v))
+						return fail("n=%u k=%u: b[%u] = %f on the wrong side",
+						   n, k, i, b[i]);
+				}
+
+				memcpy(b, x, n * sizeof(float));
+				m = 0.0;
+				for(i = 0; i < k + 1; i++)
+					m += y[i];
+				m /= k + 1;
+				if(!close_to(low_mean(b, n, k + 1), m, 1e-6))
+					return fail("n=%u: low mean of %u %f, expected %f", n,
+					   k + 1, low_mean(b, n, k + 1), m);
+			}
+			if(low_mean(b, n, 0) != 0.0)
+				return fail("n=%u: low mean of none", n);
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * The band plan replaced a chain of ifs.  This is that chain, less its
+ * error messages, to hold the table to.
+ */
+static double old_arfcn_to_freq(int n, int *bi) {
+
+	if((128 <= n) && (n <= 251)) {
+		if(bi)
+			*bi = GSM_850;
+		return 824.2e6 + 0.2e6 * (n - 128) + 45.0e6;
+	}
+
+	if((1 <= n) && (n <= 124)) {
+		if(bi && (*bi != GSM_E_900))
+			*bi = GSM_900;
+		return 890.0e6 + 0.2e6 * n + 45.0e6;
+	}
+
+	if(n == 0) {
+		if(bi)
+			*bi = GSM_E_900;
+		return 935e6;
+	}
+	if((955 <= n) && (n <= 1023)) {
+		if(bi) {
+			if (975 <= n)
+				*bi = GSM_E_900;
+			else
+				*bi = GSM_R_900;
+		}
+		return 890.0e6 + 0.2e6 * (n - 1024) + 45.0e6;
+	}
+
+	if((512 <= n) && (n <= 810)) {
+		if(!bi)
+			return -1.0;
+		if(*bi == DCS_1800)
+			return 1710.2e6 + 0.2e6 * (n - 512) + 95.0e6;
+		if(*bi == PCS_1900)
+			return 1850.2e6 + 0.2e6 * (n - 512) + 80.0e6;
+		return -1.0;
+	}
+
+	if((811 <= n) && (n <= 885)) {
+		if(bi)
+			*bi = DCS_1800;
+		return 1710.2e6 + 0.2e6 * (n - 512) + 95.0e6;
+	}
+
+	return -1.0;
+}
+
+
+static int old_freq_to_arfcn(double freq, int *bi) {
+
+	if((869.2e6 <= freq) && (freq <= 893.8e6)) {
+		if(bi)
+			*bi = GSM_850;
+		return (int)((freq - 869.2e6) / 0.2e6) + 128;
+	}
+
+	if((921.2e6 <= freq) && (freq <= 925.0e6)) {
+		if(bi)
+			*bi = GSM_R_900;
+		return (int)((freq - 935e6) / 0.2e6) + 1024;
+	}
+
+	if((935.2e6 <= freq) && (freq <= 959.8e6)) {
+		if(bi)
+			*bi = GSM_900;
+		return (int)((freq - 935e6) / 0.2e6);
+	}
+
+	if(935.0e6 == freq) {
+		if(bi)
+			*bi = GSM_E_900;
+		return 0;
+	}
+	if((925.2e6 <= freq) && (freq <= 934.8e6)) {
+		if(bi)
+			*bi = GSM_E_900;
+		return (int)((freq - 935e6) / 0.2e6) + 1024;
+	}
+
+	if((1805.2e6 <= freq) && (freq <= 1879.8e6)) {
+		if(bi)
+			*bi = DCS_1800;
+		return (int)((freq - 1805.2e6) / 0.2e6) + 512;
+	}
+
+	if((1930.2e6 <= freq) && (freq <= 1989.8e6)) {
+		if(bi)
+			*bi = PCS_1900;
+		return (int)((freq - 1930.2e6) / 0.2e6) + 512;
+	}
+
+	return -1;
+}
+
+
+static const int BANDS[] = {
+	GSM_850, GSM_R_900, GSM_900, GSM_E_900, DCS_1800, PCS_1900
+};
+static const int NBANDS = sizeof(BANDS) / sizeof(BANDS[0]);
+
+// channels of each band, in the order above
+static const int BAND_CHANS[] = { 124, 20, 124, 174, 374, 299 };
+
+static int g_stderr = -1;
+
+
+/*
+ * Bad channels and frequencies are reported on stderr, which a test that
+ * tries them on purpose doesn't want to see.
+ */
+static void quiet(int on) {
+
+	int fd;
+
+	fflush(stderr);
+	if(on && (g_stderr < 0)) {
+		g_stderr = dup(2);
+		if((fd = open("/dev/null", O_WRONLY)) >= 0) {
+			dup2(fd, 2);
+			close(fd);
+		}
+	} else if(!on && (g_stderr >= 0)) {
+		dup2(g_stderr, 2);
+		close(g_stderr);
+		g_stderr = -1;
+	}
+}
+
+
+/*
+ * Every ARFCN of every band maps to the frequency and band it used to, with
+ * and without a band to go by, and back.
+ */
+static int arfcn_bands() {
+
+	int b, c, n, bi, old_bi, bi2, a;
+	double f, old_f;
+
+	for(b = 0; b < NBANDS; b++) {
+		n = 0;
+		for(c = first_chan(BANDS[b]); c >= 0; c = next_chan(c, BANDS[b])) {
+			n++;
+			bi = old_bi = BANDS[b];
+			f = arfcn_to_freq(c, &bi);
+			old_f = old_arfcn_to_freq(c, &old_bi);
+			if((f != old_f) || (bi != old_bi))
+				return fail("%s arfcn %d: %.1f (%s), expected %.1f (%s)",
+				   bi_to_str(BANDS[b]), c, f, bi_to_str(bi), old_f,
+				   bi_to_str(old_bi));
+			if(f <= 0.0)
+				return fail("%s arfcn %d has no frequency",
+				   bi_to_str(BANDS[b]), c);
+
+			f = arfcn_to_freq(c);
+			old_f = old_arfcn_to_freq(c, 0);
+			if(f != old_f)
+				return fail("arfcn %d without a band: %.1f, expected %.1f",
+				   c, f, old_f);
+
+			f = arfcn_to_freq(c, &bi);
+			if((a = freq_to_arfcn(f, &bi2)) != c)
+				return fail("%s arfcn %d: %.1f comes back as %d",
+				   bi_to_str(BANDS[b]), c, f, a);
+			if(a != old_freq_to_arfcn(f, &old_bi) || (bi2 != old_bi))
+				return fail("%.1f: %d (%s), expected %d (%s)", f, a,
+				   bi_to_str(bi2), old_freq_to_arfcn(f, 0),
+				   bi_to_str(old_bi));
+		}
+		if(n != BAND_CHANS[b])
+			return fail("%s has %d channels, expected %d",
+			   bi_to_str(BANDS[b]), n, BAND_CHANS[b]);
+	}
+
+	return 0;
+}
+
+
+static int test_arfcn_bands() {
+
+	int r;
+
+	quiet(1);
+	r = arfcn_bands();
+	quiet(0);
+	return r;
+}
+
+
+/*
+ * Off the band plan: ARFCNs outside every band, and frequencies on and
+ * off the channel grid from 800MHz to 2GHz, give what they used to.
+ */
+static int arfcn_off_plan() {
+
+	int c, a, old_a, bi, old_bi;
+	double f, old_f;
+	long k;
+
+	for(c = -2; c < 1100; c++) {
+		f = arfcn_to_freq(c);
+		old_f = old_arfcn_to_freq(c, 0);
+		if((f != old_f) && ((f > 0.0) || (old_f > 0.0)))
+			return fail("arfcn %d: %.1f, expected %.1f", c, f, old_f);
+	}
+	for(k = 8000; k <= 20000; k++) {
+		f = k * 0.1e6;
+		bi = old_bi = BI_NOT_DEFINED;
+		a = freq_to_arfcn(f, &bi);
+		old_a = old_freq_to_arfcn(f, &old_bi);
+		if((a != old_a) || ((a >= 0) && (bi != old_bi)))
+			return fail("%.1f: %d (%s), expected %d (%s)", f, a,
+			   bi_to_str(bi), old_a, bi_to_str(old_bi));
+	}
+
+	return 0;
+}
+
+
+static int test_arfcn_off_plan() {
+
+	int r;
+
+	quiet(1);
+	r = arfcn_off_plan();
+	quiet(0);
+	return r;
+}
+
+
+/*
+ * A sweep is in frequency order and has every frequency once, for the band
+ * listed first.
+ */
+static int test_arfcn_sweep() {
+
+	static const int NINE[] = { GSM_900, GSM_E_900 };
+	static const int ENINE[] = { GSM_E_900, GSM_900 };
+	static const int MAX = 2048;
+
+	sweep_chan *plan = new sweep_chan[MAX];
+	int b, i, k, n, want = 0, r = 0;
+
+	n = plan_sweep(BANDS, NBANDS, plan, MAX);
+	for(b = 0; b < NBANDS; b++)
+		want += BAND_CHANS[b];
+	want -= BAND_CHANS[2];	// GSM-900 lies within E-GSM-900
+	if(n != want)
+		r = fail("all bands: %d channels, expected %d", n, want);
+	for(i = 1; !r && (i < n); i++) {
+		if(plan[i].freq <= plan[i - 1].freq)
+			r = fail("all bands: %.1f after %.1f", plan[i].freq, plan[i - 1].freq);
+	}
+
+	for(k = 0; !r && (k < 2); k++) {
+		n = plan_sweep(k? ENINE : NINE, 2, plan, MAX);
+		if(n != BAND_CHANS[3]) {
+			r = fail("%s first: %d channels, expected %d",
+			   bi_to_str(k? GSM_E_900 : GSM_900), n, BAND_CHANS[3]);
+			break;
+		}
+		for(i = 0; i < n; i++) {
+			if((i && (plan[i].freq <= plan[i - 1].freq)) ||
+			   (plan[i].freq != arfcn_to_freq(plan[i].arfcn, &plan[i].bi))) {
+				r = fail("%s first: arfcn %d at %.1f", bi_to_str(k? GSM_E_900 : GSM_900),
+				   plan[i].arfcn, plan[i].freq);
+				break;
+			}
+			b = ((plan[i].arfcn >= 1) && (plan[i].arfcn <= 124))?
+			   (k? GSM_E_900 : GSM_900) : GSM_E_900;
+			if(plan[i].bi != b) {
+				r = fail("%s first: arfcn %d is %s", bi_to_str(k? GSM_E_900 : GSM_900),
+				   plan[i].arfcn, bi_to_str(plan[i].bi));
+				break;
+			}
+		}
+	}
+
+	if(!r && ((n = plan_sweep(BANDS, NBANDS, plan, 10)) != 10))
+		r = fail("%d channels planned into 10", n);
+	for(i = 1; !r && (i < n); i++) {
+		if(plan[i].freq <= plan[i - 1].freq)
+			r = fail("a short plan isn't in order");
+	}
+	delete[] plan;
+
+	return r;
+}
+
+
+static int test_arfcn_str_to_bands() {
+
+	char all[] = "all", two[] = "GSM900,DCS", bad[] = "GSM900,FOO";
+	int bands[NBANDS + 1], n, i;
+
+	if((n = str_to_bands(all, bands, NBANDS + 1)) != NBANDS)
+		return fail("all: %d bands, expected %d", n, NBANDS);
+	for(i = 0; i < n; i++) {
+		if(bands[i] != BANDS[i])
+			return fail("all: band %d is %s", i, bi_to_str(bands[i]));
+	}
+	strcpy(all, "all");
+	if((n = str_to_bands(all, bands, 2)) != 2)
+		return fail("all into 2: %d bands", n);
+	if((n = str_to_bands(two, bands, NBANDS)) != 2)
+		return fail("GSM900,DCS: %d bands", n);
+	if((bands[0] != GSM_900) || (bands[1] != DCS_1800))
+		return fail("GSM900,DCS: %s,%s", bi_to_str(bands[0]), bi_to_str(bands[1]));
+	quiet(1);
+	n = str_to_bands(bad, bands, NBANDS);
+	quiet(0);
+	if(n != -1)
+		return fail("GSM900,FOO: %d bands", n);
+
+	return 0;
+}
+
+
+/*
+ * A recording made by iq_recorder and played back by file_source.  Each
+ * frequency's settled samples count up, in I, from 0; Q says which
+ * frequency they belong to.  Samples taken before the tuner settled are
+ * marked with Q = -1 and must never come back.
+ */
+static const double REC_RATE = 1625000.0 / 6.0;
+static const double REC_A = 947.0e6;
+static const double REC_B = 947.2e6;
+static const unsigned int REC_BLOCK = 1000;
+
+// samples of B, enough for it to take two chunks
+static const unsigned int REC_B_LEN = 300 * REC_BLOCK;
+
+struct rec_chunk {
+	double		freq;
+	unsigned long	count,
+			skip;
+};
+
+static int g_refuse_direct, g_refused;
+
+
+#ifdef O_DIRECT
+/*
+ * Stands in for libc's write() in this program.  With g_refuse_direct set, a
+ * write to a file opened O_DIRECT fails with EINVAL, as it does on
+ * filesystems that only refuse O_DIRECT when written to.
+ */
+extern "C" ssize_t write(int fd, const void *buf, size_t len) {
+
+	if(g_refuse_direct && (fcntl(fd, F_GETFL) & O_DIRECT)) {
+		g_refused++;
+		errno = EINVAL;
+		return -1;
+	}
+	return syscall(SYS_write, fd, buf, len);
+}
+#endif /* O_DIRECT */
+
+
+static int rec_block(iq_recorder *r, double freq, int tag, unsigned int skip,
+   unsigned int *k) {
+
+	short *s;
+	unsigned int i;
+
+	r->set_meta(freq, REC_RATE, 10.0);
+	if(!(s = (short *)r->poke(REC_BLOCK)))
+		return fail("%.1fMHz: no space to record", freq / 1e6);
+	for(i = 0; i < REC_BLOCK; i++) {
+		if(i < skip) {
+			s[2 * i] = 0x7fff;
+			s[2 * i + 1] = -1;
+		} else {
+			s[2 * i] = (*k)++ % 30000;
+			s[2 * i + 1] = tag;
+		}
+	}
+	r->wrote(REC_BLOCK, skip);
+
+	return 0;
+}
+
+
+/*
+ * A before and after B, with unsettled samples after each tune, and B long
+ * enough to go on in a second chunk.  Returns the chunks expected.
+ */
+static int record(const char *path, rec_chunk *want, unsigned int *nwant) {
+
+	iq_recorder r(path, file_source::FMT_CS16, 2 * sizeof(short), "test");
+	unsigned int a = 0, b = 0, i, per;
+
+	if(r.open())
+		return fail("%s: can't record", path);
+
+	for(i = 0; i < 5; i++) {
+		if(rec_block(&r, REC_A, 1, i? 0 : 100, &a))
+			return -1;
+	}
+	// unsettled right through the first block
+	if(rec_block(&r, REC_B, 2, REC_BLOCK, &b) || rec_block(&r, REC_B, 2, 200, &b))
+		return -1;
+	for(i = 2 * REC_BLOCK; i < REC_B_LEN; i += REC_BLOCK) {
+		if(rec_block(&r, REC_B, 2, 0, &b))
+			return -1;
+	}
+	for(i = 0; i < 2; i++) {
+		if(rec_block(&r, REC_A, 1, i? 0 : 50, &a))
+			return -1;
+	}
+	r.close();
+	if(r.dropped())
+		return fail("%llu samples dropped", r.dropped());
+
+	per = (iq_recorder::CHUNK_LEN - iq_recorder::HDR_LEN) /
+	   (REC_BLOCK * 2 * sizeof(short)) * REC_BLOCK;
+	const rec_chunk chunks[] = {
+		{ REC_A, 5 * REC_BLOCK,		100 },
+		{ REC_B, per,			REC_BLOCK + 200 },
+		{ REC_B, REC_B_LEN - per,	0 },
+		{ REC_A, 2 * REC_BLOCK,		50 }
+	};
+	memcpy(want, chunks, sizeof(chunks));
+	*nwant = sizeof(chunks) / sizeof(chunks[0]);
+
+	return 0;
+}
+
+
+static int check_chunks(const char *path, const rec_chunk *want,
+   unsigned int nwant) {
+
+	kal_chunk h;
+	struct stat st;
+	unsigned long long off = 0;
+	unsigned int n;
+	double last = 0.0;
+	int fd, r = 0;
+
+	if((fd = open(path, O_RDONLY)) < 0)
+		return fail("%s: %s", path, strerror(errno));
+	for(n = 0; !r && (n < nwant); n++) {
+		if(pread(fd, &h, sizeof(h), off) != (ssize_t)sizeof(h))
+			r = fail("chunk %u: short", n);
+		else if(memcmp(h.magic, KAL_MAGIC, sizeof(h.magic)) ||
+		   (h.hdr_len != iq_recorder::HDR_LEN) ||
+		   (h.fmt != file_source::FMT_CS16))
+			r = fail("chunk %u: bad header", n);
+		else if((h.len % iq_recorder::ALIGN) ||
+		   (h.len < h.hdr_len + h.count * 2 * sizeof(short)) ||
+		   (h.len > iq_recorder::CHUNK_LEN))
+			r = fail("chunk %u: length %llu for %llu samples", n,
+			   (unsigned long long)h.len, (unsigned long long)h.count);
+		else if((h.freq != want[n].freq) || (h.count != want[n].count) ||
+		   (h.skip != want[n].skip))
+			r = fail("chunk %u: %.1fMHz, %llu samples, %llu skipped; "
+			   "expected %.1fMHz, %lu, %lu", n, h.freq / 1e6,
+			   (unsigned long long)h.count, (unsigned long long)h.skip,
+			   want[n].freq / 1e6, want[n].count, want[n].skip);
+		else if((h.rate != REC_RATE) || (h.gain != 10.0) || h.dropped ||
+		   strcmp(h.device, "test"))
+			r = fail("chunk %u: bad rate, gain, dropped or device", n);
+		else if((h.time < last) || (h.time <= 0.0))
+			r = fail("chunk %u: time %f after %f", n, h.time, last);
+		last = h.time;
+		off += h.len;
+	}
+	if(!r && (fstat(fd, &st) || ((unsigned long long)st.st_size != off)))
+		r = fail("%llu bytes after %u chunks", (unsigned long long)st.st_size -
+		   off, nwant);
+	close(fd);
+
+	return r;
+}
+
+
+/*
+ * Everything settled that was recorded at freq, in order across its chunks,
+ * then silence and fill() saying the recording has ended.
+ */
+static int replay(file_source *s, double freq, int tag, unsigned int want) {
+
+	circular_buffer *cb;
+	const complex *c;
+	unsigned int got = 0, i, n;
+	int end = 0;
+
+	s->tune(freq);
+	cb = s->get_buffer();
+	while(!end) {
+		end = s->fill(8192, 0);
+		c = (const complex *)cb->peek(&n);
+		for(i = 0; i < n; i++, got++) {
+			if(got < want) {
+				if((c[i].real() != got % 30000) || (c[i].imag() != tag))
+					return fail("%.1fMHz: sample %u is (%g, %g)",
+					   freq / 1e6, got, c[i].real(), c[i].imag());
+			} else if((c[i].real() != 0.0) || (c[i].imag() != 0.0))
+				return fail("%.1fMHz: sample %u past the end is (%g, %g)",
+				   freq / 1e6, got, c[i].real(), c[i].imag());
+		}
+		cb->purge(n);
+		if(end && (got < want))
+			return fail("%.1fMHz: ended after %u samples of %u",
+			   freq / 1e6, got, want);
+		if(got > want + (16 << 20))
+			return fail("%.1fMHz: didn't end", freq / 1e6);
+	}
+
+	return 0;
+}
+
+
+static int rec_replay(int refuse_direct) {
+
+	char path[PATH_MAX], spec[PATH_MAX + 8];
+	const char *tmp;
+	rec_chunk want[4];
+	unsigned int nwant = 0;
+	file_source *s;
+	int fd, r;
+
+	tmp = getenv("TMPDIR");
+	snprintf(path, sizeof(path), "%s/kal_test.XXXXXX", tmp? tmp : "/tmp");
+	if((fd = mkstemp(path)) < 0)
+		return fail("%s: %s", path, strerror(errno));
+	close(fd);
+#ifdef O_DIRECT
+	// nothing to refuse where O_DIRECT doesn't open at all
+	if(refuse_direct && ((fd = open(path, O_WRONLY | O_DIRECT)) < 0))
+		refuse_direct = 0;
+	else if(refuse_direct)
+		close(fd);
+#else
+	refuse_direct = 0;
+#endif /* O_DIRECT */
+
+	g_refuse_direct = refuse_direct;
+	g_refused = 0;
+	r = record(path, want, &nwant);
+	g_refuse_direct = 0;
+	if(!r && refuse_direct && (g_refused != 1))
+		r = fail("O_DIRECT refused %d times", g_refused);
+	if(!r)
+		r = check_chunks(path, want, nwant);
+
+	if(!r) {
+		snprintf(spec, sizeof(spec), "file:%s", path);
+		s = new file_source(spec);
+		if(s->open(0))
+			r = fail("%s: can't replay", path);
+		else if(s->sample_rate() != (float)REC_RATE)
+			r = fail("rate %f", s->sample_rate());
+		if(!r)
+			r = replay(s, REC_A, 1, 5 * REC_BLOCK - 100 + 2 * REC_BLOCK - 50);
+		if(!r)
+			r = replay(s, REC_B, 2, REC_B_LEN - REC_BLOCK - 200);
+		// where it left off, the end
+		if(!r)
+			r = replay(s, REC_A, 1, 0);
+		delete s;
+	}
+	unlink(path);
+
+	return r;
+}
+
+
+static int test_rec_replay() {
+
+	return rec_replay(0);
+}
+
+
+/*
+ * Recording still works where the file opens O_DIRECT but writes to it are
+ * refused.
+ */
+static int test_rec_replay_direct() {
+
+	return rec_replay(1);
+}
+
+
+static const struct test {
+	const char	*name;
+	int		(*run)();
+} tests[] = {
+	{ "cb_spsc_stream_1",		test_cb_spsc_stream_1 },
+	{ "cb_spsc_stream_7",		test_cb_spsc_stream_7 },
+	{ "cb_spsc_stream_8",		test_cb_spsc_stream_8 },
+	{ "cb_bcast_stream_1",		test_cb_bcast_stream_1 },
+	{ "cb_bcast_stream_8",		test_cb_bcast_stream_8 },
+	{ "cb_bcast_overwrite",		test_cb_bcast_overwrite },
+	{ "stats_running",		test_stats_running },
+	{ "stats_p2_quantile",		test_stats_p2_quantile },
+	{ "stats_robust_exact",		test_stats_robust_exact },
+	{ "stats_robust_streaming",	test_stats_robust_streaming },
+	{ "stats_select_kth",		test_stats_select_kth },
+	{ "arfcn_bands",		test_arfcn_bands },
+	{ "arfcn_off_plan",		test_arfcn_off_plan },
+	{ "arfcn_sweep",		test_arfcn_sweep },
+	{ "arfcn_str_to_bands",		test_arfcn_str_to_bands },
+	{ "rec_replay",			test_rec_replay },
+	{ "rec_replay_direct",		test_rec_replay_direct },
+	{ 0, 0 }
+};
+
+
+static void usage(char *prog) {
+
+	printf("kal_test v%s\n", kal_version_string);
+	printf("\nUsage:\n");
+	printf("\t%s [options] [test ...]\n", prog);
+	printf("\n");
+	printf("Where options are:\n");
+	printf("\t-l\tlist the tests\n");
+	printf("\t-h\thelp\n");
+	exit(-1);
+}
+
+
+int main(int argc, char **argv) {
+
+	int c, i, failed = 0;
+	const test *t;
+
+	while((c = getopt(argc, argv, "lh?")) != EOF) {
+		switch(c) {
+			case 'l':
+				for(t = tests; t->name; t++)
+					printf("%s\n", t->name);
+				return 0;
+
+			case 'h':
+			case '?':
+			default:
+				usage(argv[0]);
+				break;
+		}
+	}
+
+	for(t = tests; t->name; t++) {
+		// only the ones named
+		for(i = optind; i < argc; i++) {
+			if(!strcmp(argv[i], t->name))
+				break;
+		}
+		if((optind < argc) && (i == argc))
+			continue;
+
+		g_why[0] = 0;
+		if(t->run()) {
+			printf("%s\tFAIL\t%s\n", t->name, g_why);
+			failed++;
+		} else
+			printf("%s\tok\n", t->name);
+		fflush(stdout);
+	}
+
+	for(i = optind; i < argc; i++) {
+		for(t = tests; t->name; t++) {
+			if(!strcmp(argv[i], t->name))
+				break;
+		}
+		if(!t->name) {
+			fprintf(stderr, "error: no test ``%s''\n", argv[i]);
+			failed++;
+		}
+	}
+
+	return failed? 1 : 0;
+}
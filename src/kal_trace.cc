@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kal_trace
+ *
+ * Turns a trace recorded with kal -X into Chrome trace format JSON, for
+ * chrome://tracing or ui.perfetto.dev.  Each ring becomes a thread, each
+ * stage a slice with the channel it was on, each point event an instant
+ * with its values.  Times are in microseconds from when tracing started.
+ *
+ * A ring that wrapped has lost the start of its oldest slices, their ends
+ * are dropped.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#else
+#define PACKAGE_VERSION "custom build"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "instr.h"
+#include "version.h"
+
+static void usage(char *prog) {
+
+	printf("kal_trace v%s\n", kal_version_string);
+	printf("\nUsage:\n");
+	printf("\t%s [options] <trace file>\n", prog);
+	printf("\n");
+	printf("Where options are:\n");
+	printf("\t-o\twrite the JSON to this file (default: stdout)\n");
+	printf("\t-h\thelp\n");
+	exit(-1);
+}
+
+
+/*
+ * Names only come from kal, but they are quoted all the same.
+ */
+static void print_string(FILE *out, const char *s, size_t len) {
+
+	size_t i;
+
+	fputc('"', out);
+	for(i = 0; (i < len) && s[i]; i++) {
+		if((s[i] == '"') || (s[i] == '\\'))
+			fputc('\\', out);
+		if((unsigned char)s[i] >= ' ')
+			fputc(s[i], out);
+	}
+	fputc('"', out);
+}
+
+
+static void print_event(FILE *out, const trace_event *e, uint32_t tid,
+   uint64_t start) {
+
+	const char *ph = (e->kind == TRACE_BEGIN)? "B" :
+	   ((e->kind == TRACE_END)? "E" : "i");
+
+	fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":1,\"tid\":%u,"
+	   "\"ts\":%.3f", trace_name(e->id), ph, tid,
+	   (e->ts >= start)? (double)(e->ts - start) / 1e3 : 0.0);
+	if(e->kind == TRACE_POINT)
+		fprintf(out, ",\"s\":\"t\"");
+	if(e->kind == TRACE_END) {
+		fprintf(out, "}");
+		return;
+	}
+
+	fprintf(out, ",\"args\":{");
+	if(e->chan)
+		fprintf(out, "\"freq_mhz\":%.1f", (double)(e->chan - 1) * 100.0 / 1e6);
+	if(e->kind == TRACE_POINT) {
+		fprintf(out, "%s\"v\":[%g,%g,%g]", e->chan? "," : "", e->v[0],
+		   e->v[1], e->v[2]);
+	}
+	fprintf(out, "}}");
+}
+
+
+static int convert(FILE *in, FILE *out) {
+
+	trace_file_hdr fh;
+	trace_ring_hdr rh;
+	trace_event e;
+	unsigned int depth;
+	uint32_t i;
+	uint64_t j;
+
+	if((fread(&fh, sizeof(fh), 1, in) != 1) ||
+	   memcmp(fh.magic, TRACE_MAGIC, sizeof(fh.magic))) {
+		fprintf(stderr, "error: not a kal trace\n");
+		return -1;
+	}
+	if(fh.event_len != sizeof(trace_event)) {
+		fprintf(stderr, "error: trace events are %u bytes, expected %u\n",
+		   fh.event_len, (unsigned int)sizeof(trace_event));
+		return -1;
+	}
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+	   "\"args\":{\"name\":\"kal\"}}");
+
+	for(i = 0; i < fh.rings; i++) {
+		if(fread(&rh, sizeof(rh), 1, in) != 1) {
+			fprintf(stderr, "error: trace ends in ring %u\n", i);
+			return -1;
+		}
+		fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		   "\"tid\":%u,\"args\":{\"name\":", rh.id);
+		print_string(out, rh.name, sizeof(rh.name));
+		fprintf(out, "}}");
+		fprintf(out, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\","
+		   "\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}", rh.id,
+		   rh.id);
+		if(rh.written > rh.count) {
+			fprintf(stderr, "warning: %s lost its first %llu events\n",
+			   rh.name, (unsigned long long)(rh.written - rh.count));
+		}
+
+		depth = 0;
+		for(j = 0; j < rh.count; j++) {
+			if(fread(&e, sizeof(e), 1, in) != 1) {
+				fprintf(stderr, "error: trace ends in ring %u\n", i);
+				return -1;
+			}
+			if(e.kind == TRACE_BEGIN)
+				depth++;
+			else if(e.kind == TRACE_END) {
+				if(!depth)
+					continue;
+				depth--;
+			} else if(e.kind != TRACE_POINT)
+				continue;
+			print_event(out, &e, rh.id, fh.start);
+		}
+	}
+	fprintf(out, "\n]}\n");
+
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+
+	int c, r;
+	char *out_path = 0;
+	FILE *in, *out = stdout;
+
+	while((c = getopt(argc, argv, "o:h?")) != EOF) {
+		switch(c) {
+			case 'o':
+				out_path = optarg;
+				break;
+
+			case 'h':
+			case '?':
+			default:
+				usage(argv[0]);
+				break;
+		}
+	}
+	if(optind != argc - 1)
+		usage(argv[0]);
+
+	if(!(in = fopen(argv[optind], "r"))) {
+		perror(argv[optind]);
+		return -1;
+	}
+	if(out_path && !(out = fopen(out_path, "w"))) {
+		perror(out_path);
+		fclose(in);
+		return -1;
+	}
+
+	r = convert(in, out);
+	fclose(in);
+	if((fclose(out) != 0) && !r) {
+		fprintf(stderr, "error: writing the JSON failed\n");
+		r = -1;
+	}
+
+	return r;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "nco.h"
+
+
+nco::nco() {
+
+	m_phase = 0.0;
+	set_freq(0.0, 1.0);
+}
+
+
+/*
+ * freq in Hz at sample_rate.  The phase carries on from where it was.
+ */
+void nco::set_freq(double freq, double sample_rate) {
+
+	unsigned int i;
+
+	m_freq = freq;
+	m_inc = 2 * M_PI * freq / sample_rate;
+	for(i = 0; i < BLOCK; i++)
+		m_tab[i] = std::polar(1.0, m_inc * i);
+}
+
+
+/*
+ * Oscillator values for the next n samples, and step the phase past them.
+ */
+void nco::advance(unsigned int n, float *re, float *im) {
+
+	unsigned int j;
+	complex p, r;
+
+	p = std::polar(1.0, m_phase);
+	for(j = 0; j < n; j++) {
+		r = complex(p.real() * m_tab[j].real() - p.imag() * m_tab[j].imag(),
+		   p.real() * m_tab[j].imag() + p.imag() * m_tab[j].real());
+		re[j] = r.real();
+		im[j] = r.imag();
+	}
+	m_phase = fmod(m_phase + m_inc * n, 2 * M_PI);
+}
+
+
+void nco::mix(const complex *in, complex *out, unsigned int len) {
+
+	unsigned int i, j, n;
+	float re[BLOCK], im[BLOCK], xr, xi;
+	const float *x = (const float *)in;
+	float *y = (float *)out;
+
+	if(m_freq == 0.0) {
+		if(in != out) {
+			for(i = 0; i < len; i++)
+				out[i] = in[i];
+		}
+		return;
+	}
+
+	for(i = 0; i < len; i += n) {
+		n = (len - i < BLOCK)? len - i : BLOCK;
+		advance(n, re, im);
+		for(j = 0; j < n; j++) {
+			xr = x[2 * (i + j)];
+			xi = x[2 * (i + j) + 1];
+			y[2 * (i + j)] = xr * re[j] - xi * im[j];
+			y[2 * (i + j) + 1] = xr * im[j] + xi * re[j];
+		}
+	}
+}
+
+
+/*
+ * Convert unsigned 8-bit I/Q, as the rtl-sdr delivers it, and mix.
+ */
+void nco::mix(const unsigned char *in, complex *out, unsigned int len) {
+
+	unsigned int i, j, n;
+	float re[BLOCK], im[BLOCK], xr, xi;
+	float *y = (float *)out;
+
+	if(m_freq == 0.0) {
+		for(i = 0; i < len; i++)
+			out[i] = complex((in[2 * i] - 127) * 256, (in[2 * i + 1] - 127) * 256);
+		return;
+	}
+
+	for(i = 0; i < len; i += n) {
+		n = (len - i < BLOCK)? len - i : BLOCK;
+		advance(n, re, im);
+		for(j = 0; j < n; j++) {
+			xr = (in[2 * (i + j)] - 127) * 256;
+			xi = (in[2 * (i + j) + 1] - 127) * 256;
+			y[2 * (i + j)] = xr * re[j] - xi * im[j];
+			y[2 * (i + j) + 1] = xr * im[j] + xi * re[j];
+		}
+	}
+}
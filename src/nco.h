@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * nco
+ *
+ * Numerically controlled oscillator for frequency correction.  Mixes a block
+ * of samples by e^(j 2 pi f t), optionally converting them from the
+ * receiver's format on the way.  The phase is carried from one block to the
+ * next and across frequency changes.
+ *
+ * The oscillator is evaluated once per BLOCK samples from a double phase
+ * accumulator and rotated through a precomputed table in between, so the
+ * inner loops are straight float arithmetic the compiler can vectorize and
+ * the phase doesn't drift.
+ */
+
+#pragma once
+
+#include "usrp_complex.h"
+
+class nco {
+public:
+	nco();
+
+	void set_freq(double freq, double sample_rate);
+	double freq() { return m_freq; };
+
+	void mix(const complex *in, complex *out, unsigned int len);
+	void mix(const unsigned char *in, complex *out, unsigned int len);
+
+private:
+	void advance(unsigned int n, float *re, float *im);
+
+	static const unsigned int	BLOCK = 16;
+
+	double		m_freq,
+			m_inc,
+			m_phase;
+	complex		m_tab[BLOCK];
+};
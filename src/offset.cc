@@ -25,12 +25,16 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifdef XTRX_DEV
-#include "xtrx_source.h"
-#else
-#include "usrp_source.h"
-#endif
+#include <string.h>
+
+#include "sample_source.h"
 #include "fcch_detector.h"
+#include "pipeline.h"
+#include "settle.h"
+#include "stats.h"
+#include "drift.h"
+#include "instr.h"
+#include "power_meter.h"
 #include "util.h"
 
 #ifdef _WIN32
@@ -38,96 +42,277 @@ inline double round(double x) { return floor(x + 0.5); }
 #endif
 
 static const unsigned int	AVG_COUNT	= 100;
-static const unsigned int	AVG_THRESHOLD	= (AVG_COUNT / 10);
+static const double		AVG_TRIM	= 0.1;
 static const float		OFFSET_MAX	= 40e3;
 
-extern int g_verbosity;
+/*
+ * Sequential mode: once SEQ_MIN offsets are in, stop as soon as the 95%
+ * confidence interval of the trimmed mean is within the target, or when
+ * time runs out.  Looking at the interval after every offset makes it a
+ * little optimistic, SEQ_MIN keeps the early looks from deciding on a lucky
+ * handful.
+ */
+static const unsigned int	SEQ_MIN		= 20;
+static const double		SEQ_TIME	= 30.0;
+static const double		CI_Z		= 1.96;
 
+#define GSM_RATE (1625000.0 / 6.0)
 
-int offset_detect(usrp_source *u) {
+extern int g_verbosity;
 
-#define GSM_RATE (1625000.0 / 6.0)
 
-	unsigned int new_overruns = 0, overruns = 0;
-	int notfound = 0;
-	unsigned int s_len, b_len, consumed, count;
-	float offset = 0.0, min = 0.0, max = 0.0, avg_offset = 0.0,
-	   stddev = 0.0, sps, offsets[AVG_COUNT];
-	double total_ppm;
+/*
+ * Keep capturing while there is a free block in the pool, the workers scan
+ * the blocks already queued in the meantime.  Each job is stamped with the
+ * time its samples were read.  The power meter reads the same samples off
+ * the buffer as they go.  Returns 1 once a recording has run out, the
+ * silence after it is not queued.
+ */
+static int capture(sample_source *u, scan_pipeline *p, power_meter *pm,
+   unsigned int *overruns) {
+
+	unsigned int new_overruns = 0, s_len, b_len;
+	int r;
 	complex *cbuf;
-	fcch_detector *l;
 	circular_buffer *cb;
+	scan_job *j;
 
-	l = new fcch_detector(u->sample_rate());
-
-	/*
-	 * We deliberately grab 12 frames and 1 burst.  We are guaranteed to
-	 * find at least one FCCH burst in this much data.
-	 */
-	sps = u->sample_rate() / GSM_RATE;
-	s_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) * sps);
+	s_len = p->block_len();
 	cb = u->get_buffer();
-
-	u->start();
-	u->flush();
-	count = 0;
-	while(count < AVG_COUNT) {
+	while(p->free_jobs()) {
 
 		// ensure at least s_len contiguous samples are read from usrp
 		do {
-			if(u->fill(s_len, &new_overruns)) {
-				return -1;
+			if((r = u->fill(s_len, &new_overruns))) {
+				return r;
 			}
 			if(new_overruns) {
-				overruns += new_overruns;
+				*overruns += new_overruns;
 				u->flush();
 			}
 		} while(new_overruns);
 
-		// get a pointer to the next samples
+		/*
+		 * Hand the next samples to the pipeline.  The blocks go back
+		 * to back, as they always did: scan() consumes all it is
+		 * given.  FCCH bursts are at most 11 frames apart, so 12
+		 * frames and a burst hold a whole one wherever the block
+		 * edges fall, and overlapping the blocks would only count a
+		 * burst in the overlap twice.
+		 */
+		j = p->get_job();
+		j->freq = u->m_center_freq;
+		j->stamp = settle_timer::now();
 		cbuf = (complex *)cb->peek(&b_len);
+		j->len = (b_len < s_len)? b_len : s_len;
+		memcpy(j->buf, cbuf, j->len * sizeof(complex));
+		cb->purge(j->len);
+		pm->update();
+		p->submit(j);
+	}
+
+	return 0;
+}
+
+
+/*
+ * With target_ppm or max_time set, offsets are collected until the estimate
+ * is good to target_ppm or max_time seconds have passed, rather than a fixed
+ * AVG_COUNT of them.  The statistics are kept in constant memory, so such a
+ * run can go on for as long as it takes.
+ */
+int offset_detect(sample_source *u, scan_pipeline *p, double target_ppm,
+   double max_time) {
+
+	unsigned int overruns = 0;
+	int notfound = 0, seq, done, ended = 0, r;
+	unsigned int count;
+	float offset = 0.0, min = 0.0, max = 0.0, avg_offset = 0.0,
+	   stddev = 0.0;
+	double total_ppm, start, ci_ppm = 0.0;
+	robust_stats offsets(AVG_TRIM);
+	power_meter pm(u->get_buffer());
+	scan_job *j;
+
+	seq = (target_ppm > 0.0) || (max_time > 0.0);
+	if(seq && (max_time <= 0.0))
+		max_time = SEQ_TIME;
+
+	instr_channel(u->m_center_freq);
+	u->start();
+	u->flush();
+	start = settle_timer::now();
+	count = 0;
+	done = 0;
+	while(!done && (seq || (count < AVG_COUNT))) {
+
+		if((r = capture(u, p, &pm, &overruns)) < 0)
+			return -1;
+		ended |= r;
+
+		// results come back in capture order, none left once it ended
+		if(!(j = p->wait_done()))
+			break;
 
 		// search the buffer for a pure tone
-		if(l->scan(cbuf, b_len, &offset, &consumed)) {
+		if(j->found) {
 
 			// FCH is a sine wave at GSM_RATE / 4
-			offset = offset - GSM_RATE / 4;
+			offset = j->offset - GSM_RATE / 4;
 
 			// sanity check offset
 			if(fabs(offset) < OFFSET_MAX) {
 
-				offsets[count] = offset;
+				offsets.add(offset);
 				count += 1;
+				instr_count(INSTR_FOUND);
 
 				if(g_verbosity > 0) {
 					fprintf(stderr, "\toffset %3u: %.2f\n", count, offset);
 				}
+
+				if(seq && (target_ppm > 0.0) && (count >= SEQ_MIN)) {
+					ci_ppm = CI_Z * offsets.std_error() / u->m_center_freq * 1e6;
+					if(g_verbosity > 1) {
+						fprintf(stderr, "\t\t+/- %.4f ppm\n", ci_ppm);
+					}
+					done = (ci_ppm <= target_ppm);
+				}
 			}
 		} else {
 			++notfound;
+			instr_count(INSTR_NOTFOUND);
 		}
 
-		// consume used samples
-		cb->purge(consumed);
+		p->put_job(j);
+
+		if(seq && (settle_timer::now() - start >= max_time))
+			done = 1;
 	}
 
-	u->stop();
-	delete l;
+	// drop whatever was captured ahead
+	while((j = p->wait_done()))
+		p->put_job(j);
+
+	if(ended)
+		fprintf(stderr, "the recording ended after %u offsets\n", count);
+	if(count < 2) {
+		fprintf(stderr, "error: too few FCCH bursts found: %u\n", count);
+		return -1;
+	}
 
 	// construct stats
-	sort(offsets, AVG_COUNT);
-	avg_offset = avg(offsets + AVG_THRESHOLD, AVG_COUNT - 2 * AVG_THRESHOLD, &stddev);
-	min = offsets[AVG_THRESHOLD];
-	max = offsets[AVG_COUNT - AVG_THRESHOLD - 1];
+	avg_offset = offsets.trimmed_mean();
+	stddev = offsets.trimmed_stddev();
+	min = offsets.lo();
+	max = offsets.hi();
 
 	printf("average\t\t[min, max]\t(range, stddev)\n");
 	display_freq(avg_offset);
 	printf("\t\t[%d, %d]\t(%d, %f)\n", (int)round(min), (int)round(max), (int)round(max - min), stddev);
 	printf("overruns: %u\n", overruns);
 	printf("not found: %u\n", notfound);
+	if(pm.count())
+		printf("power: %.1f dB +/- %.1f\n", pm.mean_db(), pm.stddev_db());
+	if(seq) {
+		ci_ppm = CI_Z * offsets.std_error() / u->m_center_freq * 1e6;
+		printf("offsets: %u in %.1fs, 95%% confidence: +/- %.4f ppm\n",
+		   count, settle_timer::now() - start, ci_ppm);
+	}
 
 	total_ppm = u->m_freq_corr - (avg_offset / u->m_center_freq) * 1000000;
 
 	printf("average absolute error: %.3f ppm\n", total_ppm);
 	return 0;
 }
+
+
+/*
+ * Drift tracking
+ *
+ * Every FCCH burst found becomes a timestamped frequency error, in ppm, fed
+ * to the drift model and the Allan deviation.  A summary goes out every
+ * interval seconds, until max_time seconds have passed or for good.
+ */
+int offset_track(sample_source *u, scan_pipeline *p, double interval,
+   double max_time) {
+
+	static const double		BURST_SIGMA	= 20.0;	// Hz
+	static const double		DRIFT_Q		= 1e-9;	// ppm^2 / s^3
+	static const double		ADEV_TAU0	= 1.0;
+	static const unsigned int	ADEV_OCTAVES	= 12;
+
+	unsigned int k, overruns = 0;
+	unsigned long bursts = 0, notfound = 0;
+	int ended = 0, r;
+	float offset;
+	double fc, ppm, t, start, now, next;
+	scan_job *j;
+
+	fc = u->m_center_freq;
+	drift_tracker dt(pow(BURST_SIGMA / fc * 1e6, 2), DRIFT_Q);
+	allan_dev ad(ADEV_TAU0, ADEV_OCTAVES);
+	power_meter pm(u->get_buffer());
+
+	printf("time\t\tppm\t\t+/-\tdrift ppb/s\tbursts\trejected\n");
+	fflush(stdout);
+
+	instr_channel(fc);
+	u->start();
+	u->flush();
+	start = settle_timer::now();
+	next = start + interval;
+	for(;;) {
+		if((r = capture(u, p, &pm, &overruns)) < 0)
+			return -1;
+		ended |= r;
+
+		if(!(j = p->wait_done()))
+			break;
+		offset = j->offset - GSM_RATE / 4;
+		if(j->found && (fabs(offset) < OFFSET_MAX)) {
+			ppm = u->m_freq_corr - (offset / fc) * 1000000;
+			t = j->stamp - start;
+			if(!dt.add(t, ppm)) {
+				ad.add(t, ppm * 1e-6);
+				bursts++;
+			}
+			instr_count(INSTR_FOUND);
+		} else {
+			notfound++;
+			instr_count(INSTR_NOTFOUND);
+		}
+		p->put_job(j);
+
+		now = settle_timer::now();
+		if(now >= next) {
+			printf("%8.1f\t%+10.4f\t%.4f\t%+8.4f\t%lu\t%lu\n",
+			   now - start, dt.ppm(), dt.ppm_sigma(),
+			   dt.drift() * 1000, bursts, dt.rejected());
+			if(ad.count(0)) {
+				printf("adev");
+				for(k = 0; (k < ad.octaves()) && ad.count(k); k++)
+					printf("\t%gs %.2e", ad.tau(k), ad.adev(k));
+				printf("\n");
+			}
+			fflush(stdout);
+			while(next <= now)
+				next += interval;
+		}
+		if((max_time > 0.0) && (now - start >= max_time))
+			break;
+	}
+
+	while((j = p->wait_done()))
+		p->put_job(j);
+
+	if(ended)
+		fprintf(stderr, "the recording ended after %lu bursts\n", bursts);
+	printf("overruns: %u\n", overruns);
+	printf("not found: %lu\n", notfound);
+	printf("gaps: %lu\n", ad.gaps());
+	if(pm.count())
+		printf("power: %.1f dB +/- %.1f\n", pm.mean_db(), pm.stddev_db());
+
+	return 0;
+}
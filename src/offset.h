@@ -25,4 +25,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-int offset_detect(usrp_source *u);
+class sample_source;
+class scan_pipeline;
+
+int offset_detect(sample_source *u, scan_pipeline *p, double target_ppm = 0.0, double max_time = 0.0);
+int offset_track(sample_source *u, scan_pipeline *p, double interval, double max_time = 0.0);
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdexcept>
+
+#include "pipeline.h"
+#include "instr.h"
+#include "trace.h"
+
+#define GSM_RATE (1625000.0 / 6.0)
+
+struct worker_arg {
+	scan_pipeline	*p;
+	fcch_detector	*l;
+	unsigned int	n;
+};
+
+
+scan_pipeline::scan_pipeline(float sample_rate, unsigned int nworkers) {
+
+	unsigned int i;
+	worker_arg *a;
+
+	/*
+	 * We deliberately grab 12 frames and 1 burst.  We are guaranteed to
+	 * find at least one FCCH burst in this much data.
+	 */
+	m_block_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) *
+	   (sample_rate / GSM_RATE));
+
+	/*
+	 * Every worker can be busy with one job while another waits in the
+	 * queue, plus one for the block being captured.
+	 */
+	m_nworkers = nworkers;
+	m_pool_len = 2 * nworkers + 1;
+	m_next_seq = m_next_done = 0;
+	m_q_head = m_q_len = 0;
+	m_stop = 0;
+
+	m_pool = new scan_job[m_pool_len];
+	m_free = new scan_job *[m_pool_len];
+	m_queue = new scan_job *[m_pool_len];
+	m_inflight = new scan_job *[m_pool_len];
+	for(i = 0; i < m_pool_len; i++) {
+		memset(&m_pool[i], 0, sizeof(scan_job));
+		m_pool[i].buf = new complex[m_block_len];
+		m_free[i] = &m_pool[i];
+		m_inflight[i] = 0;
+	}
+	m_nfree = m_pool_len;
+
+	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_work_cond, 0);
+	pthread_cond_init(&m_done_cond, 0);
+	pthread_cond_init(&m_free_cond, 0);
+
+	/*
+	 * FFTW planning isn't thread-safe, so all detectors are built here.
+	 * Without workers the single detector runs on the caller's thread.
+	 */
+	m_detectors = new fcch_detector *[nworkers? nworkers : 1];
+	for(i = 0; i < (nworkers? nworkers : 1); i++)
+		m_detectors[i] = new fcch_detector(sample_rate);
+
+	m_threads = new pthread_t[nworkers? nworkers : 1];
+	for(i = 0; i < nworkers; i++) {
+		a = new worker_arg;
+		a->p = this;
+		a->l = m_detectors[i];
+		a->n = i;
+		if(pthread_create(&m_threads[i], 0, worker_main, a))
+			throw std::runtime_error("scan_pipeline: pthread_create");
+	}
+}
+
+
+scan_pipeline::~scan_pipeline() {
+
+	unsigned int i;
+
+	pthread_mutex_lock(&m_mutex);
+	m_stop = 1;
+	pthread_cond_broadcast(&m_work_cond);
+	pthread_mutex_unlock(&m_mutex);
+	for(i = 0; i < m_nworkers; i++)
+		pthread_join(m_threads[i], 0);
+
+	for(i = 0; i < (m_nworkers? m_nworkers : 1); i++)
+		delete m_detectors[i];
+	delete[] m_detectors;
+	delete[] m_threads;
+
+	for(i = 0; i < m_pool_len; i++)
+		delete[] m_pool[i].buf;
+	delete[] m_pool;
+	delete[] m_free;
+	delete[] m_queue;
+	delete[] m_inflight;
+
+	pthread_cond_destroy(&m_free_cond);
+	pthread_cond_destroy(&m_done_cond);
+	pthread_cond_destroy(&m_work_cond);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+
+/*
+ * One worker per core, the capturing thread keeps the last one.
+ */
+unsigned int scan_pipeline::default_workers() {
+
+#ifdef _SC_NPROCESSORS_ONLN
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(n > 1)
+		return n - 1;
+#endif
+	return 0;
+}
+
+
+/*
+ * Returns a free job, waiting for one to come back if they are all in
+ * flight.
+ */
+scan_job *scan_pipeline::get_job() {
+
+	scan_job *j;
+	uint64_t t;
+
+	pthread_mutex_lock(&m_mutex);
+	if(!m_nfree) {
+		t = instr_begin(INSTR_WAIT);
+		while(!m_nfree)
+			pthread_cond_wait(&m_free_cond, &m_mutex);
+		instr_end(INSTR_WAIT, t);
+	}
+	j = m_free[--m_nfree];
+	pthread_mutex_unlock(&m_mutex);
+
+	j->len = 0;
+	j->found = 0;
+	j->offset = 0.0;
+	j->consumed = 0;
+	j->done = 0;
+
+	return j;
+}
+
+
+void scan_pipeline::put_job(scan_job *j) {
+
+	pthread_mutex_lock(&m_mutex);
+	m_free[m_nfree++] = j;
+	pthread_cond_signal(&m_free_cond);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+unsigned int scan_pipeline::free_jobs() {
+
+	unsigned int n;
+
+	pthread_mutex_lock(&m_mutex);
+	n = m_nfree;
+	pthread_mutex_unlock(&m_mutex);
+
+	return n;
+}
+
+
+/*
+ * Jobs submitted but not yet returned by wait_done().
+ */
+unsigned int scan_pipeline::pending() {
+
+	unsigned int n;
+
+	pthread_mutex_lock(&m_mutex);
+	n = m_next_seq - m_next_done;
+	pthread_mutex_unlock(&m_mutex);
+
+	return n;
+}
+
+
+void scan_pipeline::run(scan_job *j, fcch_detector *l) {
+
+	if(j->freq > 0.0)
+		instr_channel(j->freq);
+	j->found = l->scan(j->buf, j->len, &j->offset, &j->consumed);
+}
+
+
+void scan_pipeline::submit(scan_job *j) {
+
+	pthread_mutex_lock(&m_mutex);
+	j->seq = m_next_seq++;
+	m_inflight[j->seq % m_pool_len] = j;
+	if(!m_nworkers) {
+		pthread_mutex_unlock(&m_mutex);
+		run(j, m_detectors[0]);
+		pthread_mutex_lock(&m_mutex);
+		j->done = 1;
+	} else {
+		m_queue[(m_q_head + m_q_len) % m_pool_len] = j;
+		m_q_len += 1;
+		pthread_cond_signal(&m_work_cond);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+/*
+ * Returns the oldest submitted job once it is finished.  Returns 0 if nothing
+ * is pending.
+ */
+scan_job *scan_pipeline::wait_done() {
+
+	scan_job *j;
+	uint64_t t;
+
+	pthread_mutex_lock(&m_mutex);
+	if(m_next_done == m_next_seq) {
+		pthread_mutex_unlock(&m_mutex);
+		return 0;
+	}
+	j = m_inflight[m_next_done % m_pool_len];
+	if(!j->done) {
+		t = instr_begin(INSTR_WAIT);
+		while(!j->done)
+			pthread_cond_wait(&m_done_cond, &m_mutex);
+		instr_end(INSTR_WAIT, t);
+	}
+	m_inflight[m_next_done % m_pool_len] = 0;
+	m_next_done += 1;
+	pthread_mutex_unlock(&m_mutex);
+
+	return j;
+}
+
+
+/*
+ * Like wait_done(), but returns 0 rather than wait if the oldest job isn't
+ * finished yet.
+ */
+scan_job *scan_pipeline::poll_done() {
+
+	scan_job *j;
+
+	pthread_mutex_lock(&m_mutex);
+	if(m_next_done == m_next_seq) {
+		pthread_mutex_unlock(&m_mutex);
+		return 0;
+	}
+	j = m_inflight[m_next_done % m_pool_len];
+	if(!j->done) {
+		pthread_mutex_unlock(&m_mutex);
+		return 0;
+	}
+	m_inflight[m_next_done % m_pool_len] = 0;
+	m_next_done += 1;
+	pthread_mutex_unlock(&m_mutex);
+
+	return j;
+}
+
+
+void *scan_pipeline::worker_main(void *arg) {
+
+	worker_arg *a = (worker_arg *)arg;
+	scan_pipeline *p = a->p;
+	fcch_detector *l = a->l;
+	scan_job *j;
+	char name[32];
+	uint64_t t;
+
+	snprintf(name, sizeof(name), "worker %u", a->n);
+	trace_thread_name(name);
+	delete a;
+
+	pthread_mutex_lock(&p->m_mutex);
+	for(;;) {
+		if(!p->m_q_len && !p->m_stop) {
+			t = instr_begin(INSTR_IDLE);
+			while(!p->m_q_len && !p->m_stop)
+				pthread_cond_wait(&p->m_work_cond, &p->m_mutex);
+			instr_end(INSTR_IDLE, t);
+		}
+		if(!p->m_q_len)
+			break;
+		j = p->m_queue[p->m_q_head];
+		p->m_q_head = (p->m_q_head + 1) % p->m_pool_len;
+		p->m_q_len -= 1;
+		pthread_mutex_unlock(&p->m_mutex);
+
+		p->run(j, l);
+
+		pthread_mutex_lock(&p->m_mutex);
+		j->done = 1;
+		pthread_cond_broadcast(&p->m_done_cond);
+	}
+	pthread_mutex_unlock(&p->m_mutex);
+
+	return 0;
+}
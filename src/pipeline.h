@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * scan_pipeline
+ *
+ * Overlaps capture with detection.  The capturing thread takes a free job
+ * from a fixed pool, copies a block of samples into it and submits it.  A
+ * pool of worker threads, each with its own fcch_detector, scans the queued
+ * blocks while the capturing thread retunes and fills the next one.  Finished
+ * jobs are handed back strictly in submission order.
+ *
+ * With no workers, submit() runs the detector on the calling thread and the
+ * pipeline degenerates to the old capture, scan, capture sequence.
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+#include "usrp_complex.h"
+#include "fcch_detector.h"
+
+struct scan_job {
+	unsigned int	seq;		// submission order
+	int		chan;		// set by the caller
+	double		freq;		// set by the caller
+	double		stamp;		// set by the caller
+	complex		*buf;
+	unsigned int	len;		// samples in buf
+	unsigned int	found;		// scan() result
+	float		offset;
+	unsigned int	consumed;
+	unsigned int	done;
+};
+
+
+class scan_pipeline {
+public:
+	scan_pipeline(float sample_rate, unsigned int nworkers);
+	~scan_pipeline();
+
+	scan_job *get_job();
+	void submit(scan_job *j);
+	scan_job *wait_done();
+	scan_job *poll_done();
+	void put_job(scan_job *j);
+
+	unsigned int free_jobs();
+	unsigned int pending();
+	unsigned int block_len() { return m_block_len; };
+	unsigned int workers() { return m_nworkers; };
+	fcch_detector *detector() { return m_detectors[0]; };
+
+	static unsigned int default_workers();
+
+private:
+	static void *worker_main(void *arg);
+	void run(scan_job *j, fcch_detector *l);
+
+	unsigned int		m_block_len,
+				m_nworkers,
+				m_pool_len,
+				m_next_seq,
+				m_next_done,
+				m_q_head,
+				m_q_len,
+				m_nfree,
+				m_stop;
+
+	scan_job		*m_pool;
+	scan_job		**m_free;	// free jobs
+	scan_job		**m_queue;	// submitted, waiting for a worker
+	scan_job		**m_inflight;	// indexed by seq % m_pool_len
+
+	fcch_detector		**m_detectors;
+	pthread_t		*m_threads;
+
+	pthread_mutex_t		m_mutex;
+	pthread_cond_t		m_work_cond;
+	pthread_cond_t		m_done_cond;
+	pthread_cond_t		m_free_cond;
+};
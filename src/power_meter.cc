@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <stdexcept>
+
+#include "usrp_complex.h"
+#include "power_meter.h"
+
+
+power_meter::power_meter(circular_buffer *cb) {
+
+	m_cb = cb;
+	if((m_reader = m_cb->add_reader()) < 0)
+		throw std::runtime_error("power_meter: no reader left");
+}
+
+
+power_meter::~power_meter() {
+
+	m_cb->remove_reader(m_reader);
+}
+
+
+/*
+ * Silence, where a recording has run out, makes no reading.
+ */
+void power_meter::update() {
+
+	unsigned int i, len;
+	double sum = 0.0;
+	complex *c;
+
+	c = (complex *)m_cb->peek(m_reader, &len);
+	if(!len)
+		return;
+	for(i = 0; i < len; i++)
+		sum += norm(c[i]);
+	m_cb->purge(m_reader, len);
+
+	if(sum > 0.0)
+		m_db.add(10.0 * log10(sum / len));
+}
+
+
+double power_meter::stddev_db() {
+
+	return (m_db.count() > 1)? sqrt(m_db.variance()) : 0.0;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * power_meter
+ *
+ * Follows the received power on a source's buffer as one more reader of
+ * it, next to the consumer the buffer is filled for.  Each update() takes
+ * what has come in since the last one straight from the mapping, without a
+ * copy, and makes one reading of its mean power in dB.  The meter has to
+ * keep up: the source can only refill what every reader is done with.
+ */
+
+#pragma once
+
+#include "circular_buffer.h"
+#include "stats.h"
+
+class power_meter {
+public:
+	power_meter(circular_buffer *cb);
+	~power_meter();
+
+	void update();
+
+	unsigned long count() { return m_db.count(); };
+	double mean_db() { return m_db.mean(); };
+	double stddev_db();
+	double min_db() { return m_db.min(); };
+	double max_db() { return m_db.max(); };
+
+private:
+	circular_buffer	*m_cb;
+	int		m_reader;
+	running_stats	m_db;
+};
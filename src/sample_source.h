@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * sample_source
+ *
+ * What the scan and calibration code needs from a receiver.  The hardware
+ * sources (usrp_source for rtl-sdr, xtrx_source) and file_source implement
+ * it.  Samples come out of get_buffer() at sample_rate(), the GSM rate
+ * unless set_sample_rate() asked for something else.  Sources that can
+ * record what they read to a .kal file implement record().
+ *
+ * fill() returns -1 on error, and 1 when a recording has run out and the
+ * buffer ends in silence.
+ */
+
+#pragma once
+
+#include "circular_buffer.h"
+
+class sample_source {
+public:
+	virtual ~sample_source() {};
+
+	virtual int open(unsigned int subdev) = 0;
+	virtual int fill(unsigned int num_samples, unsigned int *overrun) = 0;
+	virtual int tune(double freq) = 0;
+	virtual int set_freq_correction(double ppm) = 0;
+	virtual int set_sample_rate(double rate) = 0;
+	virtual int reset_sample_rate() = 0;
+	virtual bool set_gain(float gain) = 0;
+	virtual void start() = 0;
+	virtual void stop() = 0;
+	virtual int flush(unsigned int flush_count = 0) = 0;
+	virtual circular_buffer *get_buffer() = 0;
+	virtual int reserve(unsigned int len) = 0;
+	virtual void report_settle() = 0;
+	virtual const char *device_id() = 0;
+	virtual int record(const char *path) { return -1; };
+
+	virtual float sample_rate() = 0;
+
+	double			m_center_freq;
+	double			m_freq_corr;
+};
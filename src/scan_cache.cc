@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "scan_cache.h"
+#include "arfcn_freq.h"
+
+static const char CACHE_MAGIC[8] = "kalscan";
+static const uint32_t CACHE_VERSION = 1;
+static const char CACHE_DIR[] = ".kal_scan_cache";
+
+
+/*
+ * The device id ends up in a file name, keep it to something safe.
+ */
+scan_cache::scan_cache(const char *device_id) {
+
+	unsigned int i;
+
+	// zero padded, it goes into the band files whole
+	memset(m_device, 0, sizeof(m_device));
+	for(i = 0; device_id[i] && (i < sizeof(m_device) - 1); i++) {
+		if(isalnum(device_id[i]) || strchr("-_.", device_id[i]))
+			m_device[i] = device_id[i];
+		else
+			m_device[i] = '_';
+	}
+
+	memset(m_band, 0, sizeof(m_band));
+	m_failed = 0;
+	m_len = sizeof(header) + MAX_ARFCN * sizeof(scan_cache_entry);
+}
+
+
+scan_cache::~scan_cache() {
+
+	unsigned int i;
+
+	for(i = 0; i < MAX_BI; i++) {
+		if(m_band[i])
+			munmap(m_band[i], m_len);
+	}
+}
+
+
+/*
+ * Map the band's file, creating it if need be.  A file that was written for
+ * another device, band or layout is started over.  Failures are reported
+ * once and the band is then left uncached.
+ */
+scan_cache::header *scan_cache::map_band(int bi) {
+
+	int fd;
+	char path[PATH_MAX];
+	const char *home;
+	struct stat st;
+	void *m;
+	header *h;
+
+	if(m_band[bi])
+		return m_band[bi];
+	if(m_failed & (1 << bi))
+		return 0;
+	m_failed |= 1 << bi;
+
+	if(!(home = getenv("HOME"))) {
+		fprintf(stderr, "warning: scan cache: HOME not set\n");
+		return 0;
+	}
+	// the file's path is the longer one, if it fits so does the directory
+	if(snprintf(path, sizeof(path), "%s/%s/%s-%s", home, CACHE_DIR,
+	   m_device, bi_to_str(bi)) >= (int)sizeof(path)) {
+		fprintf(stderr, "warning: scan cache: HOME is too long\n");
+		return 0;
+	}
+	snprintf(path, sizeof(path), "%s/%s", home, CACHE_DIR);
+	if(mkdir(path, 0755) && (errno != EEXIST)) {
+		fprintf(stderr, "warning: scan cache: mkdir %s: %s\n", path,
+		   strerror(errno));
+		return 0;
+	}
+	snprintf(path, sizeof(path), "%s/%s/%s-%s", home, CACHE_DIR, m_device,
+	   bi_to_str(bi));
+	if((fd = ::open(path, O_RDWR | O_CREAT, 0644)) == -1) {
+		fprintf(stderr, "warning: scan cache: open %s: %s\n", path,
+		   strerror(errno));
+		return 0;
+	}
+	if(fstat(fd, &st) || ((st.st_size != (off_t)m_len) &&
+	   (ftruncate(fd, 0) || ftruncate(fd, m_len)))) {
+		fprintf(stderr, "warning: scan cache: %s: %s\n", path,
+		   strerror(errno));
+		close(fd);
+		return 0;
+	}
+	m = mmap(0, m_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(m == MAP_FAILED) {
+		fprintf(stderr, "warning: scan cache: mmap %s: %s\n", path,
+		   strerror(errno));
+		return 0;
+	}
+
+	h = (header *)m;
+	if(memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) ||
+	   (h->version != CACHE_VERSION) || (h->bi != bi) ||
+	   strncmp(h->device, m_device, sizeof(h->device))) {
+		memset(m, 0, m_len);
+		memcpy(h->magic, CACHE_MAGIC, sizeof(h->magic));
+		h->version = CACHE_VERSION;
+		h->bi = bi;
+		memcpy(h->device, m_device, sizeof(h->device));
+	}
+
+	m_failed &= ~(1 << bi);
+	return m_band[bi] = h;
+}
+
+
+/*
+ * Record for ARFCN arfcn of band bi, 0 if the band can't be cached.
+ */
+scan_cache_entry *scan_cache::entry(int bi, int arfcn) {
+
+	header *h;
+
+	if((bi <= BI_NOT_DEFINED) || (bi >= (int)MAX_BI) || (arfcn < 0) ||
+	   (arfcn >= (int)MAX_ARFCN))
+		return 0;
+	if(!(h = map_band(bi)))
+		return 0;
+
+	return (scan_cache_entry *)(h + 1) + arfcn;
+}
+
+
+/*
+ * A channel is a known C0 if the last decision on it was a detection.
+ */
+bool scan_cache::is_c0(const scan_cache_entry *e) {
+
+	return e->found && (e->found >= e->searched);
+}
+
+
+void scan_cache::add_power(scan_cache_entry *e, double power, uint32_t now) {
+
+	if(e->probes)
+		e->power_avg += (power - e->power_avg) / 8;
+	else
+		e->power_avg = power;
+	e->power = power;
+	e->probed = now;
+	e->probes++;
+}
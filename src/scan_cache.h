@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * scan_cache
+ *
+ * What a band scan learned, kept on disk so the next scan can start warm.
+ * There is one file per device and band under ~/.kal_scan_cache, each a
+ * small header and one fixed size record per ARFCN.  The files are mapped
+ * shared, so updates go straight to the page cache and survive a crash.
+ *
+ * All times are seconds since the epoch.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct scan_cache_entry {
+	float		power;		// last measured power
+	float		power_avg;	// running average of the measurements
+	float		offset;		// FCCH offset when last found
+	uint32_t	probed;		// last power measurement, 0 if never
+	uint32_t	searched;	// last decision on the channel
+	uint32_t	found;		// last FCCH detection, 0 if never
+	uint32_t	probes;		// power measurements so far
+	uint32_t	hits;		// FCCH detections so far
+};
+
+class scan_cache {
+public:
+	scan_cache(const char *device_id);
+	~scan_cache();
+
+	scan_cache_entry *entry(int bi, int arfcn);
+
+	static bool is_c0(const scan_cache_entry *e);
+	static void add_power(scan_cache_entry *e, double power, uint32_t now);
+
+	static const unsigned int	MAX_ARFCN	= 1024;
+	static const unsigned int	MAX_BI		= 8;
+
+private:
+	struct header {
+		char		magic[8];
+		uint32_t	version;
+		int32_t		bi;
+		char		device[64];
+	};
+
+	header *map_band(int bi);
+
+	char		m_device[64];
+	header		*m_band[MAX_BI];
+	unsigned int	m_failed;
+	unsigned int	m_len;
+};
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+
+#include "settle.h"
+
+/*
+ * Neighbouring windows of a settled receiver differ in power by less than
+ * STEP_DB and in DC offset by less than DC_STEP of the rms signal.  A
+ * receiver that hasn't settled after MAX_SETTLE seconds is taken as it is.
+ */
+static const double STEP_DB = 3.0;
+static const double DC_STEP = 0.25;
+static const double MAX_SETTLE = 50e-3;
+
+
+settle_timer::settle_timer() {
+
+	m_start = 0.0;
+	m_count = m_at = 0;
+	m_windows = 0;
+	m_sum_i = m_sum_q = m_sum_p = 0.0;
+	m_settling = 0;
+	reset();
+}
+
+
+double settle_timer::now() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+void settle_timer::reset() {
+
+	m_lat_sum = m_lat_max = 0.0;
+	m_settle_sum = m_settle_max = 0.0;
+	m_tunes = 0;
+	m_unsettled = 0;
+	m_dropped = 0;
+}
+
+
+void settle_timer::tune_start() {
+
+	m_start = now();
+}
+
+
+/*
+ * The tune returned and the transport was reset, the next sample read is
+ * the first one taken at the new frequency.
+ */
+void settle_timer::tune_done() {
+
+	double lat = now() - m_start;
+
+	m_lat_sum += lat;
+	if(lat > m_lat_max)
+		m_lat_max = lat;
+	m_tunes++;
+
+	m_count = m_at = 0;
+	m_windows = 0;
+	m_sum_i = m_sum_q = m_sum_p = 0.0;
+	m_settling = 1;
+}
+
+
+/*
+ * The last RUN windows agree with the first of them.
+ */
+int settle_timer::steady() {
+
+	unsigned int k;
+	double di, dq, ac;
+
+	ac = m_pow[0] - m_dc_i[0] * m_dc_i[0] - m_dc_q[0] * m_dc_q[0];
+	if(ac < 0.0)
+		ac = 0.0;
+	for(k = 1; k < RUN; k++) {
+		if(fabs(10.0 * log10((m_pow[k] + 1e-9) / (m_pow[0] + 1e-9))) >= STEP_DB)
+			return 0;
+		di = m_dc_i[k] - m_dc_i[0];
+		dq = m_dc_q[k] - m_dc_q[0];
+		if(di * di + dq * dq > DC_STEP * DC_STEP * ac + 1e-9)
+			return 0;
+	}
+	return 1;
+}
+
+
+void settle_timer::settled(double sample_rate) {
+
+	double t = m_at / sample_rate;
+
+	m_settle_sum += t;
+	if(t > m_settle_max)
+		m_settle_max = t;
+	m_settling = 0;
+}
+
+
+/*
+ * Sample number m_count since the tune.  Every WINDOW samples the window
+ * joins the last RUN - 1 and the receiver is settled from the start of the
+ * first of them once they agree.
+ */
+void settle_timer::add(double i, double q, double sample_rate) {
+
+	unsigned int k;
+
+	m_sum_i += i;
+	m_sum_q += q;
+	m_sum_p += i * i + q * q;
+	if(++m_count % WINDOW)
+		return;
+
+	for(k = 1; k < RUN; k++) {
+		m_dc_i[k - 1] = m_dc_i[k];
+		m_dc_q[k - 1] = m_dc_q[k];
+		m_pow[k - 1] = m_pow[k];
+	}
+	m_dc_i[RUN - 1] = m_sum_i / WINDOW;
+	m_dc_q[RUN - 1] = m_sum_q / WINDOW;
+	m_pow[RUN - 1] = m_sum_p / WINDOW;
+	m_sum_i = m_sum_q = m_sum_p = 0.0;
+
+	if((++m_windows >= RUN) && steady()) {
+		m_at = m_count - RUN * WINDOW;
+		settled(sample_rate);
+	} else if(m_count >= MAX_SETTLE * sample_rate) {
+		m_at = m_count;
+		m_unsettled++;
+		settled(sample_rate);
+	}
+}
+
+
+/*
+ * How many of the n samples of a block starting at sample first to drop.
+ */
+unsigned int settle_timer::drop(unsigned long first, unsigned int n) {
+
+	unsigned int k = n;
+
+	if(!m_settling)
+		k = (m_at > first)? (unsigned int)(m_at - first) : 0;
+	if(k > n)
+		k = n;
+	m_dropped += k;
+	return k;
+}
+
+
+/*
+ * A block of n samples in the tuner's unsigned 8 bit format was read;
+ * return how many of the first were taken before the receiver settled.
+ */
+unsigned int settle_timer::skip(const unsigned char *iq, unsigned int n,
+   double sample_rate) {
+
+	unsigned long first = m_count;
+	unsigned int i;
+
+	if(!m_settling)
+		return 0;
+	for(i = 0; (i < n) && m_settling; i++)
+		add(iq[2 * i] - 127.5, iq[2 * i + 1] - 127.5, sample_rate);
+	return drop(first, n);
+}
+
+
+unsigned int settle_timer::skip(const complex *iq, unsigned int n,
+   double sample_rate) {
+
+	unsigned long first = m_count;
+	unsigned int i;
+
+	if(!m_settling)
+		return 0;
+	for(i = 0; (i < n) && m_settling; i++)
+		add(iq[i].real(), iq[i].imag(), sample_rate);
+	return drop(first, n);
+}
+
+
+void settle_timer::report() {
+
+	if(!m_tunes)
+		return;
+	fprintf(stderr, "retune: %u tunes, latency avg %.2fms max %.2fms, "
+	   "settled after avg %.2fms max %.2fms, %.0f samples dropped per "
+	   "tune\n", m_tunes, 1e3 * m_lat_sum / m_tunes, 1e3 * m_lat_max,
+	   1e3 * m_settle_sum / m_tunes, 1e3 * m_settle_max,
+	   (double)m_dropped / m_tunes);
+	if(m_unsettled) {
+		fprintf(stderr, "warning: %u tunes didn't settle within %.0fms\n",
+		   m_unsettled, 1e3 * MAX_SETTLE);
+	}
+}
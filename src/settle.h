@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * settle_timer
+ *
+ * Tracks how long retunes take and how long the receiver then takes to
+ * settle.  The source resets its transport when it retunes, so the samples
+ * read afterwards are counted from the tune on.  It hands every block to
+ * skip(), which follows the power and DC offset of short windows until
+ * they hold steady and returns how many of the block's leading samples
+ * came before that.
+ */
+
+#pragma once
+
+#include "usrp_complex.h"
+
+class settle_timer {
+public:
+	settle_timer();
+
+	void tune_start();
+	void tune_done();
+	void reset();
+	unsigned int skip(const unsigned char *iq, unsigned int n, double sample_rate);
+	unsigned int skip(const complex *iq, unsigned int n, double sample_rate);
+	void report();
+
+	static double now();
+
+private:
+	void add(double i, double q, double sample_rate);
+	int steady();
+	void settled(double sample_rate);
+	unsigned int drop(unsigned long first, unsigned int n);
+
+	static const unsigned int	WINDOW		= 256;
+	static const unsigned int	RUN		= 4;
+
+	double		m_start,
+			m_lat_sum,
+			m_lat_max,
+			m_settle_sum,
+			m_settle_max;
+	double		m_sum_i,
+			m_sum_q,
+			m_sum_p;
+	double		m_dc_i[RUN],
+			m_dc_q[RUN],
+			m_pow[RUN];
+	unsigned long	m_count,
+			m_at,
+			m_dropped;
+	unsigned int	m_tunes,
+			m_unsettled,
+			m_windows;
+	int		m_settling;
+};
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdexcept>
+
+#include "spectrum.h"
+
+
+welch::welch(const unsigned int fft_len, const unsigned int navg) {
+
+	unsigned int i;
+	double w2 = 0.0;
+	int n = fft_len;
+
+	if((fft_len < 2) || (fft_len & 1) || !navg)
+		throw std::runtime_error("welch: bad segment length or count");
+
+	m_fft_len = fft_len;
+	m_navg = navg;
+
+	m_window = new float[fft_len];
+	for(i = 0; i < fft_len; i++) {
+		m_window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / fft_len);
+		w2 += m_window[i] * m_window[i];
+	}
+	m_scale = 1.0 / (navg * fft_len * w2);
+	m_psd = new float[fft_len];
+
+	m_in = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * fft_len * navg);
+	m_out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * fft_len * navg);
+	if((!m_in) || (!m_out))
+		throw std::runtime_error("welch: fftw_malloc failed!");
+	m_plan = fftw_plan_many_dft(1, &n, navg, m_in, 0, 1, fft_len, m_out, 0,
+	   1, fft_len, FFTW_FORWARD, FFTW_MEASURE);
+	if(!m_plan)
+		throw std::runtime_error("welch: fftw plan failed!");
+}
+
+
+welch::~welch() {
+
+	fftw_destroy_plan(m_plan);
+	fftw_free(m_out);
+	fftw_free(m_in);
+	delete[] m_psd;
+	delete[] m_window;
+}
+
+
+/*
+ * The welch for fft_len and navg, planned the first time it is asked for
+ * and kept until exit.  Only the capture thread sweeps, so there is no lock;
+ * a caller must be done with one welch before it asks for another.
+ */
+welch *welch::cached(const unsigned int fft_len, const unsigned int navg) {
+
+	static const unsigned int CACHE_LEN = 4;
+	static welch *cache[CACHE_LEN];
+	static unsigned int next;
+
+	unsigned int i;
+	welch *w;
+
+	for(i = 0; i < CACHE_LEN; i++) {
+		if(cache[i] && (cache[i]->m_fft_len == fft_len) &&
+		   (cache[i]->m_navg == navg))
+			return cache[i];
+	}
+
+	w = new welch(fft_len, navg);
+	i = next++ % CACHE_LEN;
+	delete cache[i];
+	cache[i] = w;
+
+	return w;
+}
+
+
+/*
+ * in must hold input_len() samples.
+ */
+void welch::run(const complex *in) {
+
+	unsigned int s, i, k;
+	double p;
+	const complex *x;
+
+	for(s = 0; s < m_navg; s++) {
+		x = in + s * m_fft_len / 2;
+		for(i = 0; i < m_fft_len; i++) {
+			m_in[s * m_fft_len + i][0] = m_window[i] * x[i].real();
+			m_in[s * m_fft_len + i][1] = m_window[i] * x[i].imag();
+		}
+	}
+
+	fftw_execute(m_plan);
+
+	for(k = 0; k < m_fft_len; k++) {
+		p = 0.0;
+		for(s = 0; s < m_navg; s++) {
+			p += m_out[s * m_fft_len + k][0] * m_out[s * m_fft_len + k][0] +
+			   m_out[s * m_fft_len + k][1] * m_out[s * m_fft_len + k][1];
+		}
+		m_psd[k] = p * m_scale;
+	}
+}
+
+
+/*
+ * Mean power per sample in [f_lo, f_hi), relative to the center frequency.
+ * Bins are picked by their center and scaled to the width of the band, so
+ * bands that happen to catch one bin more or less still compare.
+ */
+double welch::band_power(double f_lo, double f_hi, double sample_rate) {
+
+	int k, count = 0, n = m_fft_len;
+	double f, p = 0.0;
+
+	for(k = -n / 2; k < n / 2; k++) {
+		f = k * sample_rate / n;
+		if((f_lo <= f) && (f < f_hi)) {
+			p += m_psd[(k + n) % n];
+			count++;
+		}
+	}
+	if(!count)
+		return 0.0;
+
+	return p * (f_hi - f_lo) / (count * sample_rate / n);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * welch
+ *
+ * Power spectrum of a block of samples by Welch's method: navg Hann windowed
+ * segments of fft_len samples, overlapping by half, transformed together
+ * with one batched FFTW plan and averaged.  psd() is normalized so that the
+ * sum over all bins is the mean power per sample.
+ *
+ * Planning with FFTW_MEASURE takes longer than a sweep's worth of spectra, so
+ * sweeps take theirs from cached(), which keeps one per shape for the run.
+ */
+
+#pragma once
+
+#include <fftw3.h>
+
+#include "usrp_complex.h"
+
+class welch {
+public:
+	welch(const unsigned int fft_len, const unsigned int navg);
+	~welch();
+
+	static welch *cached(const unsigned int fft_len, const unsigned int navg);
+
+	void run(const complex *in);
+	double band_power(double f_lo, double f_hi, double sample_rate);
+
+	const float *psd() { return m_psd; };
+	unsigned int fft_len() { return m_fft_len; };
+	unsigned int input_len() { return (m_navg + 1) * m_fft_len / 2; };
+
+private:
+	unsigned int	m_fft_len,
+			m_navg;
+	float		*m_window,
+			*m_psd;
+	double		m_scale;
+
+	fftw_complex	*m_in, *m_out;
+	fftw_plan	m_plan;
+};
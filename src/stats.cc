@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "stats.h"
+
+
+running_stats::running_stats() {
+
+	reset();
+}
+
+
+void running_stats::reset() {
+
+	m_n = 0;
+	m_mean = m_m2 = 0.0;
+	m_min = m_max = 0.0;
+}
+
+
+void running_stats::add(double x) {
+
+	double d;
+
+	if(!m_n || (x < m_min))
+		m_min = x;
+	if(!m_n || (x > m_max))
+		m_max = x;
+	m_n += 1;
+	d = x - m_mean;
+	m_mean += d / m_n;
+	m_m2 += d * (x - m_mean);
+}
+
+
+double running_stats::variance() {
+
+	return (m_n > 1)? m_m2 / (m_n - 1) : 0.0;
+}
+
+
+double running_stats::pvariance() {
+
+	return m_n? m_m2 / m_n : 0.0;
+}
+
+
+p2_quantile::p2_quantile(double p) {
+
+	m_p = p;
+	m_n = 0;
+	m_inc[0] = 0.0;
+	m_inc[1] = p / 2;
+	m_inc[2] = p;
+	m_inc[3] = (1 + p) / 2;
+	m_inc[4] = 1.0;
+}
+
+
+/*
+ * Start from n >= 5 samples already seen, in order: the markers are put
+ * where they want to be.
+ */
+void p2_quantile::seed(const float *sorted, unsigned long n) {
+
+	int i;
+	double p;
+
+	m_n = n;
+	for(i = 0; i < 5; i++) {
+		m_want[i] = (n - 1) * m_inc[i];
+		p = floor(m_want[i] + 0.5);
+		if(i && (p <= m_pos[i - 1]))
+			p = m_pos[i - 1] + 1;
+		if(p > n - 5 + i)
+			p = n - 5 + i;
+		m_pos[i] = p;
+		m_q[i] = sorted[(unsigned long)p];
+	}
+}
+
+
+void p2_quantile::add(double x) {
+
+	int i, k, s;
+	double d, q;
+
+	// the first five samples are the markers
+	if(m_n < 5) {
+		for(i = m_n++; (i > 0) && (m_q[i - 1] > x); i--)
+			m_q[i] = m_q[i - 1];
+		m_q[i] = x;
+		if(m_n == 5) {
+			for(i = 0; i < 5; i++) {
+				m_pos[i] = i;
+				m_want[i] = 4 * m_inc[i];
+			}
+		}
+		return;
+	}
+	m_n++;
+
+	if(x < m_q[0]) {
+		m_q[0] = x;
+		k = 0;
+	} else if(x >= m_q[4]) {
+		m_q[4] = x;
+		k = 3;
+	} else {
+		for(k = 0; x >= m_q[k + 1]; k++)
+			;
+	}
+	for(i = k + 1; i < 5; i++)
+		m_pos[i] += 1;
+	for(i = 0; i < 5; i++)
+		m_want[i] += m_inc[i];
+
+	// move the middle markers toward where they should be
+	for(i = 1; i < 4; i++) {
+		d = m_want[i] - m_pos[i];
+		if(!(((d >= 1.0) && (m_pos[i + 1] - m_pos[i] > 1.0)) ||
+		   ((d <= -1.0) && (m_pos[i - 1] - m_pos[i] < -1.0))))
+			continue;
+		s = (d > 0.0)? 1 : -1;
+
+		// parabolic prediction, linear if that leaves the neighbours
+		q = m_q[i] + s / (m_pos[i + 1] - m_pos[i - 1]) *
+		   ((m_pos[i] - m_pos[i - 1] + s) * (m_q[i + 1] - m_q[i]) /
+		   (m_pos[i + 1] - m_pos[i]) +
+		   (m_pos[i + 1] - m_pos[i] - s) * (m_q[i] - m_q[i - 1]) /
+		   (m_pos[i] - m_pos[i - 1]));
+		if((q <= m_q[i - 1]) || (q >= m_q[i + 1]))
+			q = m_q[i] + s * (m_q[i + s] - m_q[i]) / (m_pos[i + s] - m_pos[i]);
+		m_q[i] = q;
+		m_pos[i] += s;
+	}
+}
+
+
+double p2_quantile::value() {
+
+	if(!m_n)
+		return 0.0;
+	if(m_n < 5)
+		return m_q[(int)(m_p * (m_n - 1) + 0.5)];
+	return m_q[2];
+}
+
+
+static int cmp_float(const void *a, const void *b) {
+
+	float x = *(const float *)a, y = *(const float *)b;
+
+	return (x < y)? -1 : (x > y)? 1 : 0;
+}
+
+
+/*
+ * The quantile estimates are fed samples pulled in to within the trim range's
+ * width of it.  That changes no quantile inside the range, but keeps an
+ * outlier from becoming the top or bottom marker, which P-square would
+ * otherwise interpolate the trim point out into the gap towards.
+ */
+static double clamp(double x, double lo, double hi) {
+
+	double w = hi - lo;
+
+	return (x < lo - w)? lo - w : (x > hi + w)? hi + w : x;
+}
+
+
+robust_stats::robust_stats(double trim) : m_lo(trim), m_hi(1.0 - trim) {
+
+	m_trim = trim;
+	m_n = 0;
+	m_x_valid = 0;
+}
+
+
+void robust_stats::add(double x) {
+
+	double lo, hi;
+
+	if(m_n < EXACT) {
+		m_buf[m_n++] = x;
+		m_x_valid = 0;
+		return;
+	}
+	if(m_n == EXACT)
+		replay();
+	m_n++;
+	lo = m_lo.value();
+	hi = m_hi.value();
+	m_lo.add(clamp(x, lo, hi));
+	m_hi.add(clamp(x, lo, hi));
+
+	lo = m_lo.value();
+	hi = m_hi.value();
+	if((lo <= x) && (x <= hi))
+		m_inner.add(x);
+	m_wins.add((x < lo)? lo : (x > hi)? hi : x);
+}
+
+
+/*
+ * Going from exact to streaming, the quantile estimates start from the kept
+ * samples' exact order statistics, which the kept samples are then trimmed
+ * against.  Five markers fed the first few samples one by one can be far
+ * off when one of them is an outlier.
+ */
+void robust_stats::replay() {
+
+	unsigned int i, t;
+	double lo, hi, x;
+
+	memcpy(m_tmp, m_buf, m_n * sizeof(float));
+	qsort(m_tmp, m_n, sizeof(float), cmp_float);
+	t = (unsigned int)(m_n * m_trim + 1e-9);
+	if(2 * t >= m_n)
+		t = (m_n - 1) / 2;
+	lo = m_tmp[t];
+	hi = m_tmp[m_n - t - 1];
+	for(i = 0; i < m_n; i++)
+		m_tmp[i] = clamp(m_tmp[i], lo, hi);
+	m_lo.seed(m_tmp, m_n);
+	m_hi.seed(m_tmp, m_n);
+	m_x_valid = 0;
+
+	lo = m_lo.value();
+	hi = m_hi.value();
+	for(i = 0; i < m_n; i++) {
+		x = m_buf[i];
+		if((lo <= x) && (x <= hi))
+			m_inner.add(x);
+		m_wins.add((x < lo)? lo : (x > hi)? hi : x);
+	}
+}
+
+
+/*
+ * Trim the kept samples exactly: two selections put the middle of the
+ * distribution in m_tmp[t, n - t).  The standard error of the trimmed mean
+ * comes from the winsorized variance, s_w / ((1 - 2g) sqrt(n)) for trim
+ * fraction g.
+ */
+void robust_stats::exact() {
+
+	unsigned int i, n = m_n, t;
+	double m = 0.0, v = 0.0, w, wm = 0.0;
+
+	if(m_x_valid || !n)
+		return;
+
+	memcpy(m_tmp, m_buf, n * sizeof(float));
+	t = (unsigned int)(n * m_trim + 1e-9);
+	if(2 * t >= n)
+		t = (n - 1) / 2;
+	m_x_lo = select_kth(m_tmp, n, t);
+	m_x_hi = select_kth(m_tmp + t, n - t, n - 2 * t - 1);
+
+	for(i = t; i < n - t; i++)
+		m += m_tmp[i];
+	m /= n - 2 * t;
+	for(i = t; i < n - t; i++)
+		v += (m_tmp[i] - m) * (m_tmp[i] - m);
+	m_x_mean = m;
+	m_x_std = sqrt(v / (n - 2 * t));
+
+	for(i = 0; i < n; i++)
+		wm += (m_tmp[i] < m_x_lo)? m_x_lo : (m_tmp[i] > m_x_hi)? m_x_hi : m_tmp[i];
+	wm /= n;
+	v = 0.0;
+	for(i = 0; i < n; i++) {
+		w = ((m_tmp[i] < m_x_lo)? m_x_lo : (m_tmp[i] > m_x_hi)? m_x_hi : m_tmp[i]) - wm;
+		v += w * w;
+	}
+	v = (n > 1)? v / (n - 1) : 0.0;
+	m_x_se = sqrt(v) / ((1.0 - 2.0 * t / n) * sqrt((double)n));
+
+	m_x_valid = 1;
+}
+
+
+double robust_stats::trimmed_mean() {
+
+	if(m_n > EXACT)
+		return m_inner.mean();
+	exact();
+	return m_x_mean;
+}
+
+
+double robust_stats::trimmed_stddev() {
+
+	if(m_n > EXACT)
+		return sqrt(m_inner.pvariance());
+	exact();
+	return m_x_std;
+}
+
+
+double robust_stats::std_error() {
+
+	if(m_n > EXACT)
+		return sqrt(m_wins.variance()) / ((1.0 - 2.0 * m_trim) * sqrt((double)m_n));
+	exact();
+	return m_x_se;
+}
+
+
+double robust_stats::lo() {
+
+	if(m_n > EXACT)
+		return m_lo.value();
+	exact();
+	return m_x_lo;
+}
+
+
+double robust_stats::hi() {
+
+	if(m_n > EXACT)
+		return m_hi.value();
+	exact();
+	return m_x_hi;
+}
+
+
+/*
+ * Hoare's selection: reorder b so that b[k] is the k-th smallest, nothing
+ * larger before it and nothing smaller after it.  Expected O(len).
+ */
+float select_kth(float *b, unsigned int len, unsigned int k) {
+
+	int lo = 0, hi = len - 1, i, j;
+	float p, t, x, y, z;
+
+	while(lo < hi) {
+		// median of three pivot
+		x = b[lo];
+		y = b[lo + (hi - lo) / 2];
+		z = b[hi];
+		p = (x < y)? ((y < z)? y : (x < z)? z : x) : ((x < z)? x : (y < z)? z : y);
+
+		i = lo;
+		j = hi;
+		while(i <= j) {
+			while(b[i] < p)
+				i++;
+			while(b[j] > p)
+				j--;
+			if(i <= j) {
+				t = b[i];
+				b[i++] = b[j];
+				b[j--] = t;
+			}
+		}
+		if((int)k <= j)
+			hi = j;
+		else if((int)k >= i)
+			lo = i;
+		else
+			break;
+	}
+
+	return b[k];
+}
+
+
+/*
+ * Mean of the k smallest values of b, which is reordered.
+ */
+double low_mean(float *b, unsigned int len, unsigned int k) {
+
+	unsigned int i;
+	double s = 0.0;
+
+	if(!k)
+		return 0.0;
+	select_kth(b, len, k - 1);
+	for(i = 0; i < k; i++)
+		s += b[i];
+
+	return s / k;
+}
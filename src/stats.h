@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Streaming statistics
+ *
+ * running_stats keeps mean and variance with Welford's update.  p2_quantile
+ * tracks one quantile with the P-square algorithm of Jain and Chlamtac, five
+ * markers whatever the number of samples.  robust_stats puts them together
+ * into a trimmed mean: the first EXACT samples are kept and trimmed exactly,
+ * after that the trim points come from P-square estimates, started from the
+ * kept samples, and only running sums are kept, so a run can go on for as
+ * long as it likes.
+ *
+ * select_kth() and low_mean() do the batch equivalents in O(n).
+ */
+
+#pragma once
+
+class running_stats {
+public:
+	running_stats();
+
+	void reset();
+	void add(double x);
+
+	unsigned long count() { return m_n; };
+	double mean() { return m_mean; };
+	double variance();
+	double pvariance();
+	double min() { return m_min; };
+	double max() { return m_max; };
+
+private:
+	unsigned long	m_n;
+	double		m_mean,
+			m_m2,
+			m_min,
+			m_max;
+};
+
+
+class p2_quantile {
+public:
+	p2_quantile(double p);
+
+	void seed(const float *sorted, unsigned long n);
+	void add(double x);
+	double value();
+
+private:
+	double		m_p,
+			m_q[5],
+			m_pos[5],
+			m_want[5],
+			m_inc[5];
+	unsigned long	m_n;
+};
+
+
+class robust_stats {
+public:
+	robust_stats(double trim = 0.1);
+
+	void add(double x);
+
+	unsigned long count() { return m_n; };
+	double trimmed_mean();
+	double trimmed_stddev();
+	double std_error();
+	double lo();
+	double hi();
+
+	static const unsigned int	EXACT	= 128;
+
+private:
+	void exact();
+	void replay();
+
+	double		m_trim;
+	unsigned long	m_n;
+	p2_quantile	m_lo,
+			m_hi;
+	running_stats	m_inner,
+			m_wins;
+
+	// exact statistics of the first EXACT samples
+	float		m_buf[EXACT],
+			m_tmp[EXACT];
+	double		m_x_mean,
+			m_x_std,
+			m_x_se,
+			m_x_lo,
+			m_x_hi;
+	int		m_x_valid;
+};
+
+
+float select_kth(float *b, unsigned int len, unsigned int k);
+double low_mean(float *b, unsigned int len, unsigned int k);
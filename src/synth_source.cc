@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdexcept>
+
+#include "synth_source.h"
+#include "instr.h"
+
+extern int g_verbosity;
+
+#define GSM_RATE (1625000.0 / 6.0)
+
+static const double ADJ_SPACING = 200e3;
+static const float C0_AMP = 1000.0;
+static const unsigned int FRAME_SYMS = 1250;		// 8 * 156.25
+static const unsigned int MF_FRAMES = 51;
+static const unsigned int FCCH_SYMS = 148;
+
+
+synth_source::synth_source(const char *spec) {
+
+	strncpy(m_spec, spec, sizeof(m_spec) - 1);
+	m_spec[sizeof(m_spec) - 1] = 0;
+	m_freq = 0.0;
+	m_ppm = 0.0;
+	m_snr = 20.0;
+	m_aci = m_dc = -HUGE_VAL;
+	m_drop = 0.0;
+	m_rate = m_sample_rate = GSM_RATE;
+	m_sps = 1.0;
+	m_sym = 0.0;
+	m_seed = m_state = 1;
+	m_last_sym = ~0u;
+	m_noise_pos = 0;
+	m_noise_amp = 0.0;
+	m_c0.amp = m_adj.amp = 0.0;
+	m_c0.on = m_adj.on = 0;
+	m_dc_offset = 0.0;
+	m_center_freq = 0.0;
+	m_freq_corr = 0.0;
+
+	m_cb = new circular_buffer(CB_LEN, sizeof(complex), 0);
+	m_noise = new complex[NOISE_LEN];
+}
+
+
+synth_source::~synth_source() {
+
+	delete[] m_noise;
+	delete m_cb;
+}
+
+
+/*
+ * xorshift32, plenty for bits and noise and cheap enough per symbol.
+ */
+unsigned int synth_source::rand() {
+
+	m_state ^= m_state << 13;
+	m_state ^= m_state >> 17;
+	m_state ^= m_state << 5;
+	return m_state;
+}
+
+
+int synth_source::open(unsigned int subdev) {
+
+	char *opt, *v;
+	unsigned int i;
+	double u1, u2, r;
+
+	if(strncmp(m_spec, "synth", 5) || (m_spec[5] && (m_spec[5] != ':'))) {
+		fprintf(stderr, "error: bad input: ``%s''\n", m_spec);
+		return -1;
+	}
+
+	for(opt = strtok(m_spec + 5, ":,"); opt; opt = strtok(0, ",")) {
+		if(!(v = strchr(opt, '='))) {
+			fprintf(stderr, "error: bad input option: ``%s''\n", opt);
+			return -1;
+		}
+		*v++ = 0;
+		if(!strcmp(opt, "freq"))
+			m_freq = strtod(v, 0);
+		else if(!strcmp(opt, "ppm"))
+			m_ppm = strtod(v, 0);
+		else if(!strcmp(opt, "snr"))
+			m_snr = strtod(v, 0);
+		else if(!strcmp(opt, "aci"))
+			m_aci = strtod(v, 0);
+		else if(!strcmp(opt, "dc"))
+			m_dc = strtod(v, 0);
+		else if(!strcmp(opt, "drop"))
+			m_drop = strtod(v, 0);
+		else if(!strcmp(opt, "rate"))
+			m_rate = strtod(v, 0);
+		else if(!strcmp(opt, "seed"))
+			m_seed = strtoul(v, 0, 0);
+		else {
+			fprintf(stderr, "error: unknown input option: ``%s''\n", opt);
+			return -1;
+		}
+	}
+	if(m_rate < GSM_RATE / 2) {
+		fprintf(stderr, "error: synth: rate %.0f too low\n", m_rate);
+		return -1;
+	}
+	if((m_drop < 0.0) || (m_drop > 1.0)) {
+		fprintf(stderr, "error: synth: drop is a probability\n");
+		return -1;
+	}
+	m_sample_rate = m_rate;
+	m_state = m_seed? m_seed : 1;
+
+	// unit power complex gaussian noise, Box-Muller
+	for(i = 0; i < NOISE_LEN; i++) {
+		u1 = (rand() + 1.0) / 4294967296.0;
+		u2 = rand() / 4294967296.0;
+		r = sqrt(-log(u1));
+		m_noise[i] = complex(r * cos(2 * M_PI * u2), r * sin(2 * M_PI * u2));
+	}
+	m_noise_amp = C0_AMP * pow(10.0, -m_snr / 20.0);
+
+	m_c0.amp = C0_AMP;
+	m_c0.z = 1.0;
+	m_adj.amp = C0_AMP * pow(10.0, m_aci / 20.0);
+	m_adj.z = 1.0;
+	m_dc_offset = complex(C0_AMP * pow(10.0, m_dc / 20.0), 0.0);
+
+	if(g_verbosity > 0) {
+		fprintf(stderr, "Synthetic C0 at %.1fMHz, %.3f ppm, SNR %.1f dB, "
+		   "rate %.0f\n", m_freq / 1e6, m_ppm, m_snr, m_rate);
+	}
+
+	return 0;
+}
+
+
+/*
+ * A carrier at offset from where we tuned, before the crystal error.  One
+ * sample moves it 2 pi offset / rate plus a quarter turn per symbol either
+ * way, and the symbols run slow by the crystal error.
+ */
+void synth_source::setup(carrier *c, double offset) {
+
+	double w, msk;
+
+	// the crystal puts the carrier ppm * fc low, the correction mixes it up
+	offset -= m_center_freq * (m_ppm - m_freq_corr) * 1e-6;
+
+	c->on = (c->amp > 0.0) && (fabs(offset) < m_sample_rate / 2);
+	if(!c->on && (c->amp > 0.0) && (c == &m_adj)) {
+		// the channel filter lets it through, aliased
+		offset = remainder(offset, m_sample_rate);
+		c->on = 1;
+	}
+	w = 2 * M_PI * offset / m_sample_rate;
+	msk = M_PI / 2 * m_sps;
+	c->rot[0] = std::polar(1.0f, (float)(w + msk));
+	c->rot[1] = std::polar(1.0f, (float)(w - msk));
+}
+
+
+void synth_source::update() {
+
+	m_sps = GSM_RATE / (m_sample_rate * (1.0 + m_ppm * 1e-6));
+	setup(&m_c0, m_freq - m_center_freq);
+	setup(&m_adj, m_freq + ADJ_SPACING - m_center_freq);
+	m_last_sym = ~0u;
+}
+
+
+int synth_source::tune(double freq) {
+
+	m_center_freq = freq;
+	if(m_freq == 0.0)
+		m_freq = freq;
+	update();
+	m_cb->flush();
+
+	return 1;
+}
+
+
+int synth_source::set_freq_correction(double ppm) {
+
+	m_freq_corr = ppm;
+	update();
+
+	return 0;
+}
+
+
+int synth_source::set_sample_rate(double rate) {
+
+	m_sample_rate = rate;
+	update();
+	m_cb->flush();
+
+	return 0;
+}
+
+
+int synth_source::reset_sample_rate() {
+
+	m_sample_rate = m_rate;
+	update();
+	m_cb->flush();
+
+	return 0;
+}
+
+
+float synth_source::sample_rate() {
+
+	return m_sample_rate;
+}
+
+
+bool synth_source::set_gain(float gain) {
+
+	return true;
+}
+
+
+void synth_source::start() {
+}
+
+
+void synth_source::stop() {
+}
+
+
+void synth_source::generate(complex *out, unsigned int len) {
+
+	unsigned int i, s, frame, mask = NOISE_LEN - 1;
+	complex z0 = m_c0.z, za = m_adj.z, r0 = m_c0.rot[0], ra = m_adj.rot[0];
+	complex *noise = m_noise;
+	unsigned int npos = rand();
+	float a0 = m_c0.on? m_c0.amp : 0.0f, aa = m_adj.on? m_adj.amp : 0.0f,
+	   an = m_noise_amp;
+	const double mf = FRAME_SYMS * MF_FRAMES;
+
+	for(i = 0; i < len; i++) {
+		s = (unsigned int)m_sym;
+		if(s != m_last_sym) {
+			m_last_sym = s;
+			frame = s / FRAME_SYMS;
+			if(!(frame % 10) && (frame < 50) && (s % FRAME_SYMS < FCCH_SYMS))
+				r0 = m_c0.rot[0];
+			else
+				r0 = m_c0.rot[rand() & 1];
+			ra = m_adj.rot[rand() & 1];
+		}
+		out[i] = a0 * z0 + aa * za + an * noise[(npos + i) & mask] +
+		   m_dc_offset;
+		z0 *= r0;
+		za *= ra;
+		if((m_sym += m_sps) >= mf)
+			m_sym -= mf;
+	}
+
+	// keep the oscillators on the unit circle
+	m_c0.z = z0 / std::abs(z0);
+	m_adj.z = za / std::abs(za);
+}
+
+
+int synth_source::fill(unsigned int num_samples, unsigned int *overrun_i) {
+
+	unsigned int space;
+	complex *c;
+	uint64_t t = instr_begin(INSTR_FILL);
+
+	while((m_cb->data_available() < num_samples) && (m_cb->space_available() >= BLOCK)) {
+		if((m_drop > 0.0) && (rand() < m_drop * 4294967295.0)) {
+			// the block never arrives
+			m_sym = fmod(m_sym + BLOCK * m_sps, FRAME_SYMS * MF_FRAMES);
+			m_c0.z = std::polar(1.0f, (float)(2 * M_PI * rand() / 4294967296.0));
+			m_adj.z = std::polar(1.0f, (float)(2 * M_PI * rand() / 4294967296.0));
+			continue;
+		}
+		c = (complex *)m_cb->poke(&space);
+		generate(c, BLOCK);
+		m_cb->wrote(BLOCK);
+		instr_count(INSTR_SAMPLES, BLOCK);
+	}
+
+	if(overrun_i)
+		*overrun_i = 0;
+
+	instr_end(INSTR_FILL, t);
+	return 0;
+}
+
+
+circular_buffer *synth_source::get_buffer() {
+
+	return m_cb;
+}
+
+
+/*
+ * Grow the buffer to hold at least len samples.  What it held is dropped and
+ * it may move, so call get_buffer() again afterwards.
+ */
+int synth_source::reserve(unsigned int len) {
+
+	circular_buffer *cb;
+
+	if(len <= m_cb->buf_len())
+		return 0;
+	try {
+		cb = new circular_buffer(len, sizeof(complex), 0);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		return -1;
+	}
+	delete m_cb;
+	m_cb = cb;
+	return 0;
+}
+
+
+int synth_source::flush(unsigned int flush_count) {
+
+	m_cb->flush();
+	if(flush_count) {
+		fill(flush_count * 512, 0);
+		m_cb->flush();
+	}
+
+	return 0;
+}
+
+
+/*
+ * Nothing to settle.
+ */
+void synth_source::report_settle() {
+}
+
+
+const char *synth_source::device_id() {
+
+	return "synth";
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * synth_source
+ *
+ * A made up base station for repeatable measurements.  The input is given
+ * as
+ *
+ *	synth:[freq=HZ][,ppm=PPM][,snr=DB][,aci=DB][,dc=DB][,drop=P]
+ *	   [,rate=HZ][,seed=N]
+ *
+ * There is one C0 carrier at freq, the first frequency tuned if not given.
+ * It is MSK at the GSM symbol rate, random bits except for the FCCH bursts
+ * in timeslot 0 of frames 0, 10, 20, 30 and 40 of each 51-multiframe, which
+ * are the tone at a quarter of the symbol rate.  The receiver's crystal is
+ * ppm fast: the carrier shows ppm * fc low and the symbols come slightly
+ * slow, and set_freq_correction() mixes it back as the receivers do.
+ *
+ * White noise is added for an SNR of snr dB over the delivered bandwidth.
+ * aci puts a carrier of random bits 200kHz above the C0 at aci dB relative
+ * to it; at rates too low to hold it, it comes through aliased, as through
+ * a poor channel filter.  dc adds a DC offset at dc dB relative to the C0.
+ * drop is the chance that a block of samples is lost, the signal jumps
+ * ahead and its phase is broken as with a lost USB packet.  rate defaults
+ * to the GSM rate.  The same seed gives the same samples.
+ *
+ * Everything is generated at the delivered rate, a complex multiply and
+ * a few adds per sample, so the detectors can be driven at tens of MS/s.
+ */
+
+#pragma once
+
+#include "usrp_complex.h"
+#include "circular_buffer.h"
+#include "sample_source.h"
+
+class synth_source : public sample_source {
+public:
+	synth_source(const char *spec);
+	~synth_source();
+
+	int open(unsigned int subdev);
+	int fill(unsigned int num_samples, unsigned int *overrun);
+	int tune(double freq);
+	int set_freq_correction(double ppm);
+	int set_sample_rate(double rate);
+	int reset_sample_rate();
+	bool set_gain(float gain);
+	void start();
+	void stop();
+	int flush(unsigned int flush_count = 0);
+	circular_buffer *get_buffer();
+	int reserve(unsigned int len);
+	void report_settle();
+	const char *device_id();
+
+	float sample_rate();
+
+private:
+	struct carrier {
+		complex		z;		// phase
+		complex		rot[2];		// per sample, for each bit
+		float		amp;
+		int		on;
+	};
+
+	unsigned int rand();
+	void setup(carrier *c, double offset);
+	void update();
+	void generate(complex *out, unsigned int len);
+
+	char		m_spec[BUFSIZ];
+	double		m_freq,
+			m_ppm,
+			m_snr,
+			m_aci,
+			m_dc,
+			m_drop,
+			m_rate,
+			m_sample_rate,
+			m_sps,		// symbols per sample
+			m_sym;		// position in the multiframe
+	unsigned int	m_seed,
+			m_state,
+			m_last_sym,
+			m_noise_pos;
+
+	carrier		m_c0,
+			m_adj;
+	complex		m_dc_offset,
+			*m_noise;
+	float		m_noise_amp;
+
+	circular_buffer	*m_cb;
+
+	static const unsigned int	CB_LEN		= (16 * 16384);
+	static const unsigned int	BLOCK		= 4096;
+	static const unsigned int	NOISE_LEN	= (1 << 16);
+};
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "instr.h"
+
+int g_trace = 0;
+int g_trace_print = 0;		// point events printed as they happen
+
+/*
+ * 64K events, 2MB, per thread.
+ */
+static const unsigned int RING_BITS = 16;
+static const unsigned int RING_LEN = 1 << RING_BITS;
+
+static const char *point_name[TRACE_IDS - TRACE_ERROR_LIMIT] = {
+	"error_limit", "fcch_candidate", "fcch_found"
+};
+
+struct trace_ring {
+	trace_ring	*next;
+	trace_ring_hdr	hdr;
+	uint64_t	head;		// events ever written
+	trace_event	ev[RING_LEN];
+};
+
+static trace_ring	*s_rings;
+static uint32_t		s_nrings;
+static char		s_path[BUFSIZ];
+static int		s_print;
+static uint64_t		s_start;
+
+static __thread trace_ring	*t_ring;
+
+
+/*
+ * This thread's ring, made and linked in on its first event.
+ */
+static trace_ring *ring() {
+
+	trace_ring *r;
+
+	if(t_ring)
+		return t_ring;
+	if(!(r = (trace_ring *)calloc(1, sizeof(trace_ring))))
+		return 0;
+	r->hdr.id = __atomic_fetch_add(&s_nrings, 1, __ATOMIC_RELAXED);
+	snprintf(r->hdr.name, sizeof(r->hdr.name), "thread %u", r->hdr.id);
+	r->next = __atomic_load_n(&s_rings, __ATOMIC_RELAXED);
+	while(!__atomic_compare_exchange_n(&s_rings, &r->next, r, 1,
+	   __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	t_ring = r;
+
+	return r;
+}
+
+
+void trace_put(unsigned int kind, unsigned int id, uint64_t ts, uint32_t chan,
+   float v0, float v1, float v2) {
+
+	trace_ring *r;
+	trace_event *e;
+	uint64_t h;
+
+	if(!(r = ring()))
+		return;
+	h = r->head;
+	e = &r->ev[h & (RING_LEN - 1)];
+	e->ts = ts;
+	e->kind = kind;
+	e->id = id;
+	e->chan = chan;
+	e->v[0] = v0;
+	e->v[1] = v1;
+	e->v[2] = v2;
+	__atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * The debug line a point event stands in for.
+ */
+static void print_point(unsigned int id, const float *v) {
+
+	switch(id) {
+		case TRACE_ERROR_LIMIT:
+			printf("debug: error limit: %.1lf\n", v[0]);
+			break;
+
+		case TRACE_FCCH_CANDIDATE:
+			printf("debug: %.0f\t%f\t%f\n", v[0], v[1], v[2]);
+			break;
+
+		case TRACE_FCCH_FOUND:
+			printf("debug: fcch_detector finished -----------------------------\n");
+			break;
+	}
+}
+
+
+void trace_point(unsigned int id, float v0, float v1, float v2) {
+
+	float v[3] = { v0, v1, v2 };
+
+	if(g_trace_print)
+		print_point(id, v);
+	if(g_trace)
+		trace_put(TRACE_POINT, id, instr_now(), instr_channel_key(), v0, v1, v2);
+}
+
+
+void trace_thread_name(const char *name) {
+
+	trace_ring *r;
+
+	if(g_trace && (r = ring())) {
+		strncpy(r->hdr.name, name, sizeof(r->hdr.name) - 1);
+		r->hdr.name[sizeof(r->hdr.name) - 1] = 0;
+	}
+}
+
+
+const char *trace_name(unsigned int id) {
+
+	if(id < INSTR_STAGES)
+		return instr_stage_name(id);
+	if((id >= TRACE_ERROR_LIMIT) && (id < TRACE_IDS))
+		return point_name[id - TRACE_ERROR_LIMIT];
+	return "?";
+}
+
+
+/*
+ * Start recording.  The rings go to path at exit, print_debug prints the
+ * point events then.  Without a path print_debug prints them as they happen
+ * instead, and there is nothing to record.
+ */
+int trace_enable(const char *path, int print_debug) {
+
+	FILE *fp;
+
+	if(!path) {
+		g_trace_print = print_debug;
+		return 0;
+	}
+
+	// find out now rather than at exit
+	if(!(fp = fopen(path, "w"))) {
+		perror(path);
+		return -1;
+	}
+	fclose(fp);
+	strncpy(s_path, path, sizeof(s_path) - 1);
+	s_print = print_debug;
+	if(!g_trace) {
+		s_start = instr_now();
+		g_trace = 1;
+		atexit(trace_dump);
+	}
+
+	return 0;
+}
+
+
+/*
+ * The last count events of r, oldest first, into out.
+ */
+static unsigned int ring_events(trace_ring *r, trace_event *out, uint64_t *written) {
+
+	uint64_t h = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE), i, n;
+
+	n = (h < RING_LEN)? h : RING_LEN;
+	for(i = 0; i < n; i++)
+		out[i] = r->ev[(h - n + i) & (RING_LEN - 1)];
+	*written = h;
+
+	return n;
+}
+
+
+static int cmp_ts(const void *a, const void *b) {
+
+	uint64_t ta = ((const trace_event *)a)->ts,
+	   tb = ((const trace_event *)b)->ts;
+
+	return (ta > tb) - (ta < tb);
+}
+
+
+static void print_debug() {
+
+	trace_event *ev, *p = 0, *q;
+	trace_ring *r;
+	unsigned int i, n, np = 0;
+	uint64_t written;
+
+	if(!(ev = (trace_event *)malloc(RING_LEN * sizeof(trace_event))))
+		return;
+	for(r = s_rings; r; r = r->next) {
+		n = ring_events(r, ev, &written);
+		for(i = 0; i < n; i++) {
+			if(ev[i].kind != TRACE_POINT)
+				continue;
+			if(!(np % 1024)) {
+				if(!(q = (trace_event *)realloc(p, (np + 1024) * sizeof(trace_event))))
+					break;
+				p = q;
+			}
+			p[np++] = ev[i];
+		}
+	}
+	free(ev);
+
+	qsort(p, np, sizeof(trace_event), cmp_ts);
+	for(i = 0; i < np; i++)
+		print_point(p[i].id, p[i].v);
+	free(p);
+}
+
+
+static int write_rings(const char *path) {
+
+	trace_file_hdr fh;
+	trace_ring_hdr rh;
+	trace_event *ev;
+	trace_ring *r;
+	FILE *fp;
+	int ok = 1;
+
+	if(!(fp = fopen(path, "w"))) {
+		perror(path);
+		return -1;
+	}
+	if(!(ev = (trace_event *)malloc(RING_LEN * sizeof(trace_event)))) {
+		fclose(fp);
+		return -1;
+	}
+
+	// the header goes in again once the rings are counted
+	memset(&fh, 0, sizeof(fh));
+	memcpy(fh.magic, TRACE_MAGIC, sizeof(fh.magic));
+	fh.event_len = sizeof(trace_event);
+	fh.start = s_start;
+	ok = (fwrite(&fh, sizeof(fh), 1, fp) == 1);
+
+	for(r = __atomic_load_n(&s_rings, __ATOMIC_ACQUIRE); ok && r; r = r->next) {
+		fh.rings++;
+		rh = r->hdr;
+		rh.count = ring_events(r, ev, &rh.written);
+		ok = (fwrite(&rh, sizeof(rh), 1, fp) == 1) &&
+		   (fwrite(ev, sizeof(trace_event), rh.count, fp) == rh.count);
+		if(rh.written > rh.count) {
+			fprintf(stderr, "warning: trace: %s lost its first %llu "
+			   "events\n", rh.name,
+			   (unsigned long long)(rh.written - rh.count));
+		}
+	}
+	free(ev);
+	if(ok)
+		ok = !fseek(fp, 0, SEEK_SET) && (fwrite(&fh, sizeof(fh), 1, fp) == 1);
+
+	if((fclose(fp) != 0) || !ok) {
+		fprintf(stderr, "error: trace: writing %s failed\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+ * Runs at exit.  Threads still running may add to their rings meanwhile,
+ * an event they are writing as its slot is read can come out torn.
+ */
+void trace_dump() {
+
+	if(!g_trace)
+		return;
+	g_trace = 0;
+
+	write_rings(s_path);
+	if(s_print)
+		print_debug();
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2026, kalibrate contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * trace
+ *
+ * A timeline of what each thread did.  Every thread that records gets its
+ * own ring of fixed size events, written only by that thread: the event
+ * goes in, then the head moves on with a release store, no lock and no
+ * system call.  A full ring overwrites its oldest events.  The instr
+ * probes put in begin and end events for their stages, tagged with the
+ * channel the thread is on, trace_debug() puts in a point event with a
+ * few values.
+ *
+ * At exit the rings are written to the trace file, if there is one,
+ *
+ *	trace_file_hdr
+ *	per ring: trace_ring_hdr, then its events oldest first
+ *
+ * which kal_trace turns into Chrome trace format JSON.  With print_debug
+ * set, the point events are also printed at exit, in time order, as the
+ * debug lines they stand in for; printing them as they happened would upset
+ * the timing the trace is taken for.  Without a trace file there is nothing
+ * to keep the timing for, print_debug prints each point event as it happens
+ * and nothing is recorded.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define TRACE_MAGIC	"kaltrc01"
+
+enum {
+	TRACE_BEGIN,
+	TRACE_END,
+	TRACE_POINT
+};
+
+/*
+ * Point events, numbered after the instr stages.
+ */
+enum {
+	TRACE_ERROR_LIMIT = 32,		// v[0] limit
+	TRACE_FCCH_CANDIDATE,		// v[0] symbols, v[1] peak/mean, v[2] offset
+	TRACE_FCCH_FOUND,
+	TRACE_IDS
+};
+
+struct trace_event {
+	uint64_t	ts;		// ns, monotonic clock
+	uint8_t		kind;
+	uint8_t		id;		// instr stage or point event
+	uint16_t	pad;
+	uint32_t	chan;		// instr channel key, freq / 100 + 1
+	float		v[4];
+};
+
+struct trace_file_hdr {
+	char		magic[8];
+	uint32_t	rings,
+			event_len;
+	uint64_t	start;		// ns, when tracing was enabled
+};
+
+struct trace_ring_hdr {
+	uint32_t	id;
+	char		name[28];
+	uint64_t	written,	// ever, the ring keeps the last count
+			count;
+};
+
+extern int g_trace, g_trace_print;
+
+int trace_enable(const char *path, int print_debug);
+void trace_thread_name(const char *name);
+void trace_put(unsigned int kind, unsigned int id, uint64_t ts, uint32_t chan, float v0 = 0, float v1 = 0, float v2 = 0);
+void trace_point(unsigned int id, float v0, float v1, float v2);
+const char *trace_name(unsigned int id);
+void trace_dump();
+
+static inline void trace_debug(unsigned int id, float v0 = 0, float v1 = 0, float v2 = 0) {
+
+	if(g_trace | g_trace_print)
+		trace_point(id, v0, v1, v2);
+}
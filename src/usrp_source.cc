@@ -36,8 +36,11 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <complex>
+#include <stdexcept>
 
 #include "usrp_source.h"
+#include "file_source.h"
+#include "instr.h"
 
 extern int g_verbosity;
 
@@ -46,39 +49,59 @@ extern int g_verbosity;
 inline double round(double x) { return floor(x + 0.5); }
 #endif
 
-usrp_source::usrp_source(float sample_rate, long int fpga_master_clock_freq) {
+static const double GSM_RATE = 1625000.0 / 6.0;
+
+usrp_source::usrp_source(float sample_rate, long int fpga_master_clock_freq,
+   int loglevel) {
 
 	m_fpga_master_clock_freq = fpga_master_clock_freq;
 	m_desired_sample_rate = sample_rate;
 	m_sample_rate = 0.0;
-	m_decimation = 0;
+	m_center_freq = 0.0;
+	m_freq_corr = 0.0;
+	m_gain = 0.0;
+	dev = 0;
+	m_rec = 0;
 	m_cb = new circular_buffer(CB_LEN, sizeof(complex), 0);
 
 	pthread_mutex_init(&m_u_mutex, 0);
+
+	calculate_decimation();
+	m_dec = new decimator(m_decimation);
 }
 
 
-usrp_source::usrp_source(unsigned int decimation, long int fpga_master_clock_freq) {
+/*
+ * decimation is the hardware rate as a multiple of the GSM rate.
+ */
+usrp_source::usrp_source(unsigned int decimation, long int fpga_master_clock_freq,
+   int loglevel) {
 
 	m_fpga_master_clock_freq = fpga_master_clock_freq;
+	m_desired_sample_rate = decimation * GSM_RATE;
 	m_sample_rate = 0.0;
+	m_center_freq = 0.0;
+	m_freq_corr = 0.0;
+	m_gain = 0.0;
+	dev = 0;
+	m_rec = 0;
 	m_cb = new circular_buffer(CB_LEN, sizeof(complex), 0);
 
 	pthread_mutex_init(&m_u_mutex, 0);
 
-	m_decimation = decimation & ~1;
-	if(m_decimation < 4)
-		m_decimation = 4;
-	if(m_decimation > 256)
-		m_decimation = 256;
+	calculate_decimation();
+	m_dec = new decimator(m_decimation);
 }
 
 
 usrp_source::~usrp_source() {
 
 	stop();
+	delete m_rec;
+	delete m_dec;
 	delete m_cb;
-	rtlsdr_close(dev);
+	if(dev)
+		rtlsdr_close(dev);
 	pthread_mutex_destroy(&m_u_mutex);
 }
 
@@ -97,17 +120,95 @@ void usrp_source::start() {
 }
 
 
+/*
+ * The RTL2832 only runs between 225k and 300k or 900k and 3.2M samples per
+ * second.  Pick the multiple of the GSM rate closest to the one desired that
+ * it can do; the decimator takes it back down to the GSM rate.
+ */
 void usrp_source::calculate_decimation() {
 
-	float decimation_f;
+	m_decimation = (unsigned int)round(m_desired_sample_rate / GSM_RATE);
 
-//	decimation_f = (float)m_u_rx->fpga_master_clock_freq() / m_desired_sample_rate;
-	m_decimation = (unsigned int)round(decimation_f) & ~1;
-
-	if(m_decimation < 4)
+	if(m_decimation < 1)
+		m_decimation = 1;
+	if((m_decimation > 1) && (m_decimation < 4))
 		m_decimation = 4;
-	if(m_decimation > 256)
-		m_decimation = 256;
+	if(m_decimation > 11)
+		m_decimation = 11;
+}
+
+
+/*
+ * The RTL2832 resamples its 28.8MHz crystal by a 22-bit fractional ratio,
+ * the rate we actually get differs slightly from the one requested.
+ */
+static double rtl_actual_rate(uint32_t rate) {
+
+	const double xtal = 28800000.0 * (1 << 22);
+	uint32_t ratio;
+
+	ratio = (uint32_t)(xtal / rate) & 0x0ffffffc;
+	ratio |= (ratio & 0x08000000) << 1;
+
+	return xtal / ratio;
+}
+
+
+/*
+ * Change the hardware sample rate.  The stream is no longer decimated to the
+ * GSM rate.  Samples already in the buffer were taken at the old rate and are
+ * dropped.
+ */
+int usrp_source::set_sample_rate(double rate) {
+
+	int r;
+
+	pthread_mutex_lock(&m_u_mutex);
+	r = rtlsdr_set_sample_rate(dev, (uint32_t)rate);
+	if(r < 0) {
+		pthread_mutex_unlock(&m_u_mutex);
+		fprintf(stderr, "error: failed to set sample rate %.0f\n", rate);
+		return -1;
+	}
+	m_sample_rate = rtl_actual_rate((uint32_t)rate);
+	m_decimation = 1;
+	update_nco();
+	rtlsdr_reset_buffer(dev);
+	pthread_mutex_unlock(&m_u_mutex);
+
+	m_cb->flush();
+
+	return 0;
+}
+
+
+/*
+ * Go back to the rate chosen at construction, decimated to the GSM rate.
+ */
+int usrp_source::reset_sample_rate() {
+
+	uint32_t samp_rate;
+	int r;
+
+	calculate_decimation();
+	samp_rate = (uint32_t)round(m_decimation * GSM_RATE);
+
+	pthread_mutex_lock(&m_u_mutex);
+	r = rtlsdr_set_sample_rate(dev, samp_rate);
+	if(r < 0) {
+		pthread_mutex_unlock(&m_u_mutex);
+		fprintf(stderr, "error: failed to set sample rate %u\n", samp_rate);
+		return -1;
+	}
+	m_sample_rate = rtl_actual_rate(samp_rate) / m_decimation;
+	m_dec->reset();
+	update_nco();
+	rtlsdr_reset_buffer(dev);
+	pthread_mutex_unlock(&m_u_mutex);
+
+	m_cb->flush();
+
+	return 0;
 }
 
 
@@ -121,15 +222,27 @@ float usrp_source::sample_rate() {
 int usrp_source::tune(double freq) {
 
 	int r = 0;
+	uint64_t t;
 
 	pthread_mutex_lock(&m_u_mutex);
 	if (freq != m_center_freq) {
+		t = instr_begin(INSTR_TUNE);
+		m_settle.tune_start();
 		r = rtlsdr_set_center_freq(dev, (uint32_t)freq);
 
+		// what the dongle queued was sampled at the old frequency
+		rtlsdr_reset_buffer(dev);
+		m_settle.tune_done();
+
 		if (r < 0)
 			fprintf(stderr, "Tuning to %u Hz failed!\n", (uint32_t)freq);
 		else
 			m_center_freq = freq;
+
+		// the filter history is from the old frequency
+		m_dec->reset();
+		update_nco();
+		instr_end(INSTR_TUNE, t);
 	}
 
 	pthread_mutex_unlock(&m_u_mutex);
@@ -137,9 +250,26 @@ int usrp_source::tune(double freq) {
 	return 1; //(r < 0) ? 0 : 1;
 }
 
-int usrp_source::set_freq_correction(int ppm) {
+/*
+ * The correction is applied by mixing in fill(), the tuner is left alone.
+ */
+int usrp_source::set_freq_correction(double ppm) {
+
 	m_freq_corr = ppm;
-	return rtlsdr_set_freq_correction(dev, ppm);
+	update_nco();
+
+	return 0;
+}
+
+
+/*
+ * A crystal ppm fast puts the carrier ppm * fc below where we tuned, mix it
+ * back up.  The NCO runs at the hardware rate, ahead of the decimator.
+ */
+void usrp_source::update_nco() {
+
+	if(m_sample_rate > 0.0)
+		m_nco.set_freq(m_center_freq * m_freq_corr * 1e-6, m_sample_rate * m_decimation);
 }
 
 bool usrp_source::set_antenna(int antenna) {
@@ -157,6 +287,8 @@ bool usrp_source::set_gain(float gain) {
 
 	fprintf(stderr, "Setting gain: %.1f dB\n", gain/10);
 	r = rtlsdr_set_tuner_gain(dev, g);
+	if(r >= 0)
+		m_gain = gain;
 
 	return (r < 0) ? 0 : 1;
 }
@@ -168,9 +300,11 @@ bool usrp_source::set_gain(float gain) {
 int usrp_source::open(unsigned int subdev) {
 	int i, r, device_count, count;
 	uint32_t dev_index = subdev;
-	uint32_t samp_rate = 270833;
+	char manufact[256], product[256], serial[256];
+	uint32_t samp_rate = (uint32_t)round(m_decimation * GSM_RATE);
 
-	m_sample_rate = 270833.002142;
+	m_sample_rate = rtl_actual_rate(samp_rate) / m_decimation;
+	update_nco();
 
 	device_count = rtlsdr_get_device_count();
 	if (!device_count) {
@@ -193,10 +327,20 @@ int usrp_source::open(unsigned int subdev) {
 		exit(1);
 	}
 
+	// by serial number where it has one that fits, else by index
+	if (rtlsdr_get_device_usb_strings(dev_index, manufact, product, serial) ||
+	   !serial[0] || (snprintf(m_device_id, sizeof(m_device_id), "rtl-%s",
+	   serial) >= (int)sizeof(m_device_id)))
+		snprintf(m_device_id, sizeof(m_device_id), "rtl-%u", dev_index);
+
 	/* Set the sample rate */
 	r = rtlsdr_set_sample_rate(dev, samp_rate);
 	if (r < 0)
 		fprintf(stderr, "WARNING: Failed to set sample rate.\n");
+	if(g_verbosity > 0) {
+		fprintf(stderr, "Sample rate %u, decimation %u\n", samp_rate,
+		   m_decimation);
+	}
 
 	/* Reset endpoint before we start reading from it (mandatory) */
 	r = rtlsdr_reset_buffer(dev);
@@ -216,47 +360,75 @@ int usrp_source::open(unsigned int subdev) {
 
 int usrp_source::fill(unsigned int num_samples, unsigned int *overrun_i) {
 
-	unsigned char ubuf[USB_PACKET_SIZE];
-	unsigned int i, j, space, overruns = 0;
+	unsigned char packet[USB_PACKET_SIZE], *ubuf;
+	unsigned int i, k, n, space, max_out, overruns = 0;
 	complex *c;
 	int n_read;
+	uint64_t t = instr_begin(INSTR_FILL), t_read;
+
+	max_out = (m_decimation > 1)? m_dec->max_out(USB_PACKET_SIZE / 2) : USB_PACKET_SIZE / 2;
+	while((m_cb->data_available() < num_samples) && (m_cb->space_available() >= max_out)) {
 
-	while((m_cb->data_available() < num_samples) && (m_cb->space_available() > 0)) {
+		// when recording, read straight into the recorder's chunk
+		ubuf = 0;
+		if(m_rec) {
+			m_rec->set_meta(m_center_freq, m_sample_rate * m_decimation, m_gain);
+			ubuf = (unsigned char *)m_rec->poke(USB_PACKET_SIZE / 2);
+		}
+		if(!ubuf)
+			ubuf = packet;
 
 		// read one usb packet from the usrp
 		pthread_mutex_lock(&m_u_mutex);
 
-		if (rtlsdr_read_sync(dev, ubuf, sizeof(ubuf), &n_read) < 0) {
+		t_read = instr_begin(INSTR_READ);
+		if (rtlsdr_read_sync(dev, ubuf, USB_PACKET_SIZE, &n_read) < 0) {
 			pthread_mutex_unlock(&m_u_mutex);
 			fprintf(stderr, "error: usrp_standard_rx::read\n");
+			instr_end(INSTR_FILL, t);
 			return -1;
 		}
+		instr_end(INSTR_READ, t_read);
 
 		pthread_mutex_unlock(&m_u_mutex);
 
-		// write complex<short> input to complex<float> output
+		// drop what was sampled before the last retune settled
+		n = n_read / 2;
+		instr_count(INSTR_SAMPLES, n);
+		k = m_settle.skip(ubuf, n, m_sample_rate * m_decimation);
+		if(m_rec)
+			m_rec->wrote(n, k);
+		if(k == n)
+			continue;
+		n -= k;
+
+		// write complex<unsigned char> input to corrected complex<float> output
 		c = (complex *)m_cb->poke(&space);
 
-		// set space to number of complex items to copy
-		space = n_read / 2;
-
-		// write data
-		for(i = 0, j = 0; i < space; i += 1, j += 2)
-			c[i] = complex((ubuf[j] - 127) * 256, (ubuf[j + 1] - 127) * 256);
+		if(m_decimation > 1) {
+			// convert into the decimator, filter into the cb
+			m_nco.mix(ubuf + 2 * k, m_dec->poke(n), n);
+			i = m_dec->wrote(n, c);
+		} else {
+			m_nco.mix(ubuf + 2 * k, c, n);
+			i = n;
+		}
 
 		// update cb
 		m_cb->wrote(i);
 	}
 
 	// if the cb is full, we left behind data from the usb packet
-	if(m_cb->space_available() == 0) {
+	if(m_cb->data_available() < num_samples) {
 		fprintf(stderr, "warning: local overrun\n");
 		overruns++;
+		instr_count(INSTR_OVERRUNS);
 	}
 
 	if(overrun_i)
 		*overrun_i = overruns;
 
+	instr_end(INSTR_FILL, t);
 	return 0;
 }
 
@@ -278,6 +450,25 @@ int usrp_source::read(complex *buf, unsigned int num_samples,
 }
 
 
+/*
+ * Tee every sample read from now on to path, in the tuner's unsigned 8 bit
+ * format.
+ */
+int usrp_source::record(const char *path) {
+
+	if(m_rec)
+		return -1;
+	m_rec = new iq_recorder(path, file_source::FMT_CU8, 2, device_id());
+	if(m_rec->open()) {
+		delete m_rec;
+		m_rec = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+
 /*
  * Don't hold a lock on this and use the usrp at the same time.
  */
@@ -287,11 +478,58 @@ circular_buffer *usrp_source::get_buffer() {
 }
 
 
+/*
+ * Grow the buffer to hold at least len samples.  What it held is dropped and
+ * it may move, so call get_buffer() again afterwards.
+ */
+int usrp_source::reserve(unsigned int len) {
+
+	circular_buffer *cb;
+
+	if(len <= m_cb->buf_len())
+		return 0;
+	try {
+		cb = new circular_buffer(len, sizeof(complex), 0);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		return -1;
+	}
+	delete m_cb;
+	m_cb = cb;
+	return 0;
+}
+
+
+/*
+ * Empty the buffer.  Samples taken before the last retune settled are
+ * dropped by fill() as they arrive.  A flush_count additionally discards
+ * that many FLUSH_SIZE reads, as flushing used to.
+ */
 int usrp_source::flush(unsigned int flush_count) {
 
+	uint64_t t = instr_begin(INSTR_FLUSH);
+
 	m_cb->flush();
-	fill(flush_count * FLUSH_SIZE, 0);
-	m_cb->flush();
+	if(flush_count) {
+		fill(flush_count * FLUSH_SIZE, 0);
+		m_cb->flush();
+	}
 
+	instr_end(INSTR_FLUSH, t);
 	return 0;
 }
+
+
+void usrp_source::report_settle() {
+
+	m_settle.report();
+}
+
+
+/*
+ * Names the device across runs, valid after open().
+ */
+const char *usrp_source::device_id() {
+
+	return m_device_id;
+}
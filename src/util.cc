@@ -63,20 +63,6 @@ void display_freq(float f) {
 }
 
 
-void sort(float *b, unsigned int len) {
-
-	for(unsigned int i = 0; i < len; i++) {
-		for(unsigned int j = i + 1; j < len; j++) {
-			if(b[j] < b[i]) {
-				float t = b[i];
-				b[i] = b[j];
-				b[j] = t;
-			}
-		}
-	}
-}
-
-
 double avg(float *b, unsigned int len, float *stddev) {
 
 	unsigned int i;
@@ -95,3 +81,24 @@ double avg(float *b, unsigned int len, float *stddev) {
 
 	return a;
 }
+
+
+/*
+ * Blackman windowed sinc lowpass with cutoff fc (cycles per sample),
+ * normalized to unity gain at DC.
+ */
+void lowpass(float *h, unsigned int len, double fc) {
+
+	unsigned int i;
+	double x, w, sum = 0.0;
+
+	for(i = 0; i < len; i++) {
+		x = i - (len - 1) / 2.0;
+		w = 0.42 - 0.5 * cos(2 * M_PI * i / (len - 1)) +
+		   0.08 * cos(4 * M_PI * i / (len - 1));
+		h[i] = w * ((fabs(x) < 1e-9)? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x));
+		sum += h[i];
+	}
+	for(i = 0; i < len; i++)
+		h[i] /= sum;
+}
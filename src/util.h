@@ -26,5 +26,5 @@
  */
 
 void display_freq(float f);
-void sort(float *b, unsigned int len);
 double avg(float *b, unsigned int len, float *stddev);
+void lowpass(float *h, unsigned int len, double fc);
@@ -37,10 +37,13 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <complex>
+#include <stdexcept>
 
 #include <assert.h>
 
 #include "xtrx_source.h"
+#include "file_source.h"
+#include "instr.h"
 
 extern int g_verbosity;
 
@@ -54,7 +57,12 @@ xtrx_source::xtrx_source(float sample_rate, long int fpga_master_clock_freq, int
 	m_fpga_master_clock_freq = fpga_master_clock_freq;
 	m_desired_sample_rate = sample_rate;
 	m_sample_rate = 0.0;
+	m_center_freq = 0.0;
+	m_freq_corr = 0.0;
+	m_gain = 0.0;
+	m_rec = 0;
 	m_decimation = 0;
+	m_running = 0;
 	m_cb = new circular_buffer(CB_LEN, sizeof(complex), 0);
 
 	pthread_mutex_init(&m_u_mutex, 0);
@@ -67,6 +75,11 @@ xtrx_source::xtrx_source(unsigned int decimation, long int fpga_master_clock_fre
 
 	m_fpga_master_clock_freq = fpga_master_clock_freq;
 	m_sample_rate = 0.0;
+	m_center_freq = 0.0;
+	m_freq_corr = 0.0;
+	m_gain = 0.0;
+	m_rec = 0;
+	m_running = 0;
 	m_cb = new circular_buffer(CB_LEN, sizeof(complex), 0);
 
 	pthread_mutex_init(&m_u_mutex, 0);
@@ -84,6 +97,7 @@ xtrx_source::xtrx_source(unsigned int decimation, long int fpga_master_clock_fre
 xtrx_source::~xtrx_source() {
 
 	stop();
+	delete m_rec;
 	delete m_cb;
 	xtrx_close(dev);
 	pthread_mutex_destroy(&m_u_mutex);
@@ -95,14 +109,30 @@ void xtrx_source::stop() {
 	pthread_mutex_lock(&m_u_mutex);
 
 	xtrx_stop(dev, XTRX_RX);
+	m_running = 0;
 
 	pthread_mutex_unlock(&m_u_mutex);
 }
 
 
+/*
+ * Start streaming.  Does nothing when the device is already streaming, so
+ * callers flush() afterwards to drop what was queued before.
+ */
 void xtrx_source::start() {
 
 	pthread_mutex_lock(&m_u_mutex);
+	if(!m_running)
+		run();
+	pthread_mutex_unlock(&m_u_mutex);
+}
+
+
+/*
+ * (Re)start the receive stream, which empties the DMA ring.  Called with
+ * m_u_mutex held.
+ */
+void xtrx_source::run() {
 
 	xtrx_stop(dev, XTRX_RX);
 
@@ -120,8 +150,43 @@ void xtrx_source::start() {
 	int r = xtrx_run_ex(dev, &params);
 	if (r < 0)
 		fprintf(stderr, "WARNING: Failed to run streaming.\n");
+	else
+		m_running = 1;
+}
+
+
+/*
+ * Change the sample rate.  This stops streaming, call start() again
+ * afterwards.  Samples already in the buffer are dropped.
+ */
+int xtrx_source::set_sample_rate(double rate) {
+
+	double actual, abw;
+	int r;
+
+	pthread_mutex_lock(&m_u_mutex);
+	xtrx_stop(dev, XTRX_RX);
+	m_running = 0;
+	r = xtrx_set_samplerate(dev, 0, rate, 0.0, 0, NULL, &actual, NULL);
+	if(r < 0) {
+		pthread_mutex_unlock(&m_u_mutex);
+		fprintf(stderr, "error: failed to set sample rate %.0f\n", rate);
+		return -1;
+	}
+	if(rate != actual) {
+		fprintf(stderr, "NOTE: Requested %.3f got %.3f\n", rate, actual);
+	}
+	m_sample_rate = actual;
+	update_nco();
 
+	r = xtrx_tune_rx_bandwidth(dev, XTRX_CH_AB, rate, &abw);
+	if (r < 0)
+		fprintf(stderr, "WARNING: Failed to set bandwidth.\n");
 	pthread_mutex_unlock(&m_u_mutex);
+
+	m_cb->flush();
+
+	return 0;
 }
 
 
@@ -135,15 +200,25 @@ float xtrx_source::sample_rate() {
 int xtrx_source::tune(double freq) {
 	double actual;
 	int r = 0;
+	uint64_t t;
 
 	pthread_mutex_lock(&m_u_mutex);
 	if (freq != m_center_freq) {
+		t = instr_begin(INSTR_TUNE);
+		m_settle.tune_start();
 		r = xtrx_tune(dev, XTRX_TUNE_RX_FDD, freq, &actual);
 
+		// what the DMA ring holds was sampled at the old frequency
+		if(m_running)
+			run();
+		m_settle.tune_done();
+
 		if (r < 0)
 			fprintf(stderr, "Tuning to %f Hz failed!\n", freq);
 		else
 			m_center_freq = freq;
+		update_nco();
+		instr_end(INSTR_TUNE, t);
 	}
 
 	pthread_mutex_unlock(&m_u_mutex);
@@ -151,13 +226,26 @@ int xtrx_source::tune(double freq) {
 	return 1; //(r < 0) ? 0 : 1;
 }
 
-int xtrx_source::set_freq_correction(int ppm) {
+/*
+ * The correction is applied by mixing in fill(), the LO is left alone.
+ */
+int xtrx_source::set_freq_correction(double ppm) {
+
 	m_freq_corr = ppm;
-	//return rtlsdr_set_freq_correction(dev, ppm);
-	//abort();
-	fprintf(stderr, "TODO: Need to apply correction of %d ppm\n", ppm);
+	update_nco();
 
-	return 1;
+	return 0;
+}
+
+
+/*
+ * A reference ppm fast puts the carrier ppm * fc below where we tuned, mix it
+ * back up.
+ */
+void xtrx_source::update_nco() {
+
+	if(m_sample_rate > 0.0)
+		m_nco.set_freq(m_center_freq * m_freq_corr * 1e-6, m_sample_rate);
 }
 
 bool xtrx_source::set_antenna(int antenna) {
@@ -173,31 +261,22 @@ bool xtrx_source::set_gain(float gain) {
 	fprintf(stderr, "Setting gain: %.1f dB\n", gain);
 	//r = rtlsdr_set_tuner_gain(dev, g);
 	r = xtrx_set_gain(dev, XTRX_CH_AB, XTRX_RX_LNA_GAIN, gain, &actual);
+	if(r >= 0)
+		m_gain = actual;
 
 	return (r < 0) ? 0 : 1;
 }
 
 
 /*
- * open() should be called before multiple threads access xtrx_source.
+ * Run at the GSM rate, as after open().
  */
-int xtrx_source::open(unsigned int subdev) {
+void xtrx_source::set_gsm_rate() {
 	int r;
-	uint32_t dev_index = subdev;
 	double samp_rate = 13e6 / 48.0;
 	double actual, abw;
 	double master = 0;
 
-	r = xtrx_open("/dev/xtrx0", m_loglevel, &dev);
-	if (r < 0) {
-		fprintf(stderr, "Failed to open xtrx device %d\n", dev_index);
-		exit(1);
-	}
-
-	if (m_fpga_master_clock_freq != 0) {
-		xtrx_set_ref_clk(dev, m_fpga_master_clock_freq, XTRX_CLKSRC_INT);
-	}
-
 	const bool extra_decim = false;
 	if (m_decimation > 0) {
 		master = 4 * samp_rate * m_decimation * (extra_decim ? 2 : 1);
@@ -214,10 +293,51 @@ int xtrx_source::open(unsigned int subdev) {
 	}
 
 	m_sample_rate = actual / (extra_decim ? 2 : 1);
+	update_nco();
 
 	r = xtrx_tune_rx_bandwidth(dev, XTRX_CH_AB, 2e6, &abw);
 	if (r < 0)
 		fprintf(stderr, "WARNING: Failed to set bandwidth.\n");
+}
+
+
+/*
+ * Go back to the GSM rate after set_sample_rate().  This stops streaming, call
+ * start() again afterwards.
+ */
+int xtrx_source::reset_sample_rate() {
+
+	pthread_mutex_lock(&m_u_mutex);
+	xtrx_stop(dev, XTRX_RX);
+	m_running = 0;
+	set_gsm_rate();
+	pthread_mutex_unlock(&m_u_mutex);
+
+	m_cb->flush();
+
+	return 0;
+}
+
+
+/*
+ * open() should be called before multiple threads access xtrx_source.
+ */
+int xtrx_source::open(unsigned int subdev) {
+	int r;
+	uint32_t dev_index = subdev;
+
+	r = xtrx_open("/dev/xtrx0", m_loglevel, &dev);
+	if (r < 0) {
+		fprintf(stderr, "Failed to open xtrx device %d\n", dev_index);
+		exit(1);
+	}
+	snprintf(m_device_id, sizeof(m_device_id), "xtrx-%u", dev_index);
+
+	if (m_fpga_master_clock_freq != 0) {
+		xtrx_set_ref_clk(dev, m_fpga_master_clock_freq, XTRX_CLKSRC_INT);
+	}
+
+	set_gsm_rate();
 
 	/* works best for GSM */
 	xtrx_set_antenna(dev, XTRX_RX_W);
@@ -228,11 +348,12 @@ int xtrx_source::open(unsigned int subdev) {
 
 int xtrx_source::fill(unsigned int num_samples, unsigned int *overrun_i) {
 	complex *c;
-	unsigned avail, j;
+	unsigned avail, k;
 	unsigned overruns = 0;
+	uint64_t t = instr_begin(INSTR_FILL), t_read;
 #if 1
 	static float tmp_data[8192*2];
-	float *buf = &tmp_data[0];
+	float *buf;
 
 	xtrx_recv_ex_info_t ri;
 	ri.samples = 8192;
@@ -240,29 +361,48 @@ int xtrx_source::fill(unsigned int num_samples, unsigned int *overrun_i) {
 	ri.buffers = (void* const* )&buf;
 	ri.flags = 0;
 
-	for (; ; num_samples -= 8192) {
-		unsigned csm = (num_samples > 8192) ? 8192 : num_samples;
+	while (m_cb->data_available() < num_samples) {
+		c = (complex *)m_cb->poke(&avail);
+		if (avail < ri.samples) {
+			fprintf(stderr, "warning: local overrun\n");
+			overruns++;
+			instr_count(INSTR_OVERRUNS);
+			break;
+		}
+
+		// when recording, receive straight into the recorder's chunk
+		buf = 0;
+		if (m_rec) {
+			m_rec->set_meta(m_center_freq, m_sample_rate, m_gain);
+			buf = (float *)m_rec->poke(ri.samples);
+		}
+		if (!buf)
+			buf = &tmp_data[0];
 
 		pthread_mutex_lock(&m_u_mutex);
+		t_read = instr_begin(INSTR_READ);
 		if (xtrx_recv_sync_ex(dev, &ri) < 0) {
 			pthread_mutex_unlock(&m_u_mutex);
 
 			fprintf(stderr, "error: xtrx_recv_sync_ex\n");
+			instr_end(INSTR_FILL, t);
 			return -1;
 		}
+		instr_end(INSTR_READ, t_read);
 		pthread_mutex_unlock(&m_u_mutex);
 
-
-		c = (complex *)m_cb->poke(&avail);
-		assert(avail >= csm);
-		memcpy(c, tmp_data, csm * sizeof(float) * 2);
-		m_cb->wrote(csm);
-
-		if (ri.out_samples != ri.samples)
+		instr_count(INSTR_SAMPLES, ri.out_samples);
+		if (ri.out_samples != ri.samples) {
 			overruns++;
+			instr_count(INSTR_OVERRUNS);
+		}
 
-		if (num_samples <= csm)
-			break;
+		// drop what was sampled before the last retune settled
+		k = m_settle.skip((complex *)buf, ri.out_samples, m_sample_rate);
+		if (m_rec)
+			m_rec->wrote(ri.out_samples, k);
+		m_nco.mix((complex *)buf + k, c, ri.out_samples - k);
+		m_cb->wrote(ri.out_samples - k);
 	}
 #else
 
@@ -291,6 +431,7 @@ int xtrx_source::fill(unsigned int num_samples, unsigned int *overrun_i) {
 #endif
 	if(overrun_i)
 		*overrun_i = overruns;
+	instr_end(INSTR_FILL, t);
 	return 0;
 }
 
@@ -312,6 +453,24 @@ int xtrx_source::read(complex *buf, unsigned int num_samples,
 }
 
 
+/*
+ * Tee every sample received from now on to path, as complex floats.
+ */
+int xtrx_source::record(const char *path) {
+
+	if(m_rec)
+		return -1;
+	m_rec = new iq_recorder(path, file_source::FMT_CF32, sizeof(complex), device_id());
+	if(m_rec->open()) {
+		delete m_rec;
+		m_rec = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+
 /*
  * Don't hold a lock on this and use the usrp at the same time.
  */
@@ -320,15 +479,59 @@ circular_buffer *xtrx_source::get_buffer() {
 	return m_cb;
 }
 
+
+/*
+ * Grow the buffer to hold at least len samples.  What it held is dropped and
+ * it may move, so call get_buffer() again afterwards.
+ */
+int xtrx_source::reserve(unsigned int len) {
+
+	circular_buffer *cb;
+
+	if(len <= m_cb->buf_len())
+		return 0;
+	try {
+		cb = new circular_buffer(len, sizeof(complex), 0);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		return -1;
+	}
+	delete m_cb;
+	m_cb = cb;
+	return 0;
+}
+
 #define FLUSH_SIZE		8192
+/*
+ * Empty the buffer.  Samples taken before the last retune settled are
+ * dropped by fill() as they arrive.  A flush_count additionally discards
+ * that many FLUSH_SIZE reads, as flushing used to.
+ */
 int xtrx_source::flush(unsigned int flush_count) {
 
-	unsigned i;
+	uint64_t t = instr_begin(INSTR_FLUSH);
 
 	m_cb->flush();
-	for (i = 0; i < flush_count; i++)
-		fill(FLUSH_SIZE, 0);
-	m_cb->flush();
+	if(flush_count) {
+		fill(flush_count * FLUSH_SIZE, 0);
+		m_cb->flush();
+	}
 
+	instr_end(INSTR_FLUSH, t);
 	return 0;
 }
+
+
+void xtrx_source::report_settle() {
+
+	m_settle.report();
+}
+
+
+/*
+ * Names the device across runs, valid after open().
+ */
+const char *xtrx_source::device_id() {
+
+	return m_device_id;
+}
@@ -30,9 +30,13 @@
 
 #include "usrp_complex.h"
 #include "circular_buffer.h"
+#include "sample_source.h"
+#include "nco.h"
+#include "settle.h"
+#include "iq_recorder.h"
 
 
-class xtrx_source {
+class xtrx_source : public sample_source {
 public:
 	xtrx_source(float sample_rate, long int fpga_master_clock_freq, int loglevel);
 	xtrx_source(unsigned int decimation, long int fpga_master_clock_freq, int loglevel);
@@ -42,23 +46,30 @@ public:
 	int read(complex *buf, unsigned int num_samples, unsigned int *samples_read);
 	int fill(unsigned int num_samples, unsigned int *overrun);
 	int tune(double freq);
-	int set_freq_correction(int ppm);
+	int set_freq_correction(double ppm);
+	int set_sample_rate(double rate);
+	int reset_sample_rate();
 	bool set_antenna(int antenna);
 	bool set_gain(float gain);
 	void start();
 	void stop();
-	int flush(unsigned int flush_count = FLUSH_COUNT);
+	int flush(unsigned int flush_count = 0);
 	circular_buffer *get_buffer();
+	int reserve(unsigned int len);
+	void report_settle();
+	const char *device_id();
+	int record(const char *path);
 
 	float sample_rate();
 
 	static const unsigned int side_A = 0;
 	static const unsigned int side_B = 1;
 
-	double			m_center_freq;
-	int			m_freq_corr;
-
 private:
+	void update_nco();
+	void set_gsm_rate();
+	void run();
+
 	xtrx_dev		*dev;
 
 	float			m_sample_rate;
@@ -68,6 +79,12 @@ private:
 	long int		m_fpga_master_clock_freq;
 
 	circular_buffer *	m_cb;
+	nco			m_nco;
+	settle_timer		m_settle;
+	char			m_device_id[64];
+	float			m_gain;
+	iq_recorder *		m_rec;
+	int			m_running;
 
 	unsigned		m_loglevel;
 	/*
@@ -76,7 +93,6 @@ private:
 	 */
 	pthread_mutex_t		m_u_mutex;
 
-	static const unsigned int	FLUSH_COUNT	= 4;
 	static const unsigned int	CB_LEN		= (16 * 16384);
 	static const int		NCHAN		= 1;
 	static const int		INITIAL_MUX	= -1;